@@ -0,0 +1,94 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_ANALYSIS_CACHE_H
+#define TOAD_ANALYSIS_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "unicode/unistr.h"
+#include "ticcutils/Configuration.h"
+
+namespace Toad {
+
+  // one analysis: a (pretty) string and a tag
+  typedef std::pair<icu::UnicodeString,icu::UnicodeString> analysis;
+
+  // An on-disk cache of MBMA analyses.
+  // Entries are keyed on (model hash, configuration hash, key). The key is
+  // normally the lowercased word. Entries of other models or configurations
+  // are left in the file but ignored, so switching back to an earlier model
+  // finds its analyses again.
+  //
+  // The file is a UTF-8 text file, with one TAB separated line per entry:
+  //   model-hash config-hash key N string_1 tag_1 ... string_N tag_N
+  // New entries are appended by save().
+  //
+  // find() may be called from many threads, add() and save() may not.
+  class AnalysisCache {
+  public:
+    AnalysisCache( const std::string& filename,
+		   uint64_t model_hash,
+		   uint64_t config_hash );
+    bool load( std::string& error );
+    const std::vector<analysis> *find( const icu::UnicodeString& key ) const;
+    void add( const icu::UnicodeString& key,
+	      const std::vector<analysis>& analyses );
+    bool save( std::string& error );
+    size_t size() const { return _entries.size(); };
+    size_t added() const { return _new.size(); };
+  private:
+    struct ustring_hash {
+      size_t operator()( const icu::UnicodeString& us ) const {
+	return us.hashCode();
+      }
+    };
+    std::string _filename;
+    std::string _prefix; // the hashes, as written in the file
+    std::unordered_map<icu::UnicodeString,
+		       std::vector<analysis>,
+		       ustring_hash> _entries;
+    std::vector<icu::UnicodeString> _new; // keys not yet saved
+  };
+
+  // FNV-1a hashes
+  uint64_t hash_bytes( const char *, size_t, uint64_t = 14695981039346656037ULL );
+  // returns false when the file can't be read
+  bool hash_file( const std::string& filename, uint64_t& hash );
+
+  // the hashes of the MBMA tree and of the [[mbma]] settings in 'config'
+  // The config hash includes the contents of the files the settings refer
+  // to, so editing those in place also invalidates the cached analyses.
+  bool mbma_fingerprint( const TiCC::Configuration& config,
+			 uint64_t& model_hash,
+			 uint64_t& config_hash,
+			 std::string& error );
+
+}
+
+#endif // TOAD_ANALYSIS_CACHE_H
@@ -0,0 +1,99 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_CHECKERS_H
+#define TOAD_CHECKERS_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include "unicode/unistr.h"
+#include "frog/mbma_mod.h"
+#include "frog/mblem_mod.h"
+#include "toad/owned_list.h"
+#include "toad/frozen_lexicon.h"
+#include "toad/analysis_cache.h"
+
+namespace Toad {
+
+  // The work of testmbma, checkmbma and checkmblem on one line or word.
+  // The tools and toadd both use these, so a job of toadd gives the
+  // same output as the tool.
+
+  // the MBMA tag as 'cout << tag' shows it
+  icu::UnicodeString mbma_tag( const CLEX::Type& );
+
+  // trim a testmbma line and split it in the lowercased word and its
+  // classes. false for lines without classes, which are skipped.
+  bool split_test_line( icu::UnicodeString& line,
+			icu::UnicodeString& word,
+			std::vector<icu::UnicodeString>& classes );
+
+  // the analyses of 'word' with 'classes'. 'rules' holds the rules until
+  // the next call.
+  void mbma_analyze( Mbma&,
+		     OwnedList<Rule>& rules,
+		     const icu::UnicodeString& word,
+		     const std::vector<icu::UnicodeString>& classes,
+		     bool deep,
+		     std::vector<analysis>& analyses );
+
+  // write the analyses of a testmbma line
+  void write_analyses( std::ostream&,
+		       const icu::UnicodeString& line,
+		       const icu::UnicodeString& word,
+		       const std::vector<analysis>& analyses );
+
+  // check the MBMA analyses of a lowercase 'word': every analysis needs
+  // a morpheme in 'lexicon', and with a 'mor_lexicon' the other morphemes
+  // must be in that one. The problems are written to 'os'.
+  // Words with capitals are skipped. Returns true when 'word' was
+  // classified, so not found in 'cache'. The analyses are then stored in
+  // 'to_cache', to add them to the cache later.
+  bool check_mbma_word( Mbma&,
+			const AnalysisCache *cache,
+			const FrozenLexicon& lexicon,
+			const FrozenLexicon *mor_lexicon,
+			const icu::UnicodeString& word,
+			std::ostream& os,
+			std::vector<analysis>& to_cache );
+
+  struct lemma_mismatch {
+    icu::UnicodeString word;
+    icu::UnicodeString lemma;
+    icu::UnicodeString tag;
+  };
+
+  // add the MBLEM lemmas of 'word' that are not in 'lexicon' to 'result'.
+  // Very short lemmas are not reported.
+  void check_lemma( Mblem&,
+		    const FrozenLexicon& lexicon,
+		    const icu::UnicodeString& word,
+		    std::vector<lemma_mismatch>& result );
+
+}
+
+#endif // TOAD_CHECKERS_H
@@ -0,0 +1,64 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_COLUMN_FORMATTER_H
+#define TOAD_COLUMN_FORMATTER_H
+
+#include <string>
+#include <vector>
+#include "unicode/unistr.h"
+
+namespace Toad {
+
+  // Writes the lines of a sentence as TAB separated columns, in UTF-8.
+  // The layout is compiled once from a comma separated list of column
+  // names, each with an optional offset to the current position:
+  //   "word,tag-1,tag,tag+1,label"
+  // gives the word, the previous, current and next tag, and the label.
+  // Positions outside the sentence are written as "_".
+  class ColumnFormatter {
+  public:
+    // 'names' are the names of the columns passed to format(), in order
+    bool compile( const std::string& layout,
+		  const std::vector<std::string>& names,
+		  std::string& error );
+    // append the lines for all positions of the sentence to 'out'.
+    // All columns must have the same size.
+    void format( const std::vector<const std::vector<icu::UnicodeString>*>& columns,
+		 std::string& out ) const;
+    const std::string& layout() const { return _layout; };
+  private:
+    struct field {
+      size_t column;
+      int offset;
+    };
+    std::string _layout;
+    std::vector<field> _fields;
+  };
+
+}
+
+#endif // TOAD_COLUMN_FORMATTER_H
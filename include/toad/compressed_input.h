@@ -0,0 +1,108 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_COMPRESSED_INPUT_H
+#define TOAD_COMPRESSED_INPUT_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <istream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace Toad {
+
+  enum class Compression { NONE, GZIP, XZ, ZSTD };
+
+  // detected from the first bytes of a file. NONE when they are not the
+  // magic of one of the others.
+  Compression detect_compression( const unsigned char *, size_t );
+  std::string toString( Compression );
+
+  class decoder;
+
+  // A streambuf over a file that may be gzip, xz or zstd compressed.
+  // Compressed files are decoded in a separate thread, that stays a few
+  // chunks ahead of the reader. Plain files are read directly.
+  class decompress_buf: public std::streambuf {
+  public:
+    decompress_buf();
+    ~decompress_buf();
+    bool open( const std::string& filename );
+    void close();
+    bool is_open() const { return _file != 0; };
+    Compression compression() const { return _type; };
+    std::string error() const;
+  protected:
+    int_type underflow() override;
+  private:
+    decompress_buf( const decompress_buf& ) = delete;
+    decompress_buf& operator=( const decompress_buf& ) = delete;
+    void produce();
+    bool push( std::vector<char>& );
+    void set_error( const std::string& );
+    FILE *_file;
+    std::string _filename;
+    Compression _type;
+    decoder *_decoder;
+    std::vector<char> _head;    // the bytes read to detect the compression
+    std::vector<char> _current; // the chunk being read
+    std::thread _producer;
+    mutable std::mutex _mutex;
+    std::condition_variable _not_empty;
+    std::condition_variable _not_full;
+    std::deque<std::vector<char>> _queue;
+    bool _done;  // no more chunks will be queued
+    bool _stop;  // the reader is gone
+    std::string _error;
+  };
+
+  // An istream that can replace an ifstream for files that are possibly
+  // compressed:
+  //   Toad::InputFile is( name );
+  //   while ( TiCC::getline( is, line ) ) ...
+  //   if ( !is.error().empty() ) ... // corrupt or truncated input
+  // The compression is detected from the contents, not from the name.
+  class InputFile: public std::istream {
+  public:
+    InputFile();
+    explicit InputFile( const std::string& filename );
+    bool open( const std::string& filename );
+    void close();
+    bool is_open() const { return _buf.is_open(); };
+    Compression compression() const { return _buf.compression(); };
+    // why open() failed, or why the input ended early
+    std::string error() const { return _buf.error(); };
+  private:
+    decompress_buf _buf;
+  };
+
+}
+
+#endif // TOAD_COMPRESSED_INPUT_H
@@ -0,0 +1,107 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_EDIT_SCRIPT_H
+#define TOAD_EDIT_SCRIPT_H
+
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include "unicode/unistr.h"
+
+namespace Toad {
+
+  // the Frog MBLEM edit operations to get from a wordform to its lemma
+  struct edit_script {
+    icu::UnicodeString prefixed; // a removed particle (+P)
+    icu::UnicodeString deleted;  // a deleted suffix (+D)
+    icu::UnicodeString inserted; // an inserted suffix (+I)
+    icu::UnicodeString label() const;
+  };
+
+  // An Aho-Corasick automaton over a set of particles.
+  // first_positions() finds the first occurrence of EVERY particle in
+  // a word in one left-to-right scan.
+  class ParticleAutomaton {
+  public:
+    explicit ParticleAutomaton( const std::vector<icu::UnicodeString>& );
+    size_t size() const { return _particles.size(); };
+    const icu::UnicodeString& particle( size_t i ) const {
+      return _particles[i];
+    };
+    void first_positions( const icu::UnicodeString&,
+			  std::vector<int>& ) const;
+  private:
+    struct node {
+      std::vector<std::pair<UChar,int>> next; // sorted on UChar
+      int fail;
+      int out;      // particle ending here, or -1
+      int out_link; // next node on the fail chain with an out, or -1
+    };
+    int child( int, UChar ) const;
+    std::vector<icu::UnicodeString> _particles;
+    std::vector<node> _nodes;
+  };
+
+  // Derives edit scripts for (word, lemma, tag) triples.
+  // The particles are given as a map of POS tag (parts) to the particles
+  // that may be found in words with a tag containing that part.
+  // e.g. "[WW(vd/be] [WW(vd/ge]" gives { "WW(vd" -> { "be", "ge" } }
+  //
+  // derive() is const and doesn't modify shared state, so one EditScripter
+  // can be used from many threads at once.
+  // Call add_tag() for all known tags BEFORE going parallel, to avoid
+  // repeated matching of the tag against the particle map.
+  class EditScripter {
+  public:
+    explicit EditScripter( const std::map<icu::UnicodeString,
+			   std::set<icu::UnicodeString>>& );
+    void add_tag( const icu::UnicodeString& );
+    edit_script derive( const icu::UnicodeString& word,
+			const icu::UnicodeString& lemma,
+			const icu::UnicodeString& tag ) const;
+  private:
+    struct ustring_hash {
+      size_t operator()( const icu::UnicodeString& us ) const {
+	return us.hashCode();
+      }
+    };
+    std::vector<int> candidates( const icu::UnicodeString& ) const;
+    // tag part -> indices of its particles in the automaton
+    std::vector<std::pair<icu::UnicodeString,std::vector<int>>> _tag_parts;
+    // tag -> candidate particles, in order of preference
+    std::unordered_map<icu::UnicodeString,
+		       std::vector<int>,
+		       ustring_hash> _tag_index;
+    ParticleAutomaton _automaton;
+  };
+
+  int common_prefix( const icu::UnicodeString&, const icu::UnicodeString& );
+
+}
+
+#endif // TOAD_EDIT_SCRIPT_H
@@ -0,0 +1,118 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_ENRICHMENT_H
+#define TOAD_ENRICHMENT_H
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include "unicode/unistr.h"
+#include "mbt/MbtAPI.h"
+#include "frog/ner_tagger_mod.h"
+#include "toad/column_formatter.h"
+
+namespace Toad {
+
+  // The chunker and NER training data, as chunkgen, nergen, toadgen and
+  // toadd write it.
+  //
+  // MBT builds the features of the -p/-P patterns itself, from the words
+  // and the tags in its window. The columns between the word and the label
+  // are enrichment, which it adds to every instance as they are. So these
+  // layouts don't depend on the patterns, but they must match the
+  // enrichment that Frog's chunker and NER modules give when tagging.
+  // Chunker: the word, the POS tags of the previous, current and next
+  // word and the IOB tag.
+  extern const std::string chunk_layout;
+  // NER: the same, with the gazetteer tags after the POS tags.
+  extern const std::string ner_layout;
+
+  // Writes the enriched data of one sentence at a time. Without a
+  // NERTagger it is chunker data, with one NER data.
+  class EnrichmentWriter {
+  public:
+    // 'override': replace O labels by the gazetteer tags, where there is
+    // no conflict (nergen --override). The merged labels are written.
+    explicit EnrichmentWriter( NERTagger *ner = 0, bool override = false ):
+      _ner( ner ), _override( override ) {};
+    bool init( std::string& error );
+    // write a sentence and the separator after it: an empty line, or
+    // "<utt>" when 'utt'. Chunker data has no separator after an
+    // 'unterminated' last sentence, NER data always has one.
+    void write( std::ostream& os,
+		const std::vector<icu::UnicodeString>& words,
+		const std::vector<icu::UnicodeString>& tags,
+		const std::vector<icu::UnicodeString>& labels,
+		bool utt,
+		bool unterminated = false );
+  private:
+    NERTagger *_ner;
+    bool _override;
+    ColumnFormatter _formatter;
+    std::vector<icu::UnicodeString> _gazet_tags;
+    // reused for every sentence when overriding
+    std::vector<tc_pair> _merged;
+    std::vector<tc_pair> _gazet_ners;
+    std::vector<icu::UnicodeString> _labels;
+    std::string _buffer;
+  };
+
+  // Read a 2 column corpus (or one with a POS column, see SentenceReader)
+  // in batches, tag it with 'tagger', or use its POS tags when 'tagger'
+  // is 0, and write the enriched data. 'utt' is set when the corpus uses
+  // "<utt>" markers.
+  // With a 'progress' stream, a dot is written for every 100 sentences,
+  // and the BatchTagger report at the end.
+  // Returns false and sets 'error' on a malformed line.
+  bool enrich_corpus( std::istream& is,
+		      std::ostream& os,
+		      MbtAPI *tagger,
+		      size_t pos_column,
+		      EnrichmentWriter& writer,
+		      std::ostream *progress,
+		      bool& utt,
+		      std::string& error );
+
+  // the NER tag of a gazetteer tag. Combined ("+") tags are undecided, O.
+  icu::UnicodeString gazetteer_tag( const icu::UnicodeString& );
+
+  // Write the NER tags the gazetteers give to a 2 column corpus, or with
+  // 'running' to one with a sentence per line, in IOB form (nergen
+  // --bootstrap). 'utt' is set when the corpus uses "<utt>" markers.
+  // Returns false and sets 'error' on a malformed line.
+  bool bootstrap_corpus( std::istream& is,
+			 std::ostream& os,
+			 NERTagger& ner,
+			 bool running,
+			 std::ostream *progress,
+			 bool& utt,
+			 std::string& error );
+
+}
+
+#endif // TOAD_ENRICHMENT_H
@@ -0,0 +1,141 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_FOLIA_READER_H
+#define TOAD_FOLIA_READER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <ostream>
+#include "libxml/xmlreader.h"
+#include "toad/compressed_input.h"
+
+namespace Toad {
+
+  // a word of a FoLiA sentence, with the annotations toad trains on.
+  // Missing annotations are empty.
+  struct folia_word {
+    std::string id;
+    std::string text;
+    std::string lemma;
+    std::string pos;
+    std::string chunk;  // IOB: B-NP, I-NP...
+    std::string entity; // IOB: B-per, I-per...
+  };
+
+  // Reads the sentences of a FoLiA document with a libxml2 xmlTextReader,
+  // so only the current sentence is in memory, never the whole document.
+  // Of every word, the text and the first lemma and POS annotation are
+  // taken. Alternatives, originals and suggestions are skipped.
+  // Chunks and entities come from the <chunking> and <entities> layers
+  // of the sentence, as IOB tags on the words they refer to. A layer
+  // outside the sentence (e.g. on the paragraph) comes after the
+  // sentence is returned: its references are counted in dangling().
+  class FoliaReader {
+  public:
+    FoliaReader();
+    ~FoliaReader();
+    // the file may be compressed, see InputFile
+    bool open( const std::string& filename, std::string& error );
+    // the next sentence. false at the end of the document, or on an
+    // error, which is set in 'error'
+    bool next( std::vector<folia_word>& sentence, std::string& error );
+    size_t dangling() const { return _dangling; };
+  private:
+    FoliaReader( const FoliaReader& ) = delete;
+    FoliaReader& operator=( const FoliaReader& ) = delete;
+    struct open_sentence {
+      std::vector<folia_word> words;
+      std::map<std::string,size_t> ids;
+    };
+    struct open_span {
+      bool entity;
+      std::string cls;
+      std::vector<std::string> refs;
+    };
+    void start_element( const std::string& name, int depth );
+    bool end_element( const std::string& name, int depth,
+		      std::vector<folia_word>& sentence );
+    void close_span();
+    static int read_cb( void *, char *, int );
+    static int close_cb( void * );
+    static void error_cb( void *, const char *, xmlParserSeverities,
+			  xmlTextReaderLocatorPtr );
+    InputFile _is;
+    xmlTextReaderPtr _reader;
+    std::string _filename;
+    std::string _error;
+    std::vector<open_sentence> _sentences; // nested, e.g. in a quote
+    std::vector<open_span> _spans;
+    folia_word _word;
+    int _word_depth; // -1 outside a word
+    int _text_depth; // -1 outside the text of the word
+    size_t _dangling;
+  };
+
+  enum class folia_column { WORD, LEMMA, POS, CHUNK, ENTITY };
+
+  struct folia_stats {
+    size_t documents = 0;
+    size_t sentences = 0;
+    size_t words = 0;
+    size_t skipped = 0;  // sentences with missing annotations
+    size_t dangling = 0; // span references outside their sentence
+    void report( std::ostream& ) const;
+  };
+
+  // the FoLiA documents in 'name': the file itself, or the *.xml files
+  // (possibly compressed) below a directory, sorted
+  std::vector<std::string> folia_files( const std::string& name );
+
+  // Writes 'columns' of all sentences in 'files' to 'os', as TAB
+  // separated lines with an 'eos' line after every sentence. The
+  // documents are read in parallel, and written in the order of 'files'.
+  // The first unfinished document streams its output per batch of
+  // sentences. The ones after it are buffered until it is done.
+  // A sentence where a word lacks a requested lemma or POS tag, or where
+  // a word contains white space, is skipped. A missing chunk or entity
+  // is written as "O".
+  bool folia_to_columns( const std::vector<std::string>& files,
+			 const std::vector<folia_column>& columns,
+			 const std::string& eos,
+			 std::ostream& os,
+			 folia_stats& stats,
+			 std::string& error );
+
+  // folia_to_columns() for the document(s) in 'name' (see folia_files()),
+  // into the file 'outname'
+  bool folia_to_file( const std::string& name,
+		      const std::vector<folia_column>& columns,
+		      const std::string& eos,
+		      const std::string& outname,
+		      folia_stats& stats,
+		      std::string& error );
+
+}
+
+#endif // TOAD_FOLIA_READER_H
@@ -0,0 +1,111 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_FROZEN_LEXICON_H
+#define TOAD_FROZEN_LEXICON_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ostream>
+#include "unicode/unistr.h"
+#include "toad/string_pool.h"
+
+namespace Toad {
+
+  // A read-only, sorted set of words in one contiguous binary image:
+  //
+  //   header     : magic "TOADLEX", version, byte order mark, counts
+  //   offsets    : uint64_t[count+1], start of every word in 'data'
+  //   data       : UChar[], all words in code unit order, without
+  //                separators or duplicates
+  //
+  // The image is used as is, so a lexicon file is simply mmap()ed and
+  // lookups (a binary search) never allocate. Files are only portable
+  // between machines with the same byte order.
+
+  // collects words and freezes them into a lexicon image
+  class LexiconBuilder {
+  public:
+    void add( const icu::UnicodeString& word ){ _words.intern( word ); };
+    size_t size() const { return _words.size(); };
+    void freeze( std::vector<char>& image ) const;
+    bool write( const std::string& filename, std::string& error ) const;
+  private:
+    StringPool _words;
+  };
+
+  class FrozenLexicon {
+  public:
+    FrozenLexicon();
+    ~FrozenLexicon();
+    FrozenLexicon( const FrozenLexicon& ) = delete;
+    FrozenLexicon& operator=( const FrozenLexicon& ) = delete;
+    // map a lexicon file in memory
+    bool open( const std::string& filename, std::string& error );
+    // use the words of a builder (for text input)
+    void assign( const LexiconBuilder& );
+    bool contains( const UChar *, int32_t ) const;
+    bool contains( const icu::UnicodeString& us ) const {
+      return contains( us.getBuffer(), us.length() );
+    };
+    size_t size() const { return _count; };
+    icu::UnicodeString word( size_t ) const; // a read-only alias
+  private:
+    void close();
+    bool attach( const char *, size_t, std::string& );
+    void *_map;
+    size_t _map_size;
+    std::vector<char> _image;
+    const uint64_t *_offsets;
+    const UChar *_data;
+    size_t _count;
+  };
+
+  // add the first (whitespace separated) field of every line in 'filename'
+  // to 'builder'. Returns the number of lines used, or -1 when the file
+  // can't be read.
+  long add_first_fields( LexiconBuilder& builder,
+			 const std::string& filename,
+			 bool lowercase );
+
+  // add the lowercased words of an MBMA lexicon (like mbma-merged.lex),
+  // skipping the lines that don't have a morpheme for every letter.
+  // Skipped lines are reported on 'problems', when given.
+  // Returns the number of lines used, or -1 when the file can't be read.
+  long add_mbma_words( LexiconBuilder& builder,
+		       const std::string& filename,
+		       std::ostream *problems = 0 );
+
+  // the same for a lemma lexicon (like mblem.lex), of which only the
+  // lines with exactly 3 fields (word, lemma and tag) are used
+  long add_mblem_words( LexiconBuilder& builder,
+			const std::string& filename,
+			std::ostream *problems = 0 );
+
+}
+
+#endif // TOAD_FROZEN_LEXICON_H
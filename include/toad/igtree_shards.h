@@ -0,0 +1,96 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_IGTREE_SHARDS_H
+#define TOAD_IGTREE_SHARDS_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+namespace Toad {
+
+  // Support for training an IGTree in parts.
+  // An IGTree splits on the features in the order of their weights. So
+  // when all parts use the same weights, and the instances are divided
+  // on the value of the most important feature, every part is exactly
+  // one (or more) branch(es) of the top node of the full tree.
+
+  // statistics of a Timbl datafile (space separated, class last)
+  struct data_stats {
+    size_t instances = 0;
+    std::vector<double> weights;                  // per feature
+    std::map<std::string,size_t> class_freqs;
+    std::vector<std::map<std::string,size_t>> value_freqs; // per feature
+    size_t top_feature() const; // the most important feature (0 based)
+  };
+
+  // gather the statistics, with Information Gain (ig=true) or Gain Ratio
+  // weights, in a single pass over 'datafile'
+  bool gather_stats( const std::string& datafile,
+		     bool ig,
+		     data_stats& stats );
+
+  // write the weights in the Timbl weights file format
+  bool write_weights( const std::string& filename,
+		      const data_stats& stats );
+
+  // distribute the values of the top feature over 'num' shards, with
+  // roughly the same number of instances per shard.
+  std::vector<std::set<std::string>> plan_shards( const data_stats& stats,
+						  size_t num );
+
+  // write the instances of every shard to 'prefix'.<i>
+  // returns the filenames, or an empty vector on failure
+  std::vector<std::string> split_instances( const std::string& datafile,
+					    size_t feature,
+					    const std::vector<std::set<std::string>>& shards,
+					    const std::string& prefix );
+
+  // merge the hashed IGTree files of the shards into one IGTree file.
+  // 'shard_values' are the top feature values per shard. The top node
+  // gets the most frequent class in 'stats' as default.
+  // The shards are streamed to 'outfile' one by one, so only the hash
+  // tables and one top branch are in memory.
+  // On failure, false is returned and 'error' tells why.
+  bool merge_igtrees( const std::vector<std::string>& trees,
+		      const std::vector<std::set<std::string>>& shard_values,
+		      const data_stats& stats,
+		      const std::string& outfile,
+		      std::string& error );
+
+  // write a copy of the merged tree 'merged' with only the top branches
+  // for 'values' to 'outfile'. For those values, it classifies like the
+  // whole tree, but it is only as large as their shard.
+  bool extract_shard( const std::string& merged,
+		      const std::set<std::string>& values,
+		      const std::string& outfile,
+		      std::string& error );
+
+}
+
+#endif // TOAD_IGTREE_SHARDS_H
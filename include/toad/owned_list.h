@@ -0,0 +1,70 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_OWNED_LIST_H
+#define TOAD_OWNED_LIST_H
+
+#include <vector>
+
+namespace Toad {
+
+  // Takes ownership of a vector of heap objects, like the vector<Rule*>
+  // returned by Mbma::execute(), and deletes them when it is reset,
+  // cleared or destroyed.
+  // Keep one list outside a loop and reset() it for every word: the
+  // objects of the previous word are freed, and the list itself is
+  // reused.
+  template <typename T>
+  class OwnedList {
+  public:
+    typedef typename std::vector<T*>::const_iterator const_iterator;
+    OwnedList() {};
+    explicit OwnedList( std::vector<T*>&& v ): _items( std::move(v) ) {};
+    ~OwnedList() { clear(); };
+    OwnedList( const OwnedList& ) = delete;
+    OwnedList& operator=( const OwnedList& ) = delete;
+    void reset( std::vector<T*>&& v ){
+      clear();
+      _items.swap( v );
+    }
+    void clear(){
+      for ( const auto& it : _items ){
+	delete it;
+      }
+      _items.clear();
+    }
+    const_iterator begin() const { return _items.begin(); };
+    const_iterator end() const { return _items.end(); };
+    size_t size() const { return _items.size(); };
+    bool empty() const { return _items.empty(); };
+    T *operator[]( size_t i ) const { return _items[i]; };
+  private:
+    std::vector<T*> _items;
+  };
+
+}
+
+#endif // TOAD_OWNED_LIST_H
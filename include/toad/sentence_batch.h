@@ -0,0 +1,109 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_SENTENCE_BATCH_H
+#define TOAD_SENTENCE_BATCH_H
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include "unicode/unistr.h"
+#include "mbt/MbtAPI.h"
+
+namespace Toad {
+
+  // a sentence from a 2 column (word label) training file. When the
+  // file has a POS column too, the tags are filled.
+  struct labeled_sentence {
+    std::vector<icu::UnicodeString> words;
+    std::vector<icu::UnicodeString> tags;
+    std::vector<icu::UnicodeString> labels;
+  };
+
+  // Reads a 2 column file in batches of sentences. Sentences are
+  // separated by empty lines or by "<utt>" lines.
+  // With a 'pos_column' K (1 based, > 1), lines have at least K+1
+  // columns: the word first, the POS tag in column K and the label last.
+  // The sentences in a batch are reused by the next read_batch(), so
+  // reading a corpus doesn't reallocate them.
+  class SentenceReader {
+  public:
+    explicit SentenceReader( std::istream& is, size_t pos_column = 0 ):
+      _is( is ), _pos_column( pos_column ),
+      _utt( false ), _unterminated( false ) {};
+    // fill 'batch' with at most 'max' sentences and return the number
+    // read. 0 means end of input. On a malformed line, 0 is returned
+    // and 'error' is set.
+    size_t read_batch( std::vector<labeled_sentence>& batch,
+		       size_t max,
+		       std::string& error );
+    bool saw_utt() const { return _utt; }; // "<utt>" markers are used
+    // true when the input ended without a separator after the last
+    // sentence
+    bool unterminated() const { return _unterminated; };
+  private:
+    std::istream& _is;
+    size_t _pos_column;
+    bool _utt;
+    bool _unterminated;
+    std::string _line;
+  };
+
+  // Tags batches of already split sentences with MBT.
+  // MBT has no API for pre-tokenized input, so every sentence is still
+  // passed as one newline separated line, but it is built in a reused
+  // buffer, straight from the words.
+  // Keeps the time spent in MBT and outside it (preparing the input),
+  // to see what the per sentence overhead is.
+  class BatchTagger {
+  public:
+    explicit BatchTagger( MbtAPI *tagger ):
+      _tagger( tagger ), _sentences( 0 ), _words( 0 ),
+      _prep_seconds( 0.0 ), _tag_seconds( 0.0 ) {};
+    // tag the first 'num' sentences of 'batch'. results[i] belongs to
+    // batch[i]
+    void tag( const std::vector<labeled_sentence>& batch,
+	      size_t num,
+	      std::vector<std::vector<Tagger::TagResult>>& results );
+    size_t sentences() const { return _sentences; };
+    size_t words() const { return _words; };
+    double prep_seconds() const { return _prep_seconds; };
+    double tag_seconds() const { return _tag_seconds; };
+    // the time per sentence in and outside MBT
+    void report( std::ostream& ) const;
+  private:
+    MbtAPI *_tagger;
+    icu::UnicodeString _buffer;
+    size_t _sentences;
+    size_t _words;
+    double _prep_seconds;
+    double _tag_seconds;
+  };
+
+}
+
+#endif // TOAD_SENTENCE_BATCH_H
@@ -0,0 +1,81 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_STRING_POOL_H
+#define TOAD_STRING_POOL_H
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include "unicode/unistr.h"
+
+namespace Toad {
+
+  typedef uint32_t string_id;
+
+  // An append-only arena of UnicodeStrings.
+  // Every distinct string is stored only once, in large contiguous blocks,
+  // and is identified by a stable 32 bit id.
+  // All storage is released at once, by clear() or the destructor.
+  // NOT thread safe: use one pool per thread, or fill it before going
+  // parallel and only call get() and find() afterwards.
+  class StringPool {
+  public:
+    explicit StringPool( size_t block_size = 64*1024 );
+    StringPool( const StringPool& ) = delete;
+    StringPool& operator=( const StringPool& ) = delete;
+    string_id intern( const icu::UnicodeString& );
+    string_id intern( const UChar *, int32_t );
+    bool find( const icu::UnicodeString&, string_id& ) const;
+    icu::UnicodeString get( string_id ) const;
+    const UChar *data( string_id id ) const { return _entries[id].ptr; };
+    int32_t length( string_id id ) const { return _entries[id].len; };
+    int compare( string_id, string_id ) const;
+    size_t size() const { return _entries.size(); };
+    bool empty() const { return _entries.empty(); };
+    size_t memory_usage() const;
+    void clear();
+  private:
+    struct entry {
+      const UChar *ptr;
+      int32_t len;
+      uint32_t hash;
+    };
+    static uint32_t hash_of( const UChar *, int32_t );
+    size_t lookup( const UChar *, int32_t, uint32_t ) const;
+    const UChar *store( const UChar *, int32_t );
+    void rehash();
+    size_t _block_size;
+    size_t _used;
+    size_t _allocated;
+    std::vector<std::unique_ptr<UChar[]>> _blocks;
+    std::vector<entry> _entries;
+    std::vector<string_id> _index; // open addressing, id+1, 0 is empty
+  };
+
+}
+
+#endif // TOAD_STRING_POOL_H
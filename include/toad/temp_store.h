@@ -0,0 +1,92 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_TEMP_STORE_H
+#define TOAD_TEMP_STORE_H
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <limits>
+
+namespace Toad {
+
+  // The temporary files of a training run: the datafiles that toad writes
+  // and that MBT and Timbl read back by name.
+  // With a memory budget, create() makes anonymous memory (a memfd) and
+  // turns 'path' into a symlink to it, so everything in this process
+  // that opens 'path' reads and writes that memory. When done() finds
+  // that a finished file doesn't fit the budget, it is moved to disk.
+  // Files that are still being written count too: as their estimate, or
+  // as their current size when that is more. create() only uses memory
+  // when the estimate fits in what is left, otherwise the file is made on
+  // disk right away. So a file without an estimate is always on disk.
+  // All files are removed by cleanup(), which the destructor calls.
+  // The members may be called from several threads.
+  class TempStore {
+  public:
+    TempStore(): _budget( 0 ), _used( 0 ), _keep( false ) {};
+    ~TempStore() { cleanup(); };
+    void set_budget( size_t bytes ) { _budget = bytes; };
+    void keep( bool b ) { _keep = b; };
+    static bool memory_supported();
+    static constexpr size_t unknown_size = std::numeric_limits<size_t>::max();
+    size_t budget() const { return _budget; };
+    // make 'path' an empty temporary file, of about 'estimate' bytes
+    // when it is done
+    bool create( const std::string& path,
+		 std::string& error,
+		 size_t estimate = unknown_size );
+    // 'path' is completely written and closed
+    bool done( const std::string& path, std::string& error );
+    // register a temporary file that others create
+    void add( const std::string& path );
+    // remove one temporary file now
+    void remove( const std::string& path );
+    // remove everything, or move it to disk when keep() is set
+    void cleanup();
+    size_t in_memory() const;
+  private:
+    struct entry {
+      int fd = -1;     // the memfd, or -1 for a file on disk
+      size_t size = 0; // the bytes it counts in the budget, when done
+      bool writing = false;
+      size_t estimate = 0; // while writing
+    };
+    bool to_disk( const std::string& path, entry&, std::string& error );
+    size_t writing_size() const;
+    TempStore( const TempStore& ) = delete;
+    TempStore& operator=( const TempStore& ) = delete;
+    mutable std::mutex _mutex;
+    std::map<std::string,entry> _entries;
+    size_t _budget;
+    size_t _used; // by the files that are done
+    bool _keep;
+  };
+
+}
+
+#endif // TOAD_TEMP_STORE_H
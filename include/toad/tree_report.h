@@ -0,0 +1,89 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_TREE_REPORT_H
+#define TOAD_TREE_REPORT_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+namespace Toad {
+
+  // facts about a generated Timbl instancebase, for deployment sizing
+  struct tree_report {
+    std::string tree_file;
+    std::string timbl_options;
+    size_t file_size = 0;          // bytes
+    bool loaded = false;           // false: no load and classify figures
+    double load_seconds = 0.0;
+    long resident_bytes = -1;      // growth of the RSS while loading
+    std::vector<size_t> level_nodes; // number of nodes per tree level
+    size_t instances = 0;
+    std::map<std::string,size_t> class_freqs;
+    size_t sample_size = 0;
+    double classify_seconds = 0.0; // for the whole sample
+  };
+
+  // load 'treefile' with 'timblopts' and measure it. The class
+  // distribution and the sample come from the training data 'datafile'.
+  // With load=false, only the file is analyzed, the tree isn't loaded.
+  bool analyze_tree( const std::string& timblopts,
+		     const std::string& treefile,
+		     const std::string& datafile,
+		     tree_report& report,
+		     bool load = true );
+
+  // write the report as a JSON object
+  bool write_json( const std::string& filename,
+		   const tree_report& report );
+
+  // the post training analysis of the tools: analyze 'treefile' and
+  // store the report next to it, as 'treefile'.report.json
+  bool report_tree( const std::string& timblopts,
+		    const std::string& treefile,
+		    const std::string& datafile,
+		    bool load = true );
+
+  // take an evenly spread sample of at most 'max' lines from a file
+  std::vector<std::string> sample_lines( const std::string& filename,
+					 size_t max );
+
+  size_t file_size( const std::string& filename );
+
+  // the resident set size of this process in bytes, -1 if unknown
+  long resident_size();
+
+  // the peak resident set size of this process in bytes, -1 if unknown
+  long peak_resident_size();
+
+  // restart the peak at the current resident set size. Returns false
+  // when that isn't possible (Linux before 4.0, other systems)
+  bool reset_peak_resident_size();
+
+}
+
+#endif // TOAD_TREE_REPORT_H
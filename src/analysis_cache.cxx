@@ -0,0 +1,242 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <cstdio>
+#include <fstream>
+#include "ticcutils/StringOps.h"
+#include "ticcutils/Unicode.h"
+#include "toad/analysis_cache.h"
+
+using namespace std;
+using namespace icu;
+
+namespace Toad {
+
+  uint64_t hash_bytes( const char *s, size_t len, uint64_t h ){
+    for ( size_t i=0; i < len; ++i ){
+      h ^= (unsigned char)s[i];
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+  bool hash_file( const string& filename, uint64_t& hash ){
+    ifstream is( filename, ios::binary );
+    if ( !is ){
+      return false;
+    }
+    hash = hash_bytes( 0, 0 );
+    vector<char> buf( 1024*1024 );
+    while ( is ){
+      is.read( buf.data(), buf.size() );
+      hash = hash_bytes( buf.data(), is.gcount(), hash );
+    }
+    return true;
+  }
+
+  // the [[mbma]] settings that influence the analyses
+  static const char *mbma_settings[] = {
+    "treeFile", "timblOpts", "set", "clex_set", "cgn_clex_main",
+    "cgn_clex_sub", "deep-morph", "filter_diacritics", "transFile", 0
+  };
+
+  // the [[mbma]] settings that name a file, with their defaults
+  static const char *mbma_files[][2] = {
+    { "transFile", "" },
+    { "cgn_clex_main", "cgntags.main" },
+    { "cgn_clex_sub", "cgntags.sub" },
+    { 0, 0 }
+  };
+
+  static string mbma_file( const TiCC::Configuration& config,
+			   const string& key,
+			   const string& default_name ){
+    // the file of 'key', as Mbma finds it: relative to the config dir
+    string name = config.lookUp( key, "mbma" );
+    if ( name.empty() ){
+      name = default_name;
+    }
+    if ( !name.empty() && name[0] != '/' ){
+      name = config.configDir() + name;
+    }
+    return name;
+  }
+
+  static string to_hex( uint64_t h ){
+    char buf[17];
+    snprintf( buf, sizeof(buf), "%016llx", (unsigned long long)h );
+    return buf;
+  }
+
+  bool mbma_fingerprint( const TiCC::Configuration& config,
+			 uint64_t& model_hash,
+			 uint64_t& config_hash,
+			 string& error ){
+    string tree = mbma_file( config, "treeFile", "mbma.igtree" );
+    if ( !hash_file( tree, model_hash ) ){
+      error = "unable to read the MBMA tree: '" + tree + "'";
+      return false;
+    }
+    config_hash = hash_bytes( 0, 0 );
+    for ( size_t i=0; mbma_settings[i]; ++i ){
+      string line = string(mbma_settings[i]) + "="
+	+ config.lookUp( mbma_settings[i], "mbma" ) + "\n";
+      config_hash = hash_bytes( line.c_str(), line.size(), config_hash );
+    }
+    for ( size_t i=0; mbma_files[i][0]; ++i ){
+      string name = mbma_file( config, mbma_files[i][0], mbma_files[i][1] );
+      if ( name.empty() ){
+	continue;
+      }
+      // a missing file is hashed too, Mbma will complain about it
+      uint64_t file_hash;
+      string line = string(mbma_files[i][0]) + "#=";
+      if ( hash_file( name, file_hash ) ){
+	line += to_hex( file_hash ) + "\n";
+      }
+      else {
+	line += "missing\n";
+      }
+      config_hash = hash_bytes( line.c_str(), line.size(), config_hash );
+    }
+    return true;
+  }
+
+  static vector<string> split_tabs( const string& line, size_t start ){
+    // unlike TiCC::split_at(), this keeps empty fields
+    vector<string> result;
+    size_t pos = start;
+    while ( true ){
+      size_t tab = line.find( '\t', pos );
+      if ( tab == string::npos ){
+	result.push_back( line.substr( pos ) );
+	break;
+      }
+      result.push_back( line.substr( pos, tab - pos ) );
+      pos = tab + 1;
+    }
+    return result;
+  }
+
+  AnalysisCache::AnalysisCache( const string& filename,
+				uint64_t model_hash,
+				uint64_t config_hash ):
+    _filename( filename )
+  {
+    _prefix = to_hex( model_hash ) + "\t" + to_hex( config_hash );
+  }
+
+  bool AnalysisCache::load( string& error ){
+    // a missing file is just an empty cache
+    ifstream is( _filename );
+    if ( !is ){
+      return true;
+    }
+    string line;
+    size_t line_nr = 0;
+    while ( getline( is, line ) ){
+      ++line_nr;
+      if ( line.compare( 0, _prefix.size(), _prefix ) != 0
+	   || line.size() <= _prefix.size()
+	   || line[_prefix.size()] != '\t' ){
+	// another model or configuration
+	continue;
+      }
+      vector<string> parts = split_tabs( line, _prefix.size()+1 );
+      size_t num = 0;
+      if ( parts.size() < 2
+	   || !TiCC::stringTo( parts[1], num )
+	   || parts.size() != 2 + 2*num ){
+	error = _filename + ": invalid entry at line "
+	  + TiCC::toString( line_nr );
+	return false;
+      }
+      vector<analysis> analyses;
+      for ( size_t i=0; i < num; ++i ){
+	analyses.push_back( make_pair( TiCC::UnicodeFromUTF8( parts[2+2*i] ),
+				       TiCC::UnicodeFromUTF8( parts[3+2*i] ) ) );
+      }
+      // later lines win
+      _entries[TiCC::UnicodeFromUTF8( parts[0] )] = analyses;
+    }
+    return true;
+  }
+
+  const vector<analysis> *AnalysisCache::find( const UnicodeString& key ) const {
+    auto it = _entries.find( key );
+    if ( it == _entries.end() ){
+      return 0;
+    }
+    return &it->second;
+  }
+
+  static bool is_storable( const UnicodeString& us ){
+    // TABs and newlines would break the file format
+    return us.indexOf( (UChar)'\t' ) < 0 && us.indexOf( (UChar)'\n' ) < 0;
+  }
+
+  void AnalysisCache::add( const UnicodeString& key,
+			   const vector<analysis>& analyses ){
+    if ( key.isEmpty() || !is_storable( key ) ){
+      return;
+    }
+    for ( const auto& ana : analyses ){
+      if ( !is_storable( ana.first ) || !is_storable( ana.second ) ){
+	return;
+      }
+    }
+    auto res = _entries.insert( make_pair( key, analyses ) );
+    if ( res.second ){
+      _new.push_back( key );
+    }
+  }
+
+  bool AnalysisCache::save( string& error ){
+    if ( _new.empty() ){
+      return true;
+    }
+    ofstream os( _filename, ios::app );
+    if ( !os ){
+      error = "unable to write the cache file: '" + _filename + "'";
+      return false;
+    }
+    for ( const auto& key : _new ){
+      const vector<analysis>& analyses = _entries[key];
+      os << _prefix << "\t" << key << "\t" << analyses.size();
+      for ( const auto& ana : analyses ){
+	os << "\t" << ana.first << "\t" << ana.second;
+      }
+      os << "\n";
+    }
+    if ( !os ){
+      error = "write error on the cache file: '" + _filename + "'";
+      return false;
+    }
+    _new.clear();
+    return true;
+  }
+
+}
@@ -0,0 +1,187 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <sstream>
+#include <set>
+#include "ticcutils/StringOps.h"
+#include "ticcutils/PrettyPrint.h"
+#include "ticcutils/Unicode.h"
+#include "unicode/ustream.h"
+#include "toad/checkers.h"
+
+using namespace std;
+using namespace icu;
+
+namespace Toad {
+
+  UnicodeString mbma_tag( const CLEX::Type& tag ){
+    ostringstream os;
+    os << tag;
+    return TiCC::UnicodeFromUTF8( os.str() );
+  }
+
+  bool split_test_line( UnicodeString& line,
+			UnicodeString& word,
+			vector<UnicodeString>& classes ){
+    line.trim();
+    classes = TiCC::split( line );
+    if ( classes.size() < 2 ){
+      return false;
+    }
+    word = classes[0];
+    word.toLower();
+    classes.erase( classes.begin() );
+    return true;
+  }
+
+  void mbma_analyze( Mbma& mbma,
+		     OwnedList<Rule>& rules,
+		     const UnicodeString& word,
+		     const vector<UnicodeString>& classes,
+		     bool deep,
+		     vector<analysis>& analyses ){
+    analyses.clear();
+    rules.reset( mbma.execute( word, "", classes ) );
+    for ( auto const& r : rules ){
+      analyses.push_back( make_pair( r->pretty_string( deep ),
+				     mbma_tag( r->tag ) ) );
+    }
+  }
+
+  void write_analyses( ostream& os,
+		       const UnicodeString& line,
+		       const UnicodeString& word,
+		       const vector<analysis>& analyses ){
+    if ( analyses.empty() ){
+      os << "no rule matched: " << line << endl;
+    }
+    else {
+      for ( auto const& ana : analyses ){
+	os << word << "==> " << ana.first << " " << ana.second << endl;
+      }
+    }
+  }
+
+  static bool get_analyses( Mbma& mbma,
+			    const AnalysisCache *cache,
+			    const UnicodeString& word,
+			    vector<pair<UnicodeString,string>>& anas ){
+    // returns true when 'word' had to be classified
+    if ( cache ){
+      const vector<analysis> *cached = cache->find( word );
+      if ( cached ){
+	anas.clear();
+	for ( const auto& ana : *cached ){
+	  anas.push_back( make_pair( ana.first,
+				     TiCC::UnicodeToUTF8( ana.second ) ) );
+	}
+	return false;
+      }
+    }
+    mbma.Classify( word, "" );
+    anas = mbma.getResults(true);
+    return true;
+  }
+
+  bool check_mbma_word( Mbma& mbma,
+			const AnalysisCache *cache,
+			const FrozenLexicon& lexicon,
+			const FrozenLexicon *mor_lexicon,
+			const UnicodeString& word,
+			ostream& os,
+			vector<analysis>& to_cache ){
+    UnicodeString ls = word;
+    ls.toLower();
+    if ( word != ls ){
+      return false;
+    }
+    vector<pair<UnicodeString,string>> anas;
+    bool classified = get_analyses( mbma, cache, ls, anas );
+    if ( classified ){
+      for ( const auto& ana : anas ){
+	to_cache.push_back( make_pair( ana.first,
+				       TiCC::UnicodeFromUTF8( ana.second ) ) );
+      }
+    }
+    set<UnicodeString> fails;
+    for ( const auto& ana : anas ){
+      UnicodeString flat = flatten(ana.first);
+      bool lem_found = false;
+      vector<UnicodeString> mors = TiCC::split_at_first_of( flat, "[]" );
+      bool first = true;
+      for ( const auto& mor : mors ){
+	UnicodeString mor1 = mor;
+	mor1.toLower();
+	if ( mor1 == word ){
+	  lem_found = true;
+	  break;
+	}
+	else if ( lexicon.contains(mor1) ){
+	  lem_found = true;
+	}
+	else if ( mor_lexicon
+		  && mor1.length() != 1
+		  && !first
+		  && !mor_lexicon->contains(mor1) ){
+	  fails.insert(mor1);
+	}
+	first = false;
+      }
+      if ( !lem_found ){
+	using TiCC::operator<<;
+	os << "UNK LEMMA " << word << " - " << ana << endl;
+      }
+      else if ( fails.size() > 0 ){
+	using TiCC::operator<<;
+	os << "UNK MOR ";
+	for ( const auto& f : fails ){
+	  os << "[" << f << "] ";
+	}
+	os << word << " - " << ana << endl;
+      }
+    }
+    return classified;
+  }
+
+  void check_lemma( Mblem& mblem,
+		    const FrozenLexicon& lexicon,
+		    const UnicodeString& word,
+		    vector<lemma_mismatch>& result ){
+    UnicodeString ls = word;
+    ls.toLower();
+    mblem.Classify( ls );
+    for ( auto const& r : mblem.getResult() ){
+      UnicodeString lem = r.first;
+      lem.toLower();
+      if ( lem != word
+	   && lem.length() >= 3
+	   && !lexicon.contains( lem ) ){
+	result.push_back( lemma_mismatch{ word, lem, r.second } );
+      }
+    }
+  }
+
+}
@@ -27,9 +27,11 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <algorithm>
 #include <set>
 #include <map>
 #include <string>
+#include <memory>
 #include <cstdlib>
 #include "timbl/TimblAPI.h"
 #include "ticcutils/StringOps.h"
@@ -40,6 +42,12 @@
 #include "ucto/tokenize.h"
 #include "frog/FrogAPI.h"
 #include "frog/mblem_mod.h"
+#include "toad/frozen_lexicon.h"
+#include "toad/checkers.h"
+#include "config.h"
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace	icu;
@@ -52,18 +60,20 @@ static string configDir = string(SYSCONF_PATH) + "/frog/nld/";
 static string configFileName = configDir + "frog.cfg";
 
 void usage(){
-  cerr << "checkmblem [-i inputfile]" << endl;
-}
-
-bool isException( const UnicodeString& s ){
-  if ( s.length() < 3 ){
-    return true;
-  }
-  return false;
+  cerr << "checkmblem [-i inputfile] [-j threads] [-L lexicon] "
+       << "[--tsv outfile]" << endl;
+  cerr << "\t -j <threads> check the lemmas in parallel, every thread has "
+       << "its own MBLEM." << endl;
+  cerr << "\t --tsv <outfile> write the mismatches as TAB separated "
+       << "word, lemma and tag" << endl
+       << "\t    to 'outfile' instead of to stderr." << endl;
+  cerr << "\t -L <lexicon> use a binary lexicon (made by makelex --mblem) "
+       << "instead of the words" << endl
+       << "\t    from the inputfile, sonar.lemmas and known.lemmas" << endl;
 }
 
 int main(int argc, char * const argv[] ) {
-  TiCC::CL_Options opts("i:","");
+  TiCC::CL_Options opts("i:j:L:","tsv:");
   try {
     opts.parse_args( argc, argv );
   }
@@ -74,60 +84,79 @@ int main(int argc, char * const argv[] ) {
   }
   string inpname = "mblem.lex";
   opts.extract( 'i', inpname );
+  int num_threads = 1;
+  string value;
+  if ( opts.extract( 'j', value ) ){
+    if ( !TiCC::stringTo( value, num_threads ) || num_threads < 1 ){
+      cerr << "invalid value for -j: " << value << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  string lexname;
+  opts.extract( 'L', lexname );
+  string tsv_name;
+  opts.extract( "tsv", tsv_name );
+  ofstream tsv;
+  if ( !tsv_name.empty() ){
+    tsv.open( tsv_name );
+    if ( !tsv ){
+      cerr << "could not create: '" << tsv_name << "'" << endl;
+      return EXIT_FAILURE;
+    }
+    tsv << "word\tlemma\ttag" << endl;
+  }
   ifstream bron( inpname );
   if ( !bron ){
     cerr << "could not open input file '" << inpname << "'" << endl;
     return EXIT_FAILURE;
   }
 
-  set<UnicodeString> lexicon;
-  cout << "building a lexicon from " << inpname << endl;
+  // read-only after this, so shared by all threads
+  Toad::FrozenLexicon lexicon;
   UnicodeString uline;
-  while ( TiCC::getline(bron, uline ) ){
-    vector<UnicodeString> parts = TiCC::split_at_first_of( uline, " \t" );
-    int num = int(parts.size());
-    if ( num != 3 ){
-      cerr << "Problem in line '" << uline << "' (to short?)" << endl;
-      continue;
-    }
-    UnicodeString word = parts[0];
-    word.toLower();
-    lexicon.insert( word );
-  }
-  cout << "found " << lexicon.size() << " words " << endl;
-  bron.close();
-  unsigned int count = 0;
-  bron.open( "sonar.lemmas" );
-  while ( TiCC::getline(bron, uline ) ){
-    if ( uline.isEmpty() ){
-      continue;
+  if ( !lexname.empty() ){
+    string error;
+    if ( !lexicon.open( lexname, error ) ){
+      cerr << error << endl;
+      return EXIT_FAILURE;
     }
-    ++count;
-    vector<UnicodeString> vec = TiCC::split( uline );
-    lexicon.insert( vec[0] );
+    cout << "loaded " << lexicon.size() << " words from " << lexname << endl;
   }
-  bron.close();
-  cout<< "added " << count << " words from sonar.lemmas" << endl;
-  count = 0;
-  bron.open( "known.lemmas" );
-  while ( TiCC::getline(bron, uline ) ){
-    if ( uline.isEmpty() ){
-      continue;
-    }
-    ++count;
-    vector<UnicodeString> vec = TiCC::split( uline );
-    lexicon.insert( vec[0] );
+  else {
+    Toad::LexiconBuilder builder;
+    cout << "building a lexicon from " << inpname << endl;
+    Toad::add_mblem_words( builder, inpname, &cerr );
+    cout << "found " << builder.size() << " words " << endl;
+    long count = Toad::add_first_fields( builder, "sonar.lemmas", false );
+    cout<< "added " << max( count, 0L ) << " words from sonar.lemmas" << endl;
+    count = Toad::add_first_fields( builder, "known.lemmas", false );
+    cout<< "added " << max( count, 0L ) << " words from known.lemmas" << endl;
+    lexicon.assign( builder );
   }
-  cout<< "added " << count << " words from known.lemmas" << endl;
-  bron.close();
-  Mblem myMblem(theErrLog);
   if ( !configuration.fill( configFileName ) ){
     cerr << "FAILED" << endl;
     exit( EXIT_FAILURE);
   }
-  myMblem.init( configuration );
+#ifdef HAVE_OPENMP
+  omp_set_num_threads( num_threads );
+#else
+  if ( num_threads > 1 ){
+    cerr << "no OpenMP support. Running on 1 thread" << endl;
+    num_threads = 1;
+  }
+#endif
+  vector<unique_ptr<Mblem>> mblems;
+  for ( int i=0; i < num_threads; ++i ){
+    mblems.emplace_back( new Mblem( theErrLog ) );
+    if ( !mblems.back()->init( configuration ) ){
+      cerr << "MBLEM Initialization failed." << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  bron.close();
   bron.open( inpname );
   cout << "checking the lemmas in " << inpname << endl;
+  vector<UnicodeString> words;
   while ( TiCC::getline(bron, uline ) ){
     vector<UnicodeString> parts = TiCC::split_at_first_of( uline, " \t" );
     int num = parts.size();
@@ -143,21 +172,33 @@ int main(int argc, char * const argv[] ) {
       // skip uppercases stuff
       continue;
     }
-    myMblem.Classify( ls );
-#define LONG
-#ifdef LONG
-    vector<pair<UnicodeString,UnicodeString> > res = myMblem.getResult();
-    for ( auto const& r : res ){
-      UnicodeString lem = r.first;
-      lem.toLower();
-      if ( lem != us
-	   && !isException( lem ) ){
-	if ( lexicon.find(lem) == lexicon.end() ){
-	  cerr << word << " ==> " << lem << endl;
+    words.push_back( word );
+  }
+  // check in blocks. The results are output in the order of the input.
+  const size_t block_size = 10000;
+  vector<vector<Toad::lemma_mismatch>> results;
+  for ( size_t start=0; start < words.size(); start += block_size ){
+    size_t end = min( start + block_size, words.size() );
+    results.assign( end - start, vector<Toad::lemma_mismatch>() );
+#pragma omp parallel for schedule(dynamic,64)
+    for ( size_t i=start; i < end; ++i ){
+      int thread = 0;
+#ifdef HAVE_OPENMP
+      thread = omp_get_thread_num();
+#endif
+      Toad::check_lemma( *mblems[thread], lexicon, words[i],
+			 results[i-start] );
+    }
+    for ( const auto& res : results ){
+      for ( const auto& mis : res ){
+	if ( tsv.is_open() ){
+	  tsv << mis.word << "\t" << mis.lemma << "\t" << mis.tag << endl;
+	}
+	else {
+	  cerr << mis.word << " ==> " << mis.lemma << endl;
 	}
       }
     }
-#endif
   }
   return 0;
 }
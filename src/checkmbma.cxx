@@ -27,11 +27,13 @@
 #include<getopt.h>
 #include<iostream>
 #include<fstream>
+#include<sstream>
 #include<vector>
 #include<set>
 #include<map>
 #include<string>
 #include<cstdlib>
+#include<memory>
 #include "timbl/TimblAPI.h"
 #include "ticcutils/StringOps.h"
 #include "ticcutils/PrettyPrint.h"
@@ -44,6 +46,13 @@
 #include "ucto/tokenize.h"
 #include "frog/FrogAPI.h"
 #include "frog/mbma_mod.h"
+#include "toad/frozen_lexicon.h"
+#include "toad/analysis_cache.h"
+#include "toad/checkers.h"
+#include "config.h"
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace	icu;
@@ -54,10 +63,9 @@ TiCC::Configuration configuration;
 static string configDir = string(SYSCONF_PATH) + "/frog/nld/";
 static string configFileName = configDir + "frog.cfg";
 
-Mbma myMbma(theErrLog);
-
-set<UnicodeString> lexicon;
-set<UnicodeString> mor_lexicon;
+// filled once in main(), after that only read. (shared by all threads)
+Toad::FrozenLexicon lexicon;
+Toad::FrozenLexicon mor_lexicon;
 
 bool isException( const string& s ){
   if ( s.size() < 2 )
@@ -66,57 +74,63 @@ bool isException( const string& s ){
 }
 
 void usage(){
-  cerr << "checkmbma [-h] [-m] [-S<limit>]" << endl;
+  cerr << "checkmbma [-h] [-m] [-S<limit>] [-j threads] [-L lexicon] "
+       << "[-M lexicon] [-C cachefile]" << endl;
   cerr << "check mbma-merged.lex for inconsistencies" << endl;
   cerr << "\t -m signal unknow morphemes too. (a lot!) " << endl;
+  cerr << "\t -j <threads> check the words in parallel. Every thread has "
+       << "its own MBMA." << endl
+       << "\t    The output is in the same order as for 1 thread." << endl;
+  cerr << "\t -L <lexicon> use a binary lemma lexicon (made by makelex "
+       << "--mbma) instead of" << endl
+       << "\t    mbma-merged.lex, sonar.lemmas and known.lemmas" << endl;
+  cerr << "\t -M <lexicon> use a binary morpheme lexicon instead of "
+       << "known.morphs" << endl;
+  cerr << "\t -C <cachefile> keep the MBMA analyses in 'cachefile'. Only "
+       << "words that" << endl
+       << "\t    are not in the cache for the current MBMA tree and "
+       << "settings" << endl
+       << "\t    are classified again." << endl;
 }
 
-void check_word( const UnicodeString& _word, bool doMor ){
-  UnicodeString uword = _word;
-  UnicodeString ls = uword;
-  ls.toLower();
-  if ( uword != ls ){
-    return;
-  }
-  myMbma.Classify( ls, "" );
-  vector<pair<UnicodeString,string>> anas = myMbma.getResults(true);
-  set<UnicodeString> fails;
-  for ( const auto& ana : anas ){
-    UnicodeString flat = flatten(ana.first);
-    bool lem_found = false;
-    vector<UnicodeString> mors = TiCC::split_at_first_of( flat, "[]" );
-    bool first = true;
-    for ( const auto& mor : mors ){
-      UnicodeString mor1 = mor;
-      mor1.toLower();
-      if ( mor1 == uword ){
-	lem_found = true;
-	break;
-      }
-      else if ( lexicon.find(mor1) != lexicon.end() ){
-	//	  cerr << "found lemma " << mor1 << endl;
-	lem_found = true;
-      }
-      else if ( doMor
-		&& mor1.length() != 1
-		&& !first
-		&& mor_lexicon.find(mor1) == mor_lexicon.end() ){
-	//	  cerr << "NOT found mor " << mor << endl;
-	fails.insert(mor1);
-      }
-      first = false;
+void check_words( vector<unique_ptr<Mbma>>& mbmas,
+		  Toad::AnalysisCache *cache,
+		  const vector<UnicodeString>& words,
+		  bool doMor ){
+  // check in blocks, every thread with its own Mbma.
+  // the results are output in the order of 'words'
+  const size_t block_size = 10000;
+  vector<string> results;
+  vector<vector<Toad::analysis>> fresh;
+  vector<char> classified;
+  for ( size_t start=0; start < words.size(); start += block_size ){
+    size_t end = min( start + block_size, words.size() );
+    results.assign( end - start, "" );
+    fresh.assign( end - start, vector<Toad::analysis>() );
+    classified.assign( end - start, 0 );
+#pragma omp parallel for schedule(dynamic,64)
+    for ( size_t i=start; i < end; ++i ){
+      int thread = 0;
+#ifdef HAVE_OPENMP
+      thread = omp_get_thread_num();
+#endif
+      ostringstream os;
+      classified[i-start] =
+	Toad::check_mbma_word( *mbmas[thread], cache,
+			       lexicon, doMor ? &mor_lexicon : 0,
+			       words[i], os, fresh[i-start] );
+      results[i-start] = os.str();
     }
-    if ( !lem_found ){
-      using TiCC::operator<<;
-      cerr << "UNK LEMMA " << _word << " - " << ana << endl;
-    }
-    else if ( fails.size() > 0 ){
-      using TiCC::operator<<;
-      cerr << "UNK MOR ";
-      for ( const auto& f : fails ){
-	cerr << "[" << f << "] ";
+    if ( cache ){
+      // adding is not thread safe, so do it here
+      for ( size_t i=start; i < end; ++i ){
+	if ( classified[i-start] ){
+	  cache->add( words[i], fresh[i-start] );
+	}
       }
-      cerr << _word << " - " << ana << endl;
+    }
+    for ( const auto& res : results ){
+      cerr << res;
     }
   }
 }
@@ -124,17 +138,36 @@ void check_word( const UnicodeString& _word, bool doMor ){
 int main(int argc, char * const argv[] ) {
   string lexname = "mbma-merged.lex";
   string inpname ;
+  string lemma_lexname;
+  string mor_lexname;
+  string cachename;
   bool doMor = false;
   bool testSonar = false;
   string debug;
   size_t limit = 0;
+  int num_threads = 1;
   int opt;
-  while ( (opt = getopt( argc, argv, "d:hmS:t:")) != -1 ){
+  while ( (opt = getopt( argc, argv, "C:d:hj:L:mM:S:t:")) != -1 ){
     switch ( opt ){
     case 'm': doMor = true; break;
+    case 'j':
+      if ( !TiCC::stringTo( optarg, num_threads ) || num_threads < 1 ){
+	cerr << "invalid value for -j: " << optarg << endl;
+	return EXIT_FAILURE;
+      }
+      break;
     case 'd':
       debug = optarg;
       break;
+    case 'C':
+      cachename = optarg;
+      break;
+    case 'L':
+      lemma_lexname = optarg;
+      break;
+    case 'M':
+      mor_lexname = optarg;
+      break;
     case 'S':
       testSonar = true;
       limit = std::stol( optarg );
@@ -152,59 +185,44 @@ int main(int argc, char * const argv[] ) {
     cerr << "could not open mbma file '" << lexname << "'" << endl;
     return EXIT_FAILURE;
   }
-
-  map<UnicodeString,size_t> test_lex;
-  cout << "building a lexicon from " << lexname << endl;
+  bron.close();
   UnicodeString uline;
-  while ( TiCC::getline( bron, uline ) ){
-    vector<UnicodeString> parts = TiCC::split_at( uline, " " );
-    if ( parts.size() < 2 ){
-      cerr << "Problem in line '" << uline << "' (to short?)" << endl;
-      continue;
+  string error;
+  if ( !lemma_lexname.empty() ){
+    if ( !lexicon.open( lemma_lexname, error ) ){
+      cerr << error << endl;
+      return EXIT_FAILURE;
     }
-    UnicodeString word = parts[0];
-    word.toLower();
-    int num = (int)parts.size()-1;
-    if ( word.length() != num ){
-      cerr << "Problem in line '" << uline << "' (" << word.length()
-	   << " letters, but got " << num << " morphemes)" << endl;
-      continue;
-    }
-    lexicon.insert( word );
+    cout << "loaded " << lexicon.size() << " lemmas from "
+	 << lemma_lexname << endl;
   }
-  cout << "found " << lexicon.size() << " words " << endl;
-  bron.close();
-  bron.open( "sonar.lemmas" );
-  while ( TiCC::getline(bron, uline ) ){
-    if ( uline.isEmpty() ) {
-      continue;
+  else {
+    Toad::LexiconBuilder builder;
+    cout << "building a lexicon from " << lexname << endl;
+    if ( Toad::add_mbma_words( builder, lexname, &cerr ) < 0 ){
+      cerr << "could not open mbma file '" << lexname << "'" << endl;
+      return EXIT_FAILURE;
     }
-    vector<UnicodeString> vec = TiCC::split( uline );
-    lexicon.insert( vec[0] );
+    cout << "found " << builder.size() << " words " << endl;
+    Toad::add_first_fields( builder, "sonar.lemmas", false );
+    cout << "added sonar lemmas, size is now: " << builder.size() << " words " << endl;
+    Toad::add_first_fields( builder, "known.lemmas", false );
+    cout << "added known lemmas, size is now: " << builder.size() << " words " << endl;
+    lexicon.assign( builder );
   }
-  bron.close();
-  cout << "added sonar lemmas, size is now: " << lexicon.size() << " words " << endl;
-  bron.open( "known.lemmas" );
-  while ( TiCC::getline(bron, uline ) ){
-    if ( uline.isEmpty() ){
-      continue;
+  if ( !mor_lexname.empty() ){
+    if ( !mor_lexicon.open( mor_lexname, error ) ){
+      cerr << error << endl;
+      return EXIT_FAILURE;
     }
-    vector<UnicodeString> vec = TiCC::split( uline );
-    lexicon.insert( vec[0] );
   }
-  bron.close();
-  cout << "added known lemmas, size is now: " << lexicon.size() << " words " << endl;
-  bron.open( "known.morphs" );
-  while ( TiCC::getline(bron, uline ) ){
-    if ( uline.isEmpty() ){
-      continue;
-    }
-    vector<UnicodeString> vec = TiCC::split( uline );
-    mor_lexicon.insert( vec[0] );
+  else {
+    Toad::LexiconBuilder builder;
+    Toad::add_first_fields( builder, "known.morphs", false );
+    mor_lexicon.assign( builder );
   }
-  bron.close();
   cout << "found " << mor_lexicon.size() << " known morphemes." << endl;
-  bron.close();
+  map<UnicodeString,size_t> test_lex;
   if ( testSonar ){
     bron.open( "sonar.words" );
     while ( TiCC::getline(bron, uline ) ){
@@ -231,11 +249,24 @@ int main(int argc, char * const argv[] ) {
   if ( !debug.empty() ){
     configuration.setatt( "debug", debug, "mbma" );
   }
-  myMbma.init( configuration );
+#ifdef HAVE_OPENMP
+  omp_set_num_threads( num_threads );
+#else
+  if ( num_threads > 1 ){
+    cerr << "no OpenMP support. Running on 1 thread" << endl;
+    num_threads = 1;
+  }
+#endif
+  vector<unique_ptr<Mbma>> mbmas;
+  for ( int i=0; i < num_threads; ++i ){
+    mbmas.emplace_back( new Mbma( theErrLog ) );
+    mbmas.back()->init( configuration );
+  }
+  vector<UnicodeString> words;
   if ( testSonar ){
     cout << "checking the morphemes in sonar.lemmas " << endl;
     for ( const auto& it : test_lex ){
-      check_word( it.first, doMor );
+      words.push_back( it.first );
     }
   }
   else if ( !inpname.empty() ){
@@ -243,7 +274,9 @@ int main(int argc, char * const argv[] ) {
     cout << "checking the morphemes in " << inpname << endl;
     while ( TiCC::getline(bron, uline ) ){
       vector<UnicodeString> parts = TiCC::split( uline );
-      check_word( parts[0], doMor );
+      if ( !parts.empty() ){
+	words.push_back( parts[0] );
+      }
     }
   }
   else {
@@ -251,7 +284,36 @@ int main(int argc, char * const argv[] ) {
     cout << "checking the morphemes in " << lexname << endl;
     while ( TiCC::getline(bron, uline ) ){
       vector<UnicodeString> parts = TiCC::split_at( uline, " " );
-      check_word( parts[0], doMor );
+      if ( !parts.empty() ){
+	words.push_back( parts[0] );
+      }
+    }
+  }
+  unique_ptr<Toad::AnalysisCache> cache;
+  if ( !cachename.empty() ){
+    uint64_t model_hash;
+    uint64_t config_hash;
+    if ( !Toad::mbma_fingerprint( configuration, model_hash, config_hash,
+				  error ) ){
+      cerr << error << endl;
+      return EXIT_FAILURE;
+    }
+    cache.reset( new Toad::AnalysisCache( cachename, model_hash,
+					  config_hash ) );
+    if ( !cache->load( error ) ){
+      cerr << error << endl;
+      return EXIT_FAILURE;
+    }
+    cout << "found " << cache->size() << " cached analyses in "
+	 << cachename << endl;
+  }
+  check_words( mbmas, cache.get(), words, doMor );
+  if ( cache ){
+    cout << "adding " << cache->added() << " analyses to " << cachename
+	 << endl;
+    if ( !cache->save( error ) ){
+      cerr << error << endl;
+      return EXIT_FAILURE;
     }
   }
   return 0;
@@ -39,6 +39,10 @@
 #include "ucto/tokenize.h"
 #include "unicode/ustream.h"
 #include "unicode/unistr.h"
+#include "toad/enrichment.h"
+#include "toad/compressed_input.h"
+#include "toad/temp_store.h"
+#include "toad/folia_reader.h"
 #include "config.h"
 
 using namespace std;
@@ -51,6 +55,7 @@ string EOS_MARK = "\n";
 
 static Configuration use_config;
 static Configuration default_config;
+static Toad::TempStore temp_store; // the data extracted from FoLiA
 
 void set_default_config(){
   default_config.setatt( "baseName", "chunkgen", "IOB" );
@@ -86,84 +91,54 @@ void usage( const string& name ){
        << "\t\t highly recommended to use, because a lot of files are created\n"
        << "\t\t and your working directory will get cluttered." << endl;
   cerr << "-b 'name' use 'name' as the label in the configfile." << endl;
+  cerr << "--pos-column K use the POS tags in column K of the inputfile,\n"
+       << "\t\t instead of tagging with MBT. The lines then have at least\n"
+       << "\t\t K+1 columns, with the IOB tag in the last one." << endl;
+  cerr << "--folia\t The inputfile is a FoLiA document, or a directory of them.\n"
+       << "\t\t The words and chunks are extracted from it." << endl;
+  cerr << "--folia-pos With --folia, use the POS tags of the FoLiA words,\n"
+       << "\t\t instead of tagging with MBT." << endl;
   cerr << "-X keep intermediate files." << endl;
   cerr << "-V or --version Show version information" << endl;
   cerr << "-h or --help Display this information." << endl;
 }
 
 
-void spit_out( ostream& os,
-	       const vector<Tagger::TagResult>& tagv,
-	       const vector<UnicodeString>& chunk_file_tags ){
-  vector<UnicodeString> words;
-  vector<UnicodeString> tags;
-  for( const auto& tr : tagv ){
-    words.push_back( tr.word() );
-    tags.push_back( tr.assigned_tag() );
-  }
-  UnicodeString prevP = "_";
-  for ( size_t i=0; i < words.size(); ++i ){
-    UnicodeString line = words[i] + "\t" + prevP + "\t" + tags[i] + "\t";
-    prevP = tags[i];
-    if ( i < words.size() - 1 ){
-      line += tags[i+1] + "\t";
-    }
-    else {
-      line += "_\t";
-    }
-    line += chunk_file_tags[i];
-    os << line << endl;
-  }
-}
-
 void create_train_file( MbtAPI *MyTagger,
 			const string& inpname,
-			const string& outname ){
+			const string& outname,
+			size_t pos_column ){
+  // without a tagger, the POS tags are taken from 'pos_column'
+  // of the input
+  string error;
+  Toad::EnrichmentWriter writer;
+  if ( !writer.init( error ) ){
+    cerr << error << endl;
+    exit(EXIT_FAILURE);
+  }
   ofstream os( outname );
-  ifstream is( inpname );
-  string line;
-  UnicodeString blob;
-  vector<UnicodeString> chunk_tags;
-  size_t HeartBeat = 0;
-  while ( getline( is, line ) ){
-    if ( line == "<utt>" ){
-      EOS_MARK = "<utt>";
-      line.clear();
-    }
-    if ( line.empty() ) {
-      if ( !blob.isEmpty() ){
-	vector<Tagger::TagResult> tagv = MyTagger->TagLine( blob );
-	spit_out( os, tagv, chunk_tags );
-	os << EOS_MARK << endl;
-	blob.remove();
-	if ( ++HeartBeat % 8000 == 0 ) {
-	  cout << endl;
-	}
-	if ( HeartBeat % 100 == 0 ) {
-	  cout << ".";
-	  cout.flush();
-	}
-	chunk_tags.clear();
-      }
-      continue;
-    }
-    vector<UnicodeString> parts = TiCC::split( TiCC::UnicodeFromUTF8(line) );
-    if ( parts.size() != 2 ){
-      cerr << "DOOD: " << line << endl;
-      exit(EXIT_FAILURE);
-    }
-    blob += parts[0] + "\n";
-    chunk_tags.push_back( parts[1] );
+  Toad::InputFile is( inpname );
+  if ( !is ){
+    cerr << is.error() << endl;
+    exit(EXIT_FAILURE);
   }
-  if ( !blob.isEmpty() ){
-    vector<Tagger::TagResult> tagv = MyTagger->TagLine( blob );
-    spit_out( os, tagv, chunk_tags );
+  bool utt = false;
+  if ( !Toad::enrich_corpus( is, os, MyTagger, pos_column, writer,
+			     &cout, utt, error ) ){
+    cerr << error << endl;
+    exit(EXIT_FAILURE);
+  }
+  if ( !is.error().empty() ){
+    cerr << is.error() << endl;
+    exit(EXIT_FAILURE);
+  }
+  if ( utt ){
+    EOS_MARK = "<utt>";
   }
-
 }
 
 int main(int argc, char * const argv[] ) {
-  TiCC::CL_Options opts("b:O:c:hVX","version");
+  TiCC::CL_Options opts("b:O:c:hVX","version,pos-column:,folia,folia-pos");
   try {
     opts.parse_args( argc, argv );
   }
@@ -192,6 +167,25 @@ int main(int argc, char * const argv[] ) {
     cout << "using configuration: " << configfile << endl;
   }
   bool keepX = opts.extract( 'X' );
+  bool use_folia = opts.extract( "folia" );
+  bool folia_pos = opts.extract( "folia-pos" );
+  if ( folia_pos && !use_folia ){
+    cerr << "option --folia-pos only allowed for --folia" << endl;
+    exit(EXIT_FAILURE);
+  }
+  size_t pos_column = 0;
+  string value;
+  if ( opts.extract( "pos-column", value ) ){
+    if ( !TiCC::stringTo( value, pos_column ) || pos_column < 2 ){
+      cerr << "invalid value for --pos-column: " << value << endl;
+      exit(EXIT_FAILURE);
+    }
+    if ( use_folia ){
+      cerr << "option --pos-column not allowed for --folia, "
+	   << "use --folia-pos" << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
   opts.extract( 'O', outputdir );
   if ( !outputdir.empty() ){
     if ( outputdir[outputdir.length()-1] != '/' )
@@ -267,21 +261,47 @@ int main(int argc, char * const argv[] ) {
     usage( opts.prog_name() );
     exit(EXIT_FAILURE);
   }
-  else if ( !TiCC::isFile( names[0] ) ){
+  else if ( !TiCC::isFile( names[0] )
+	    && !( use_folia && TiCC::isDir( names[0] ) ) ){
     cerr << "unable to open inputfile '" << names[0] << "'" << endl;
     exit(EXIT_FAILURE);
   }
-  MbtAPI *PosTagger = new MbtAPI( mbt_setting, mylog );
-  if ( !PosTagger->isInit() ){
-    exit( EXIT_FAILURE );
-  }
   string inpname = names[0];
+  if ( use_folia ){
+    // continue with a file of the words, (POS tags) and chunks
+    vector<Toad::folia_column> columns = { Toad::folia_column::WORD };
+    if ( folia_pos ){
+      columns.push_back( Toad::folia_column::POS );
+      pos_column = 2;
+    }
+    columns.push_back( Toad::folia_column::CHUNK );
+    inpname = outputdir + base_name + ".folia.data";
+    temp_store.keep( keepX );
+    cout << "extracting chunks from FoLiA: " << names[0] << endl;
+    Toad::folia_stats stats;
+    string error;
+    if ( !temp_store.create( inpname, error )
+	 || !Toad::folia_to_file( names[0], columns, "", inpname,
+				  stats, error ) ){
+      cerr << error << endl;
+      exit(EXIT_FAILURE);
+    }
+    stats.report( cout );
+  }
+  MbtAPI *PosTagger = 0;
+  if ( pos_column == 0 ){
+    PosTagger = new MbtAPI( mbt_setting, mylog );
+    if ( !PosTagger->isInit() ){
+      exit( EXIT_FAILURE );
+    }
+  }
   string outname = outputdir + base_name + ".data";
   string setting_name = outputdir + base_name + ".settings";
 
   cout << "Start converting: " << inpname
        << " (every dot represents 100 tagged sentences)" << endl;
-  create_train_file( PosTagger, inpname, outname );
+  create_train_file( PosTagger, inpname, outname, pos_column );
+  delete PosTagger;
   cout << endl << "Created a trainingfile: " << outname << endl;
 
   string taggercommand = "-E " + outname
@@ -0,0 +1,96 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include "ticcutils/StringOps.h"
+#include "toad/column_formatter.h"
+
+using namespace std;
+using namespace icu;
+
+namespace Toad {
+
+  bool ColumnFormatter::compile( const string& layout,
+				 const vector<string>& names,
+				 string& error ){
+    _layout = layout;
+    _fields.clear();
+    for ( const auto& spec : TiCC::split_at( layout, "," ) ){
+      field f;
+      f.offset = 0;
+      string name = TiCC::trim( spec );
+      string::size_type pos = name.find_first_of( "+-" );
+      if ( pos != string::npos ){
+	if ( !TiCC::stringTo( name.substr( pos+1 ), f.offset ) ){
+	  error = "invalid offset in column '" + spec + "'";
+	  return false;
+	}
+	if ( name[pos] == '-' ){
+	  f.offset = -f.offset;
+	}
+	name = name.substr( 0, pos );
+      }
+      f.column = names.size();
+      for ( size_t i=0; i < names.size(); ++i ){
+	if ( names[i] == name ){
+	  f.column = i;
+	  break;
+	}
+      }
+      if ( f.column == names.size() ){
+	error = "unknown column '" + name + "' in layout '" + layout + "'";
+	return false;
+      }
+      _fields.push_back( f );
+    }
+    if ( _fields.empty() ){
+      error = "empty layout";
+      return false;
+    }
+    return true;
+  }
+
+  void ColumnFormatter::format( const vector<const vector<UnicodeString>*>& columns,
+				string& out ) const {
+    long size = columns[0]->size();
+    for ( long i=0; i < size; ++i ){
+      for ( size_t f=0; f < _fields.size(); ++f ){
+	if ( f > 0 ){
+	  out += '\t';
+	}
+	long pos = i + _fields[f].offset;
+	if ( pos < 0 || pos >= size ){
+	  out += '_';
+	}
+	else {
+	  // appends the UTF-8, without a temporary string
+	  (*columns[_fields[f].column])[pos].toUTF8String( out );
+	}
+      }
+      out += '\n';
+    }
+  }
+
+}
@@ -0,0 +1,495 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <cstring>
+#include "toad/compressed_input.h"
+#include "config.h"
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace std;
+
+namespace Toad {
+
+  const size_t raw_size = 128*1024;   // compressed bytes read at once
+  const size_t chunk_size = 256*1024; // decompressed bytes per chunk
+  const size_t max_queued = 4;        // chunks the producer may be ahead
+
+  Compression detect_compression( const unsigned char *p, size_t len ){
+    if ( len >= 2 && p[0] == 0x1f && p[1] == 0x8b ){
+      return Compression::GZIP;
+    }
+    if ( len >= 6 && memcmp( p, "\xfd" "7zXZ\0", 6 ) == 0 ){
+      return Compression::XZ;
+    }
+    if ( len >= 4
+	 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd ){
+      return Compression::ZSTD;
+    }
+    return Compression::NONE;
+  }
+
+  string toString( Compression c ){
+    switch ( c ){
+    case Compression::GZIP:
+      return "gzip";
+    case Compression::XZ:
+      return "xz";
+    case Compression::ZSTD:
+      return "zstd";
+    default:
+      return "none";
+    }
+  }
+
+  // decodes as much of the input as fits in the output. 'in' and 'out'
+  // are advanced and their sizes decreased. 'last' is true when 'in'
+  // holds the final bytes of the file. 'ended' is set when all input
+  // is decoded.
+  class decoder {
+  public:
+    virtual ~decoder() {};
+    virtual bool decode( const char *& in, size_t& in_left,
+			 char *& out, size_t& out_left,
+			 bool last,
+			 bool& ended,
+			 string& error ) = 0;
+  };
+
+#ifdef HAVE_ZLIB
+  class gzip_decoder: public decoder {
+  public:
+    gzip_decoder(): _member_done( false ){
+      memset( &_strm, 0, sizeof(_strm) );
+      // 15 + 32: a gzip or zlib header, the window size from the header
+      _ok = ( inflateInit2( &_strm, 15 + 32 ) == Z_OK );
+    }
+    ~gzip_decoder() {
+      inflateEnd( &_strm );
+    }
+    bool decode( const char *& in, size_t& in_left,
+		 char *& out, size_t& out_left,
+		 bool last,
+		 bool& ended,
+		 string& error ) override {
+      if ( !_ok ){
+	error = "unable to initialize zlib";
+	return false;
+      }
+      if ( in_left == 0 && last && _member_done ){
+	ended = true;
+	return true;
+      }
+      _strm.next_in = reinterpret_cast<Bytef*>( const_cast<char*>( in ) );
+      _strm.avail_in = in_left;
+      _strm.next_out = reinterpret_cast<Bytef*>( out );
+      _strm.avail_out = out_left;
+      if ( in_left > 0 ){
+	_member_done = false;
+      }
+      int ret = inflate( &_strm, Z_NO_FLUSH );
+      in += in_left - _strm.avail_in;
+      in_left = _strm.avail_in;
+      out += out_left - _strm.avail_out;
+      out_left = _strm.avail_out;
+      if ( ret == Z_STREAM_END ){
+	// 'gzip -c a b' and pigz produce several members after each other
+	inflateReset( &_strm );
+	_member_done = true;
+	if ( in_left == 0 && last ){
+	  ended = true;
+	}
+	return true;
+      }
+      if ( ret != Z_OK && ret != Z_BUF_ERROR ){
+	error = string( "gzip: " ) + ( _strm.msg ? _strm.msg : "corrupt data" );
+	return false;
+      }
+      return true;
+    }
+  private:
+    z_stream _strm;
+    bool _ok;
+    bool _member_done;
+  };
+#endif
+
+#ifdef HAVE_LZMA
+  class xz_decoder: public decoder {
+  public:
+    xz_decoder(): _strm( LZMA_STREAM_INIT ){
+      _ok = ( lzma_stream_decoder( &_strm, UINT64_MAX,
+				   LZMA_CONCATENATED ) == LZMA_OK );
+    }
+    ~xz_decoder() {
+      lzma_end( &_strm );
+    }
+    bool decode( const char *& in, size_t& in_left,
+		 char *& out, size_t& out_left,
+		 bool last,
+		 bool& ended,
+		 string& error ) override {
+      if ( !_ok ){
+	error = "unable to initialize liblzma";
+	return false;
+      }
+      _strm.next_in = reinterpret_cast<const uint8_t*>( in );
+      _strm.avail_in = in_left;
+      _strm.next_out = reinterpret_cast<uint8_t*>( out );
+      _strm.avail_out = out_left;
+      lzma_ret ret = lzma_code( &_strm, last ? LZMA_FINISH : LZMA_RUN );
+      in += in_left - _strm.avail_in;
+      in_left = _strm.avail_in;
+      out += out_left - _strm.avail_out;
+      out_left = _strm.avail_out;
+      switch ( ret ){
+      case LZMA_STREAM_END:
+	ended = true;
+	return true;
+      case LZMA_OK:
+	return true;
+      case LZMA_BUF_ERROR:
+	// no progress possible. Only an error at the end of the file
+	if ( !last || out_left == 0 ){
+	  return true;
+	}
+	error = "xz: unexpected end of input";
+	return false;
+      case LZMA_MEM_ERROR:
+	error = "xz: out of memory";
+	return false;
+      case LZMA_FORMAT_ERROR:
+	error = "xz: not in .xz format";
+	return false;
+      default:
+	error = "xz: corrupt data";
+	return false;
+      }
+    }
+  private:
+    lzma_stream _strm;
+    bool _ok;
+  };
+#endif
+
+#ifdef HAVE_ZSTD
+  class zstd_decoder: public decoder {
+  public:
+    zstd_decoder(): _frame_done( false ){
+      _ctx = ZSTD_createDStream();
+    }
+    ~zstd_decoder() {
+      ZSTD_freeDStream( _ctx );
+    }
+    bool decode( const char *& in, size_t& in_left,
+		 char *& out, size_t& out_left,
+		 bool last,
+		 bool& ended,
+		 string& error ) override {
+      if ( !_ctx ){
+	error = "unable to initialize libzstd";
+	return false;
+      }
+      if ( in_left == 0 && last && _frame_done ){
+	ended = true;
+	return true;
+      }
+      ZSTD_inBuffer ib = { in, in_left, 0 };
+      ZSTD_outBuffer ob = { out, out_left, 0 };
+      size_t ret = ZSTD_decompressStream( _ctx, &ob, &ib );
+      if ( ZSTD_isError( ret ) ){
+	error = string( "zstd: " ) + ZSTD_getErrorName( ret );
+	return false;
+      }
+      in += ib.pos;
+      in_left -= ib.pos;
+      out += ob.pos;
+      out_left -= ob.pos;
+      // 0 means a frame is complete and flushed. Another one may follow
+      _frame_done = ( ret == 0 );
+      if ( _frame_done && in_left == 0 && last ){
+	ended = true;
+      }
+      return true;
+    }
+  private:
+    ZSTD_DStream *_ctx;
+    bool _frame_done;
+  };
+#endif
+
+  decoder *make_decoder( Compression type,
+			 const string& filename,
+			 string& error ){
+    switch ( type ){
+    case Compression::GZIP:
+#ifdef HAVE_ZLIB
+      return new gzip_decoder();
+#else
+      break;
+#endif
+    case Compression::XZ:
+#ifdef HAVE_LZMA
+      return new xz_decoder();
+#else
+      break;
+#endif
+    case Compression::ZSTD:
+#ifdef HAVE_ZSTD
+      return new zstd_decoder();
+#else
+      break;
+#endif
+    default:
+      return 0;
+    }
+    error = "'" + filename + "' is " + toString( type )
+      + " compressed, but toad was built without " + toString( type )
+      + " support";
+    return 0;
+  }
+
+  decompress_buf::decompress_buf():
+    _file( 0 ),
+    _type( Compression::NONE ),
+    _decoder( 0 ),
+    _done( false ),
+    _stop( false )
+  {
+    setg( 0, 0, 0 );
+  }
+
+  decompress_buf::~decompress_buf(){
+    close();
+  }
+
+  bool decompress_buf::open( const string& filename ){
+    close();
+    _error.clear();
+    _filename = filename;
+    _file = fopen( filename.c_str(), "rb" );
+    if ( !_file ){
+      _error = "unable to open '" + filename + "'";
+      return false;
+    }
+    _head.resize( 6 );
+    _head.resize( fread( _head.data(), 1, _head.size(), _file ) );
+    _type = detect_compression( reinterpret_cast<unsigned char*>( _head.data() ),
+				_head.size() );
+    if ( _type == Compression::NONE ){
+      // the first bytes are just the start of the text
+      _current = _head;
+      setg( _current.data(), _current.data(),
+	    _current.data() + _current.size() );
+      return true;
+    }
+    _decoder = make_decoder( _type, filename, _error );
+    if ( !_decoder ){
+      fclose( _file );
+      _file = 0;
+      return false;
+    }
+    _done = false;
+    _stop = false;
+    _producer = thread( &decompress_buf::produce, this );
+    return true;
+  }
+
+  void decompress_buf::close(){
+    if ( _producer.joinable() ){
+      {
+	lock_guard<mutex> lock( _mutex );
+	_stop = true;
+      }
+      _not_full.notify_all();
+      _producer.join();
+    }
+    if ( _file ){
+      fclose( _file );
+      _file = 0;
+    }
+    delete _decoder;
+    _decoder = 0;
+    _queue.clear();
+    _current.clear();
+    _type = Compression::NONE;
+    setg( 0, 0, 0 );
+  }
+
+  string decompress_buf::error() const {
+    lock_guard<mutex> lock( _mutex );
+    return _error;
+  }
+
+  void decompress_buf::set_error( const string& error ){
+    lock_guard<mutex> lock( _mutex );
+    _error = error;
+  }
+
+  bool decompress_buf::push( vector<char>& chunk ){
+    // false when the reader stopped
+    unique_lock<mutex> lock( _mutex );
+    _not_full.wait( lock,
+		    [this]{ return _stop || _queue.size() < max_queued; } );
+    if ( _stop ){
+      return false;
+    }
+    _queue.push_back( std::move( chunk ) );
+    lock.unlock();
+    _not_empty.notify_one();
+    return true;
+  }
+
+  void decompress_buf::produce(){
+    // runs in its own thread
+    vector<char> raw = _head;
+    raw.reserve( raw_size );
+    size_t raw_len = raw.size();
+    size_t raw_pos = 0;
+    bool last = false;
+    vector<char> chunk( chunk_size );
+    size_t filled = 0;
+    bool ended = false;
+    string error;
+    while ( !ended ){
+      if ( raw_pos == raw_len && !last ){
+	raw.resize( raw_size );
+	raw_len = fread( raw.data(), 1, raw.size(), _file );
+	raw_pos = 0;
+	if ( raw_len < raw.size() ){
+	  if ( ferror( _file ) ){
+	    error = "read error on '" + _filename + "'";
+	    break;
+	  }
+	  last = true;
+	}
+      }
+      const char *in = raw.data() + raw_pos;
+      size_t in_left = raw_len - raw_pos;
+      char *out = chunk.data() + filled;
+      size_t out_left = chunk.size() - filled;
+      if ( !_decoder->decode( in, in_left, out, out_left,
+			      last, ended, error ) ){
+	break;
+      }
+      bool progress = ( raw_len - raw_pos != in_left )
+	|| ( chunk.size() - filled != out_left );
+      raw_pos = raw_len - in_left;
+      filled = chunk.size() - out_left;
+      if ( filled == chunk.size() || ( ended && filled > 0 ) ){
+	chunk.resize( filled );
+	if ( !push( chunk ) ){
+	  return;
+	}
+	chunk.resize( chunk_size );
+	filled = 0;
+      }
+      else if ( !ended && !progress && last && raw_pos == raw_len ){
+	error = "'" + _filename + "' is truncated";
+	break;
+      }
+    }
+    if ( !error.empty() && filled > 0 ){
+      // hand over what was decoded before the problem
+      chunk.resize( filled );
+      push( chunk );
+    }
+    lock_guard<mutex> lock( _mutex );
+    if ( !error.empty() ){
+      _error = error;
+    }
+    _done = true;
+    _not_empty.notify_all();
+  }
+
+  decompress_buf::int_type decompress_buf::underflow(){
+    if ( gptr() < egptr() ){
+      return traits_type::to_int_type( *gptr() );
+    }
+    if ( !_file ){
+      return traits_type::eof();
+    }
+    if ( _type == Compression::NONE ){
+      _current.resize( chunk_size );
+      size_t len = fread( _current.data(), 1, _current.size(), _file );
+      if ( len == 0 ){
+	if ( ferror( _file ) ){
+	  set_error( "read error on '" + _filename + "'" );
+	}
+	return traits_type::eof();
+      }
+      setg( _current.data(), _current.data(), _current.data() + len );
+      return traits_type::to_int_type( *gptr() );
+    }
+    unique_lock<mutex> lock( _mutex );
+    _not_empty.wait( lock, [this]{ return _done || !_queue.empty(); } );
+    if ( _queue.empty() ){
+      return traits_type::eof();
+    }
+    _current.swap( _queue.front() );
+    _queue.pop_front();
+    lock.unlock();
+    _not_full.notify_one();
+    setg( _current.data(), _current.data(),
+	  _current.data() + _current.size() );
+    return traits_type::to_int_type( *gptr() );
+  }
+
+  InputFile::InputFile():
+    istream( 0 )
+  {
+    rdbuf( &_buf );
+    setstate( ios::failbit );
+  }
+
+  InputFile::InputFile( const string& filename ):
+    istream( 0 )
+  {
+    rdbuf( &_buf );
+    open( filename );
+  }
+
+  bool InputFile::open( const string& filename ){
+    if ( _buf.open( filename ) ){
+      clear();
+      return true;
+    }
+    setstate( ios::failbit );
+    return false;
+  }
+
+  void InputFile::close(){
+    _buf.close();
+  }
+
+}
@@ -0,0 +1,252 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <algorithm>
+#include <queue>
+#include "toad/edit_script.h"
+
+using namespace std;
+using namespace icu;
+
+namespace Toad {
+
+  UnicodeString edit_script::label() const {
+    UnicodeString result;
+    if ( !prefixed.isEmpty() ){
+      result += "+P" + prefixed;
+    }
+    if ( !deleted.isEmpty() ){
+      result += "+D" + deleted;
+    }
+    if ( !inserted.isEmpty() ){
+      result += "+I" + inserted;
+    }
+    return result;
+  }
+
+  int common_prefix( const UnicodeString& s1, const UnicodeString& s2 ){
+    int len = min( s1.length(), s2.length() );
+    const UChar *b1 = s1.getBuffer();
+    const UChar *b2 = s2.getBuffer();
+    int ident = 0;
+    while ( ident < len && b1[ident] == b2[ident] ){
+      ++ident;
+    }
+    return ident;
+  }
+
+  ParticleAutomaton::ParticleAutomaton( const vector<UnicodeString>& parts ):
+    _particles( parts )
+  {
+    _nodes.push_back( node{ {}, 0, -1, -1 } );
+    // build the trie
+    for ( size_t p=0; p < _particles.size(); ++p ){
+      const UnicodeString& part = _particles[p];
+      if ( part.isEmpty() ){
+	// never matches, like UnicodeString::indexOf()
+	continue;
+      }
+      int state = 0;
+      for ( int i=0; i < part.length(); ++i ){
+	UChar c = part[i];
+	int next = child( state, c );
+	if ( next < 0 ){
+	  next = _nodes.size();
+	  _nodes.push_back( node{ {}, 0, -1, -1 } );
+	  auto& kids = _nodes[state].next;
+	  auto pos = lower_bound( kids.begin(), kids.end(),
+				  make_pair( c, 0 ) );
+	  kids.insert( pos, make_pair( c, next ) );
+	}
+	state = next;
+      }
+      if ( _nodes[state].out < 0 ){
+	_nodes[state].out = p;
+      }
+    }
+    // add the failure links, breadth first
+    queue<int> todo;
+    for ( const auto& kid : _nodes[0].next ){
+      todo.push( kid.second );
+    }
+    while ( !todo.empty() ){
+      int state = todo.front();
+      todo.pop();
+      for ( const auto& kid : _nodes[state].next ){
+	int f = _nodes[state].fail;
+	int next = child( f, kid.first );
+	while ( next < 0 && f != 0 ){
+	  f = _nodes[f].fail;
+	  next = child( f, kid.first );
+	}
+	node& k = _nodes[kid.second];
+	k.fail = ( next < 0 ) ? 0 : next;
+	const node& fn = _nodes[k.fail];
+	k.out_link = ( fn.out >= 0 ) ? k.fail : fn.out_link;
+	todo.push( kid.second );
+      }
+    }
+  }
+
+  int ParticleAutomaton::child( int state, UChar c ) const {
+    const auto& kids = _nodes[state].next;
+    auto it = lower_bound( kids.begin(), kids.end(), make_pair( c, 0 ) );
+    if ( it != kids.end() && it->first == c ){
+      return it->second;
+    }
+    return -1;
+  }
+
+  void ParticleAutomaton::first_positions( const UnicodeString& word,
+					   vector<int>& first ) const {
+    // fill 'first' with the position of the first occurrence of every
+    // particle in 'word' (-1 when absent)
+    first.assign( _particles.size(), -1 );
+    int state = 0;
+    for ( int i=0; i < word.length(); ++i ){
+      UChar c = word[i];
+      int next = child( state, c );
+      while ( next < 0 && state != 0 ){
+	state = _nodes[state].fail;
+	next = child( state, c );
+      }
+      state = ( next < 0 ) ? 0 : next;
+      int o = ( _nodes[state].out >= 0 ) ? state : _nodes[state].out_link;
+      while ( o >= 0 ){
+	int p = _nodes[o].out;
+	if ( first[p] < 0 ){
+	  first[p] = i - _particles[p].length() + 1;
+	}
+	o = _nodes[o].out_link;
+      }
+    }
+  }
+
+  static vector<UnicodeString> collect_particles( const map<UnicodeString,
+						  set<UnicodeString>>& parts ){
+    vector<UnicodeString> result;
+    for ( const auto& it : parts ){
+      for ( const auto& part : it.second ){
+	if ( find( result.begin(), result.end(), part ) == result.end() ){
+	  result.push_back( part );
+	}
+      }
+    }
+    return result;
+  }
+
+  EditScripter::EditScripter( const map<UnicodeString,
+			      set<UnicodeString>>& parts ):
+    _automaton( collect_particles( parts ) )
+  {
+    for ( const auto& it : parts ){
+      vector<int> indices;
+      for ( const auto& part : it.second ){
+	for ( size_t i=0; i < _automaton.size(); ++i ){
+	  if ( _automaton.particle(i) == part ){
+	    indices.push_back( i );
+	    break;
+	  }
+	}
+      }
+      _tag_parts.push_back( make_pair( it.first, indices ) );
+    }
+  }
+
+  vector<int> EditScripter::candidates( const UnicodeString& tag ) const {
+    // all particles that might be removed for this tag, in the order
+    // in which they are tried. Duplicates are useless, as the result of
+    // a try doesn't depend on the tag part it came from.
+    vector<int> result;
+    for ( const auto& it : _tag_parts ){
+      if ( tag.indexOf( it.first ) >= 0 ){
+	for ( const auto& p : it.second ){
+	  if ( find( result.begin(), result.end(), p ) == result.end() ){
+	    result.push_back( p );
+	  }
+	}
+      }
+    }
+    return result;
+  }
+
+  void EditScripter::add_tag( const UnicodeString& tag ){
+    if ( _tag_index.find( tag ) == _tag_index.end() ){
+      _tag_index[tag] = candidates( tag );
+    }
+  }
+
+  edit_script EditScripter::derive( const UnicodeString& word,
+				    const UnicodeString& lemma,
+				    const UnicodeString& tag ) const {
+    edit_script result;
+    vector<int> computed;
+    const vector<int> *cands;
+    auto it = _tag_index.find( tag );
+    if ( it != _tag_index.end() ){
+      cands = &it->second;
+    }
+    else {
+      computed = candidates( tag );
+      cands = &computed;
+    }
+    UnicodeString thisform = word;
+    if ( !cands->empty() ){
+      //  find out whether there may be a prefix or infix particle
+      vector<int> first;
+      _automaton.first_positions( word, first );
+      for ( const auto& p : *cands ){
+	int part_pos = first[p];
+	//
+	// A bit tricky here
+	// We remove the first particle
+	// the last would be better (e.g 'tegemoetgekomen' )
+	// but then frogs mblem module needs modification too
+	// need more thinking. Are there counterexamples?
+	if ( part_pos < 0
+	     || part_pos >= word.length()-5 ){
+	  continue;
+	}
+	const UnicodeString& part = _automaton.particle( p );
+	UnicodeString edit = word;
+	edit.remove( part_pos, part.length() );
+	if ( common_prefix( edit, lemma ) < 5 ){
+	  // so we want at least 5 characters in common between lemma and
+	  // our edit. Otherwise discard.
+	  continue;
+	}
+	result.prefixed = part;
+	thisform = edit;
+	break;
+      }
+    }
+    int ident = common_prefix( thisform, lemma );
+    result.deleted.setTo( thisform, ident );
+    result.inserted.setTo( lemma, ident );
+    return result;
+  }
+
+}
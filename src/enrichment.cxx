@@ -0,0 +1,245 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include "ticcutils/StringOps.h"
+#include "ticcutils/Unicode.h"
+#include "unicode/ustream.h"
+#include "toad/sentence_batch.h"
+#include "toad/enrichment.h"
+
+using namespace std;
+using namespace icu;
+
+namespace Toad {
+
+  const string chunk_layout = "word,tag-1,tag,tag+1,label";
+  const string ner_layout = "word,tag-1,tag,tag+1,gaz-1,gaz,gaz+1,label";
+
+  bool EnrichmentWriter::init( string& error ){
+    if ( _ner ){
+      return _formatter.compile( ner_layout,
+				 { "word", "tag", "gaz", "label" },
+				 error );
+    }
+    return _formatter.compile( chunk_layout,
+			       { "word", "tag", "label" },
+			       error );
+  }
+
+  void EnrichmentWriter::write( ostream& os,
+				const vector<UnicodeString>& words,
+				const vector<UnicodeString>& tags,
+				const vector<UnicodeString>& labels,
+				bool utt,
+				bool unterminated ){
+    _buffer.clear();
+    if ( !_ner ){
+      _formatter.format( { &words, &tags, &labels }, _buffer );
+      if ( !unterminated ){
+	_buffer += utt ? "<utt>\n" : "\n\n";
+      }
+      os.write( _buffer.data(), _buffer.size() );
+      return;
+    }
+    _gazet_tags = _ner->create_ner_list( words );
+    const vector<UnicodeString> *output_labels = &labels;
+    if ( _override ){
+      // the buffers keep their capacity, so this doesn't allocate once
+      // they are large enough
+      size_t len = labels.size();
+      _merged.resize( len );
+      _gazet_ners.resize( len );
+      _labels.resize( len );
+      for ( size_t i=0; i < len; ++i ){
+	_merged[i].first = labels[i];
+	_merged[i].second = 1.0;
+	_gazet_ners[i].first = _gazet_tags[i];
+	_gazet_ners[i].second = 1.0;
+      }
+      _ner->merge_override( _merged, _gazet_ners, false, tags );
+      for ( size_t i=0; i < len; ++i ){
+	_labels[i] = _merged[i].first;
+      }
+      output_labels = &_labels;
+    }
+    _formatter.format( { &words, &tags, &_gazet_tags, output_labels },
+		       _buffer );
+    // one empty line, no spurious newlines
+    _buffer += utt ? "<utt>\n" : "\n";
+    os.write( _buffer.data(), _buffer.size() );
+  }
+
+  static void heartbeat( ostream *progress, size_t& count ){
+    if ( !progress ){
+      return;
+    }
+    if ( ++count % 8000 == 0 ) {
+      *progress << endl;
+    }
+    if ( count % 100 == 0 ) {
+      *progress << ".";
+      progress->flush();
+    }
+  }
+
+  bool enrich_corpus( istream& is,
+		      ostream& os,
+		      MbtAPI *tagger,
+		      size_t pos_column,
+		      EnrichmentWriter& writer,
+		      ostream *progress,
+		      bool& utt,
+		      string& error ){
+    // the batch and result buffers are reused for every batch.
+    const size_t batch_size = 1000;
+    SentenceReader reader( is, pos_column );
+    BatchTagger batch_tagger( tagger );
+    vector<labeled_sentence> batch;
+    vector<vector<Tagger::TagResult>> results;
+    vector<UnicodeString> words;
+    vector<UnicodeString> tags;
+    size_t count = 0;
+    size_t num;
+    while ( (num = reader.read_batch( batch, batch_size, error )) > 0 ){
+      if ( reader.saw_utt() ){
+	utt = true;
+      }
+      if ( tagger ){
+	batch_tagger.tag( batch, num, results );
+      }
+      for ( size_t i=0; i < num; ++i ){
+	bool unterminated = ( i == num-1 && reader.unterminated() );
+	if ( tagger ){
+	  words.clear();
+	  tags.clear();
+	  for( const auto& tr : results[i] ){
+	    words.push_back( tr.word() );
+	    tags.push_back( tr.assigned_tag() );
+	  }
+	  writer.write( os, words, tags, batch[i].labels, utt, unterminated );
+	}
+	else {
+	  writer.write( os, batch[i].words, batch[i].tags, batch[i].labels,
+			utt, unterminated );
+	}
+	heartbeat( progress, count );
+      }
+    }
+    if ( !error.empty() ){
+      return false;
+    }
+    if ( progress ){
+      *progress << endl;
+      if ( tagger ){
+	batch_tagger.report( *progress );
+      }
+    }
+    return true;
+  }
+
+  UnicodeString gazetteer_tag( const UnicodeString& label ){
+    vector<UnicodeString> parts = TiCC::split_at( label, "+" );
+    if ( parts.size() > 1 ){
+      // undecided
+      return "O";
+    }
+    else {
+      return parts[0];
+    }
+  }
+
+  static void bootstrap_sentence( ostream& os,
+				  NERTagger& ner,
+				  const vector<UnicodeString>& words,
+				  bool utt ){
+    vector<UnicodeString> gazet_tags = ner.create_ner_list( words );
+    UnicodeString prev_tag;
+    for ( size_t i=0; i < words.size(); ++i ){
+      UnicodeString line = words[i] + "\t";
+      UnicodeString tag = gazetteer_tag( gazet_tags[i] );
+      if ( tag != "O" ){
+	if ( tag == prev_tag ) {
+	  line += "I-";
+	}
+	else {
+	  line += "B-";
+	}
+	prev_tag = tag;
+      }
+      line += tag;
+      os << line << endl;
+    }
+    if ( utt ){
+      os << "<utt>" << endl;
+    }
+    else {
+      // avoid spurious newlines!
+      os << endl;
+    }
+  }
+
+  bool bootstrap_corpus( istream& is,
+			 ostream& os,
+			 NERTagger& ner,
+			 bool running,
+			 ostream *progress,
+			 bool& utt,
+			 string& error ){
+    string line;
+    vector<UnicodeString> words;
+    size_t count = 0;
+    while ( getline( is, line ) ){
+      if ( line == "<utt>" ){
+	utt = true;
+	line.clear();
+      }
+      if ( line.empty() ) {
+	if ( !words.empty() ){
+	  bootstrap_sentence( os, ner, words, utt );
+	  heartbeat( progress, count );
+	  words.clear();
+	}
+	continue;
+      }
+      vector<UnicodeString> parts = TiCC::split( TiCC::UnicodeFromUTF8(line) );
+      if ( running ){
+	bootstrap_sentence( os, ner, parts, utt );
+      }
+      else if ( parts.size() == 2 ){
+	words.push_back( parts[0] );
+      }
+      else {
+	error = "DOOD: " + line;
+	return false;
+      }
+    }
+    if ( !words.empty() ){
+      bootstrap_sentence( os, ner, words, utt );
+    }
+    return true;
+  }
+
+}
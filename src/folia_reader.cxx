@@ -0,0 +1,465 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <algorithm>
+#include <set>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include "libxml/parser.h"
+#include "ticcutils/FileUtils.h"
+#include "ticcutils/StringOps.h"
+#include "toad/folia_reader.h"
+
+using namespace std;
+
+namespace Toad {
+
+  // subtrees that hold no annotations of the text itself
+  const set<string> skipped_elements = { "alt", "altlayers", "original",
+					 "suggestion", "morphology",
+					 "metadata", "foreign-data" };
+
+  string attribute( xmlTextReaderPtr reader, const char *name ){
+    xmlChar *value = xmlTextReaderGetAttribute( reader, (const xmlChar*)name );
+    if ( !value ){
+      return "";
+    }
+    string result = (const char*)value;
+    xmlFree( value );
+    return result;
+  }
+
+  string xml_id( xmlTextReaderPtr reader ){
+    xmlChar *value = xmlTextReaderGetAttributeNs( reader,
+						  (const xmlChar*)"id",
+						  XML_XML_NAMESPACE );
+    if ( !value ){
+      return "";
+    }
+    string result = (const char*)value;
+    xmlFree( value );
+    return result;
+  }
+
+  FoliaReader::FoliaReader():
+    _reader( 0 ),
+    _word_depth( -1 ),
+    _text_depth( -1 ),
+    _dangling( 0 )
+  {}
+
+  FoliaReader::~FoliaReader(){
+    if ( _reader ){
+      xmlFreeTextReader( _reader );
+    }
+  }
+
+  int FoliaReader::read_cb( void *context, char *buffer, int len ){
+    FoliaReader *fr = static_cast<FoliaReader*>( context );
+    fr->_is.read( buffer, len );
+    int got = fr->_is.gcount();
+    if ( got == 0 && !fr->_is.error().empty() ){
+      return -1;
+    }
+    return got;
+  }
+
+  int FoliaReader::close_cb( void * ){
+    // the InputFile is closed by open() and the destructor
+    return 0;
+  }
+
+  void FoliaReader::error_cb( void *context,
+			      const char *msg,
+			      xmlParserSeverities severity,
+			      xmlTextReaderLocatorPtr locator ){
+    FoliaReader *fr = static_cast<FoliaReader*>( context );
+    if ( severity != XML_PARSER_SEVERITY_ERROR
+	 || !fr->_error.empty() ){
+      // warnings, and errors after the first
+      return;
+    }
+    fr->_error = fr->_filename + ":"
+      + TiCC::toString( xmlTextReaderLocatorLineNumber( locator ) )
+      + ": " + TiCC::trim( msg );
+  }
+
+  bool FoliaReader::open( const string& filename, string& error ){
+    if ( _reader ){
+      xmlFreeTextReader( _reader );
+      _reader = 0;
+    }
+    _is.close();
+    _filename = filename;
+    _error.clear();
+    _sentences.clear();
+    _spans.clear();
+    _word_depth = -1;
+    _text_depth = -1;
+    _dangling = 0;
+    if ( !_is.open( filename ) ){
+      error = _is.error();
+      return false;
+    }
+    _reader = xmlReaderForIO( read_cb, close_cb, this, filename.c_str(), 0,
+			      XML_PARSE_NONET | XML_PARSE_HUGE );
+    if ( !_reader ){
+      error = "unable to read '" + filename + "' as XML";
+      return false;
+    }
+    xmlTextReaderSetErrorHandler( _reader, error_cb, this );
+    return true;
+  }
+
+  void FoliaReader::start_element( const string& name, int depth ){
+    if ( name == "s" ){
+      _sentences.emplace_back();
+    }
+    else if ( name == "w" ){
+      _word = folia_word();
+      _word.id = xml_id( _reader );
+      _word_depth = depth;
+    }
+    else if ( _word_depth >= 0 ){
+      if ( depth != _word_depth + 1 ){
+	return;
+      }
+      if ( name == "t" && _word.text.empty() ){
+	string cls = attribute( _reader, "class" );
+	if ( cls.empty() || cls == "current" ){
+	  _text_depth = depth;
+	}
+      }
+      else if ( name == "pos" && _word.pos.empty() ){
+	_word.pos = attribute( _reader, "class" );
+      }
+      else if ( name == "lemma" && _word.lemma.empty() ){
+	_word.lemma = attribute( _reader, "class" );
+      }
+    }
+    else if ( name == "chunk" || name == "entity" ){
+      open_span span;
+      span.entity = ( name == "entity" );
+      span.cls = attribute( _reader, "class" );
+      _spans.push_back( span );
+    }
+    else if ( name == "wref" && !_spans.empty() ){
+      _spans.back().refs.push_back( attribute( _reader, "id" ) );
+    }
+  }
+
+  void FoliaReader::close_span(){
+    // IOB tags on the words of the span, unless they already have one
+    open_span span = _spans.back();
+    _spans.pop_back();
+    vector<pair<size_t,size_t>> found; // (sentence, word)
+    for ( const auto& ref : span.refs ){
+      bool known = false;
+      for ( size_t s=_sentences.size(); s-- > 0; ){
+	auto it = _sentences[s].ids.find( ref );
+	if ( it != _sentences[s].ids.end() ){
+	  found.push_back( make_pair( s, it->second ) );
+	  known = true;
+	  break;
+	}
+      }
+      if ( !known ){
+	++_dangling;
+      }
+    }
+    sort( found.begin(), found.end() );
+    for ( size_t i=0; i < found.size(); ++i ){
+      folia_word& word = _sentences[found[i].first].words[found[i].second];
+      string& tag = span.entity ? word.entity : word.chunk;
+      if ( tag.empty() ){
+	tag = ( i == 0 ? "B-" : "I-" ) + span.cls;
+      }
+    }
+  }
+
+  bool FoliaReader::end_element( const string& name,
+				 int depth,
+				 vector<folia_word>& sentence ){
+    // returns true when a sentence is complete
+    if ( _text_depth >= 0 ){
+      if ( name == "t" && depth == _text_depth ){
+	_word.text = TiCC::trim( _word.text );
+	_text_depth = -1;
+      }
+    }
+    else if ( name == "w" && depth == _word_depth ){
+      if ( !_sentences.empty() ){
+	open_sentence& s = _sentences.back();
+	s.ids[_word.id] = s.words.size();
+	s.words.push_back( _word );
+      }
+      _word_depth = -1;
+    }
+    else if ( ( name == "chunk" || name == "entity" ) && !_spans.empty() ){
+      close_span();
+    }
+    else if ( name == "s" && !_sentences.empty() ){
+      sentence.swap( _sentences.back().words );
+      _sentences.pop_back();
+      return !sentence.empty();
+    }
+    return false;
+  }
+
+  bool FoliaReader::next( vector<folia_word>& sentence, string& error ){
+    sentence.clear();
+    if ( !_reader ){
+      return false;
+    }
+    int ret = xmlTextReaderRead( _reader );
+    while ( ret == 1 ){
+      int type = xmlTextReaderNodeType( _reader );
+      if ( type == XML_READER_TYPE_ELEMENT ){
+	string name = (const char*)xmlTextReaderConstLocalName( _reader );
+	int depth = xmlTextReaderDepth( _reader );
+	bool empty = xmlTextReaderIsEmptyElement( _reader );
+	if ( skipped_elements.find( name ) != skipped_elements.end() ){
+	  // on to whatever follows the subtree
+	  ret = xmlTextReaderNext( _reader );
+	  continue;
+	}
+	start_element( name, depth );
+	if ( empty && end_element( name, depth, sentence ) ){
+	  return true;
+	}
+      }
+      else if ( type == XML_READER_TYPE_END_ELEMENT ){
+	string name = (const char*)xmlTextReaderConstLocalName( _reader );
+	if ( end_element( name, xmlTextReaderDepth( _reader ), sentence ) ){
+	  return true;
+	}
+      }
+      else if ( _text_depth >= 0
+		&& ( type == XML_READER_TYPE_TEXT
+		     || type == XML_READER_TYPE_CDATA
+		     || type == XML_READER_TYPE_SIGNIFICANT_WHITESPACE ) ){
+	_word.text += (const char*)xmlTextReaderConstValue( _reader );
+      }
+      ret = xmlTextReaderRead( _reader );
+    }
+    if ( ret < 0 || !_error.empty() ){
+      error = _error.empty() ? "XML error in '" + _filename + "'" : _error;
+    }
+    if ( !_is.error().empty() ){
+      error = _is.error();
+    }
+    xmlFreeTextReader( _reader );
+    _reader = 0;
+    _is.close();
+    return false;
+  }
+
+  vector<string> folia_files( const string& name ){
+    vector<string> result;
+    if ( TiCC::isDir( name ) ){
+      result = TiCC::searchFilesMatch( name, "*.xml*", true );
+      sort( result.begin(), result.end() );
+    }
+    else {
+      result.push_back( name );
+    }
+    return result;
+  }
+
+  bool usable( const vector<folia_word>& sentence,
+	       const vector<folia_column>& columns ){
+    // all values are present, and don't break the column format
+    for ( const auto& word : sentence ){
+      if ( word.text.empty()
+	   || word.text.find_first_of( " \t\r\n" ) != string::npos ){
+	return false;
+      }
+      for ( const auto& col : columns ){
+	if ( col == folia_column::LEMMA
+	     && ( word.lemma.empty()
+		  || word.lemma.find_first_of( "\t\r\n" ) != string::npos ) ){
+	  return false;
+	}
+	if ( col == folia_column::POS
+	     && ( word.pos.empty()
+		  || word.pos.find_first_of( " \t\r\n" ) != string::npos ) ){
+	  return false;
+	}
+      }
+    }
+    return true;
+  }
+
+  const string& column_value( const folia_word& word, folia_column col ){
+    static const string outside = "O";
+    switch ( col ){
+    case folia_column::LEMMA:
+      return word.lemma;
+    case folia_column::POS:
+      return word.pos;
+    case folia_column::CHUNK:
+      return word.chunk.empty() ? outside : word.chunk;
+    case folia_column::ENTITY:
+      return word.entity.empty() ? outside : word.entity;
+    default:
+      return word.text;
+    }
+  }
+
+  bool extract_document( const string& filename,
+			 const vector<folia_column>& columns,
+			 const string& eos,
+			 string& out,
+			 const function<void( string& )>& flush,
+			 folia_stats& stats,
+			 string& error ){
+    // 'flush' is offered the output every batch of sentences
+    const size_t batch_size = 1000;
+    FoliaReader reader;
+    if ( !reader.open( filename, error ) ){
+      return false;
+    }
+    vector<folia_word> sentence;
+    while ( reader.next( sentence, error ) ){
+      ++stats.sentences;
+      if ( !usable( sentence, columns ) ){
+	++stats.skipped;
+	continue;
+      }
+      for ( const auto& word : sentence ){
+	for ( size_t c=0; c < columns.size(); ++c ){
+	  if ( c > 0 ){
+	    out += '\t';
+	  }
+	  out += column_value( word, columns[c] );
+	}
+	out += '\n';
+      }
+      out += eos;
+      out += '\n';
+      stats.words += sentence.size();
+      if ( stats.sentences % batch_size == 0 ){
+	flush( out );
+      }
+    }
+    stats.dangling += reader.dangling();
+    ++stats.documents;
+    return error.empty();
+  }
+
+  void folia_stats::report( ostream& os ) const {
+    os << "read " << documents << " FoLiA document(s): " << sentences
+       << " sentences";
+    if ( skipped > 0 ){
+      os << ", of which " << skipped << " skipped for missing annotations";
+    }
+    os << ", " << words << " words extracted" << endl;
+    if ( dangling > 0 ){
+      os << "ignored " << dangling << " chunk or entity references to "
+	 << "words outside their sentence" << endl;
+    }
+  }
+
+  bool folia_to_columns( const vector<string>& files,
+			 const vector<folia_column>& columns,
+			 const string& eos,
+			 ostream& os,
+			 folia_stats& stats,
+			 string& error ){
+    // every thread parses a document into its own buffer. The document
+    // whose turn it is writes its buffer every batch of sentences. The
+    // others keep theirs until their turn comes, in the ordered section
+    // or at a batch after that.
+    // libxml2 before 2.9 must be initialized before the threads use it
+    xmlInitParser();
+    mutex os_mutex;
+    size_t current = 0; // the document that may write
+#pragma omp parallel for schedule(dynamic,1) ordered
+    for ( size_t i=0; i < files.size(); ++i ){
+      string buffer;
+      folia_stats doc_stats;
+      string doc_error;
+      auto flush = [&]( string& out ){
+	lock_guard<mutex> lock( os_mutex );
+	if ( current == i ){
+	  os.write( out.data(), out.size() );
+	  out.clear();
+	}
+      };
+      bool ok = extract_document( files[i], columns, eos,
+				  buffer, flush, doc_stats, doc_error );
+#pragma omp ordered
+      {
+	lock_guard<mutex> lock( os_mutex );
+	current = i + 1;
+	if ( ok ){
+	  os.write( buffer.data(), buffer.size() );
+	  stats.documents += doc_stats.documents;
+	  stats.sentences += doc_stats.sentences;
+	  stats.words += doc_stats.words;
+	  stats.skipped += doc_stats.skipped;
+	  stats.dangling += doc_stats.dangling;
+	}
+	else if ( error.empty() ){
+	  error = doc_error;
+	}
+      }
+    }
+    if ( error.empty() && !os ){
+      error = "write error";
+    }
+    return error.empty();
+  }
+
+  bool folia_to_file( const string& name,
+		      const vector<folia_column>& columns,
+		      const string& eos,
+		      const string& outname,
+		      folia_stats& stats,
+		      string& error ){
+    vector<string> files = folia_files( name );
+    if ( files.empty() ){
+      error = "no FoLiA documents found in: " + name;
+      return false;
+    }
+    ofstream os( outname );
+    if ( !os ){
+      error = "unable to create: " + outname;
+      return false;
+    }
+    if ( !folia_to_columns( files, columns, eos, os, stats, error ) ){
+      return false;
+    }
+    os.close();
+    if ( !os ){
+      error = "write error on: " + outname;
+      return false;
+    }
+    return true;
+  }
+
+}
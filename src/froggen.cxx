@@ -31,34 +31,73 @@
 #include <map>
 #include <set>
 #include <string>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <memory>
 #include "ticcutils/StringOps.h"
 #include "ticcutils/PrettyPrint.h"
 #include "ticcutils/CommandLine.h"
 #include "ticcutils/FileUtils.h"
 #include "ticcutils/Configuration.h"
 #include "ticcutils/Unicode.h"
+#include "ticcutils/LogStream.h"
 #include "timbl/TimblAPI.h"
 #include "mbt/MbtAPI.h"
 #include "libfolia/folia.h"
 #include "ucto/tokenize.h"
 #include "unicode/ustream.h"
 #include "unicode/unistr.h"
+#include "toad/string_pool.h"
+#include "toad/edit_script.h"
+#include "toad/igtree_shards.h"
+#include "toad/tree_report.h"
+#include "toad/sentence_batch.h"
+#include "toad/compressed_input.h"
+#include "toad/temp_store.h"
+#include "toad/folia_reader.h"
 #include "config.h"
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace	icu;
 using namespace TiCC;
 using TiCC::operator<<;
+using Toad::string_id;
 
 int debug = 0;
 const int HISTORY = 20;
 bool lemma_file_only = false;
 string output_dir="";
 string temp_dir="/tmp/froggen";
+static Toad::TempStore temp_store; // the datafiles etc. in temp_dir
 string encoding="UTF-8";
+bool merge_classes = false;
+size_t class_threshold = 0;
+size_t mblem_shards = 0;
+size_t shard_jobs = 0; // 0: as many as OpenMP threads
 static Configuration use_config;
 static Configuration default_config;
 
+static Toad::StringPool lemma_pool; // ALL words, lemmas and POS tags live here
+
+struct pool_less {
+  // sort pooled strings as the UnicodeStrings they represent
+  bool operator()( string_id a, string_id b ) const {
+    return lemma_pool.compare( a, b ) < 0;
+  }
+};
+
+typedef map<string_id,size_t,pool_less> tag_freqs;       // tag -> frequency
+typedef map<string_id,tag_freqs,pool_less> lemma_tags;   // lemma -> tags
+typedef map<string_id,lemma_tags,pool_less> lemma_data;  // word -> lemmas
+
 void set_default_config(){
   // tagger defaults
   default_config.setatt( "settings", "Frog.mbt.1.0.settings", "tagger" );
@@ -126,8 +165,16 @@ void usage( const string& name ){
   cerr << "\t WARNING: This encoding is used for ALL datafiles!" << endl;
   cerr << "\t\t Be sure to use the same encoding for the Tagged Corpus and the lemma file." << endl;
   cerr << "\t\t The results will ALWAYS be stored in UTF-8 (NFC normalized)" << endl;
+  cerr << "--folia The corpus (-T) is a FoLiA document, or a directory of them."
+       << endl
+       << "\t The words, lemmas and POS tags are extracted from it." << endl;
   cerr << "-t 'tokenizerfile' An ucto style rulesfile can be specified here." << endl
-       << "\t It must include a full path!" << endl;
+       << "\t It must include a full path!" << endl
+       << "\t The lexicon is checked with it. Words that it splits are listed"
+       << endl
+       << "\t in <basename>.tokenizer.check (with only -l, the basename of"
+       << endl
+       << "\t the lemma file)" << endl;
   cerr << "--postags 'file'. Read POS tags labels, from 'file' and use those" <<endl;
   cerr << "\t to validate." << endl;
   cerr << "--CGN assume CGN tags as used in the Dutch Frog" << endl;
@@ -137,14 +184,116 @@ void usage( const string& name ){
        << "\t This list is again in the right format for training." << endl;
   cerr << "--temp-dir 'dirname' The directory to store teporary files. "
        << "(default: " << temp_dir << " )" << endl;
+  cerr << "--temp-memory 'MB' Keep temporary datafiles in memory, as long as"
+       << " together" << endl
+       << "\t they fit in MB. Larger ones are still written to the temp-dir."
+       << endl;
+  cerr << "--keep-temp Don't remove the temporary files when done." << endl;
+  cerr << "--merge-classes Merge lemmatizer classes that only differ in the"
+       << " order of" << endl
+       << "\t their tags, after the most frequent one." << endl;
+  cerr << "--prune-classes 'N' Lemmatizer classes with multiple lemmas for the"
+       << " same tag" << endl
+       << "\t that occur less than N times, keep only the most frequent lemma"
+       << " of" << endl
+       << "\t every tag." << endl
+       << "\t With --merge-classes and/or --prune-classes a report is given"
+       << " on" << endl
+       << "\t the effect on size and speed of the lemmatizer." << endl;
+  cerr << "--shards 'N' Train the lemmatizer IGTree in N parts, split on the"
+       << " last" << endl
+       << "\t letter(s) of the words, and merge those. This saves memory"
+       << " on" << endl
+       << "\t huge lemma lists." << endl;
+  cerr << "--shard-jobs 'N' Train N shards at the same time (default: the"
+       << " number of" << endl
+       << "\t OpenMP threads). Every one of those is in memory while"
+       << " training." << endl;
+  cerr << "--cv 'K' Cross validate the tagger and lemmatizer settings, instead"
+       << " of training." << endl
+       << "\t The corpus is split in K folds of whole sentences. For every"
+       << " fold a" << endl
+       << "\t tagger and a lemmatizer are trained on the other folds (all"
+       << " at the" << endl
+       << "\t same time) and tested on the fold. Reports the accuracy,"
+       << " training time," << endl
+       << "\t instancebase sizes and tagging speed per fold." << endl;
+  cerr << "--sweep 'file' Train a tagger or lemmatizer for every combination"
+       << " of the" << endl
+       << "\t settings in 'file', instead of training. 'file' has lines"
+       << " like:" << endl
+       << "\t    tagger M = 200 | 500 | 1000" << endl
+       << "\t    tagger timblOpts = +vS -G0 +D K: -a1 ... | +vS -G0 +D K: -a4 ..."
+       << endl
+       << "\t    mblem timblOpts = -a1 -w2 +vS | -a0 -k3 -w2 +vS" << endl
+       << "\t The tagger keys are p, P, M, n and timblOpts. Every key can"
+       << " only be on" << endl
+       << "\t one line. All models are trained on" << endl
+       << "\t the same datafiles, in parallel, and tested on the same"
+       << " held-out" << endl
+       << "\t sentences (1 in 10, or 1 in K with --cv K). The result is a"
+       << " table of" << endl
+       << "\t accuracy, speed and size, that marks the Pareto front." << endl;
+  cerr << "--sweep-memory 'MB' Only start a --sweep or --cv training when"
+       << " its estimated" << endl
+       << "\t memory fits in the MB that the running ones leave." << endl;
   cerr << "-h or --help These messages." << endl;
   cerr << "-v or --version Give version info." << endl;
 }
 
+void open_input( Toad::InputFile& is, const string& name ){
+  // the corpus and lemma files may be gzip, xz or zstd compressed
+  if ( !is.open( name ) ){
+    cerr << is.error() << endl;
+    exit( EXIT_FAILURE );
+  }
+}
+
+void check_input( const Toad::InputFile& is ){
+  // a corrupt or truncated compressed file ends the input early
+  if ( !is.error().empty() ){
+    cerr << is.error() << endl;
+    exit( EXIT_FAILURE );
+  }
+}
+
+size_t text_size( const string& name ){
+  // the expected size of the text in file 'name', for the estimates of
+  // the temporary files made from it. A compressed file may hold many
+  // times its own size, so that is unknown.
+  Toad::InputFile is;
+  if ( !is.open( name ) ){
+    return 0;
+  }
+  if ( is.compression() != Toad::Compression::NONE ){
+    return Toad::TempStore::unknown_size;
+  }
+  return Toad::file_size( name );
+}
+
+void temp_create( const string& path,
+		  size_t estimate = Toad::TempStore::unknown_size ){
+  // 'path' is a temporary file, possibly in memory, removed when done.
+  // 'estimate' is its expected size. Without one it is made on disk.
+  string error;
+  if ( !temp_store.create( path, error, estimate ) ){
+    cerr << error << endl;
+    exit( EXIT_FAILURE );
+  }
+}
+
+void temp_done( const string& path ){
+  // 'path' is written and closed. It may move to disk now
+  string error;
+  if ( !temp_store.done( path, error ) ){
+    cerr << error << endl;
+    exit( EXIT_FAILURE );
+  }
+}
+
 void fill_lemmas( istream& is,
-		  multimap<UnicodeString, map<UnicodeString, map<UnicodeString,size_t>>>& lems,
+		  lemma_data& lems,
 		  const set<UnicodeString>& pos_tags,
-
 		  const UnicodeString& eos_mark ){
   size_t line_count = 0;
   size_t eos_count = 0;
@@ -194,51 +343,71 @@ void fill_lemmas( istream& is,
 	}
       }
     }
-    UnicodeString uword = TiCC::utrim(parts[0]); // the word
-    UnicodeString ulemma = TiCC::utrim(parts[1]); // the lemma
-    UnicodeString utag = TiCC::utrim(parts[2]); // the POS tag
-    auto it = lems.lower_bound( uword );
-    if ( it == lems.upper_bound( uword ) ){
-      // so a completely new word
-      it = lems.insert( make_pair( uword, map<UnicodeString,map<UnicodeString,size_t>>() ) );
-      ++it->second[ulemma][utag];
-    }
-    else {
-      // word seen before. But with this lemma?
-      auto it2 = it->second.find( ulemma );
-      if ( it2 == it->second.end() ){
-	// so this lemma not yet done for this word
-	++it->second[ulemma][utag];
-      }
-      else {
-	++it2->second[utag];
-      }
-    }
+    string_id word = lemma_pool.intern( TiCC::utrim(parts[0]) );
+    string_id lemma = lemma_pool.intern( TiCC::utrim(parts[1]) );
+    string_id tag = lemma_pool.intern( TiCC::utrim(parts[2]) );
+    ++lems[word][lemma][tag];
   }
 }
 
 void write_lemmas( ostream& os,
-		   const multimap<UnicodeString, map<UnicodeString, map<UnicodeString,size_t>>>& lems ){
+		   const lemma_data& lems ){
   for ( const auto& it1 : lems ){
-    UnicodeString word = it1.first;
+    UnicodeString word = lemma_pool.get( it1.first );
     for ( const auto& it2 : it1.second ){
-      UnicodeString lemma = it2.first;
+      UnicodeString lemma = lemma_pool.get( it2.first );
       for( const auto& it3 : it2.second ){
-	UnicodeString pos = it3.first;
-	os << word << "\t" << lemma << "\t" << pos << endl;
+	os << word << "\t" << lemma << "\t" << lemma_pool.get( it3.first )
+	   << endl;
       }
     }
   }
 }
 
+void dump_lemmas( ostream& os,
+		  const lemma_data& lems ){
+  for ( const auto& it1 : lems ){
+    os << lemma_pool.get( it1.first );
+    for( const auto& it2 : it1.second ){
+      os << "\t" << lemma_pool.get( it2.first ) << endl;
+      for( const auto& it3 : it2.second ){
+	os << "\t\t\t" << lemma_pool.get( it3.first ) << " " << it3.second
+	   << endl;
+      }
+    }
+  }
+}
+
+string tagger_command( const Configuration& config,
+		       const string& tag_data_name,
+		       const string& settings_name ){
+  string p_pat = config.lookUp( "p", "tagger" );
+  string P_pat = config.lookUp( "P", "tagger" );
+  string timblopts = config.lookUp( "timblOpts", "tagger" );
+  string M_opt = config.lookUp( "M", "tagger" );
+  string n_opt = config.lookUp( "n", "tagger" );
+  string taggercommand = "-T " + tag_data_name
+    + " -s " + settings_name
+    + " -p " + p_pat + " -P " + P_pat
+    + " -O\""+ timblopts + "\""
+    + " -M " + M_opt
+    + " -n " + n_opt;
+  //  taggercommand += " -DLogSilent --tabbed"; // shut up AND tel MBT to only use tabs as separators. Needs recent mbt.
+  taggercommand += " -DLogSilent"; // shut up
+  return taggercommand;
+}
+
 void create_tagger( const Configuration& config,
 		    const string& base_name,
 		    const string& corpus_name,
 		    const set<UnicodeString>& pos_tags,
 		    const UnicodeString& eos_mark ){
   cout << "create a tagger from: " << corpus_name << endl;
-  ifstream corpus( corpus_name );
+  Toad::InputFile corpus;
+  open_input( corpus, corpus_name );
   string tag_data_name = temp_dir + base_name + ".data";
+  // at most the size of the corpus
+  temp_create( tag_data_name, text_size( corpus_name ) );
   ofstream os( tag_data_name );
   size_t line_count = 0;
   UnicodeString line;
@@ -275,20 +444,12 @@ void create_tagger( const Configuration& config,
       os << word << "\t" << pos << endl;
     }
   }
+  check_input( corpus );
+  os.close();
+  temp_done( tag_data_name );
   cout << "created an inputfile for the tagger: " << tag_data_name << endl;
-  string p_pat = config.lookUp( "p", "tagger" );
-  string P_pat = config.lookUp( "P", "tagger" );
-  string timblopts = config.lookUp( "timblOpts", "tagger" );
-  string M_opt = config.lookUp( "M", "tagger" );
-  string n_opt = config.lookUp( "n", "tagger" );
-  string taggercommand = "-T " + tag_data_name
-    + " -s " + output_dir + base_name + ".settings"
-    + " -p " + p_pat + " -P " + P_pat
-    + " -O\""+ timblopts + "\""
-    + " -M " + M_opt
-    + " -n " + n_opt;
-  //  taggercommand += " -DLogSilent --tabbed"; // shut up AND tel MBT to only use tabs as separators. Needs recent mbt.
-  taggercommand += " -DLogSilent"; // shut up
+  string taggercommand = tagger_command( config, tag_data_name,
+					 output_dir + base_name + ".settings" );
   cout << "start tagger: " << taggercommand << endl;
   cout << "this may take several minutes, depending on the corpus size."
        << endl;
@@ -348,180 +509,509 @@ set<UnicodeString> fill_postags( const string& pos_tags_file ){
   return result;
 }
 
-void create_mblem_trainfile( const multimap<UnicodeString, map<UnicodeString, map<UnicodeString, size_t>>>& data,
+UnicodeString mblem_instance( const UnicodeString& wordform ){
+  // the features for one word: the last HISTORY characters
+  UnicodeString instance;
+  for ( int i=0; i<HISTORY; i++) {
+    int j= wordform.length()-HISTORY+i;
+    if (j<0)
+      instance += "= ";
+    else {
+      UChar uc = wordform[j];
+      instance += uc;
+      instance += " ";
+    }
+  }
+  return instance;
+}
+
+static UnicodeString join_parts( const vector<pair<string_id,UnicodeString>>& parts ){
+  UnicodeString result;
+  for ( const auto& part : parts ){
+    if ( !result.isEmpty() ){
+      result += "|";
+    }
+    result += part.second;
+  }
+  return result;
+}
+
+UnicodeString mblem_classes( const UnicodeString& wordform,
+			     const lemma_tags& lemmas,
+			     const Toad::EditScripter& scripter,
+			     UnicodeString& canonical,
+			     UnicodeString& reduced ){
+  // create the class for one word: all tag+edit combinations, most
+  // frequent first.
+  // Frog uses the parts with a matching tag, in this order, and falls back
+  // on the first part when no tag matches. So only the first part and the
+  // order within the same tag matter.
+  // 'canonical' gets the same combinations, with all but the first part
+  // stable sorted on tag: all classes with the same canonical form are
+  // equivalent.
+  // 'reduced' only keeps the most frequent part of every tag, in canonical
+  // form when merging.
+  // frequency -> (tag,lemma)
+  multimap<size_t,pair<string_id,string_id>,std::greater<size_t>> sorted;
+  for ( const auto& it2 : lemmas ){
+    for ( const auto& it3: it2.second ){
+      sorted.insert( make_pair( it3.second,
+				make_pair( it3.first, it2.first ) ) );
+    }
+  }
+  if ( debug ){
+    cerr << "sorted: " << endl;
+    for ( const auto& it : sorted ){
+      cerr << lemma_pool.get( it.second.first ) << " "
+	   << lemma_pool.get( it.second.second )
+	   << " (" << it.first << " )" << endl;
+    }
+  }
+  UnicodeString result;
+  vector<pair<string_id,UnicodeString>> parts;
+  for ( const auto& it2 : sorted ){
+    UnicodeString tag = lemma_pool.get( it2.second.first );
+    UnicodeString lemma = lemma_pool.get( it2.second.second );
+    if ( debug ){
+      cerr << "LEMMA = " << lemma << endl;
+      cerr << "tag = " << tag << endl;
+    }
+    Toad::edit_script edit = scripter.derive( wordform, lemma, tag );
+    if ( debug ){
+      cerr << " word " << wordform << ", lemma " << lemma
+	   << ", prefix " << edit.prefixed
+	   << ", insert " << edit.inserted
+	   << ", delete " << edit.deleted << endl;
+    }
+    if ( !result.isEmpty() ){
+      result += "|";
+    }
+    UnicodeString part = tag + edit.label();
+    result += part;
+    parts.push_back( make_pair( it2.second.first, part ) );
+  }
+  if ( merge_classes ){
+    if ( parts.size() > 2 ){
+      stable_sort( parts.begin()+1, parts.end(),
+		   []( const pair<string_id,UnicodeString>& p1,
+		       const pair<string_id,UnicodeString>& p2 ){
+		     return lemma_pool.compare( p1.first, p2.first ) < 0;
+		   } );
+    }
+    canonical = join_parts( parts );
+  }
+  if ( class_threshold > 0 ){
+    vector<pair<string_id,UnicodeString>> per_tag;
+    set<string_id> seen;
+    for ( const auto& part : parts ){
+      if ( seen.insert( part.first ).second ){
+	per_tag.push_back( part );
+      }
+    }
+    reduced = join_parts( per_tag );
+  }
+  return result;
+}
+
+struct class_inventory {
+  // the effect of merging and pruning the mblem classes
+  size_t instances = 0;
+  size_t raw_classes = 0;
+  size_t merged_classes = 0;
+  size_t final_classes = 0;
+  size_t pruned_instances = 0;
+};
+
+size_t count_distinct( const vector<string_id>& ids, size_t pool_size ){
+  vector<bool> seen( pool_size, false );
+  size_t result = 0;
+  for ( const auto& id : ids ){
+    if ( !seen[id] ){
+      seen[id] = true;
+      ++result;
+    }
+  }
+  return result;
+}
+
+size_t mblem_file_estimate( const vector<lemma_data::const_iterator>& words,
+			    const Toad::EditScripter& scripter ){
+  // the expected size of an mblem datafile with the unmodified classes
+  // of 'words', from the lines of an evenly spread sample of them
+  if ( words.empty() ){
+    return 0;
+  }
+  size_t sample = min( words.size(), size_t(1000) );
+  size_t bytes = 0;
+  UnicodeString canonical;
+  UnicodeString reduced;
+  for ( size_t i=0; i < sample; ++i ){
+    const auto& word = words[i * words.size() / sample];
+    UnicodeString wordform = lemma_pool.get( word->first );
+    UnicodeString line = mblem_instance( wordform )
+      + mblem_classes( wordform, word->second, scripter, canonical, reduced );
+    bytes += TiCC::UnicodeToUTF8( line ).size() + 1;
+  }
+  // with a margin for a sample that is a bit off
+  return words.size() * ( bytes / sample + 1 ) / 10 * 11;
+}
+
+void create_mblem_trainfile( const lemma_data& data,
 			     const map<UnicodeString,set<UnicodeString>>& particles,
-			     const string& _filename ){
+			     const string& _filename,
+			     const string& full_filename = "" ){
+  // when merging or pruning classes, we can also create 'full_filename'
+  // with the original, unmodified, classes.
   string filename = temp_dir + _filename;
+  bool compact = merge_classes || class_threshold > 0;
+  Toad::EditScripter scripter( particles );
+  vector<lemma_data::const_iterator> words;
+  words.reserve( data.size() );
+  set<string_id> tags;
+  for ( auto it = data.begin(); it != data.end(); ++it ){
+    words.push_back( it );
+    for ( const auto& it2 : it->second ){
+      for ( const auto& it3 : it2.second ){
+	tags.insert( it3.first );
+      }
+    }
+  }
+  for ( const auto& tag : tags ){
+    // precompile the particle candidates for every tag, BEFORE we go
+    // parallel
+    scripter.add_tag( lemma_pool.get( tag ) );
+  }
+  size_t estimate = mblem_file_estimate( words, scripter );
+  temp_create( filename, estimate );
   ofstream os( filename );
   if ( !os ){
     cerr << "couldn't create mblem datafile: " << filename << endl;
     exit( EXIT_FAILURE );
   }
-  UnicodeString outLine;
-  for ( const auto& data_it : data ){
-    UnicodeString wordform = data_it.first;
-    UnicodeString safeInstance;
-    if ( !outLine.isEmpty() ){
-      string out = UnicodeToUTF8(outLine);
-      out.erase( out.length()-1 ); // remove the final '|'
-      os << out << endl;
-      outLine.remove();
-    }
-    UnicodeString instance;
-    // format instance
-    for ( int i=0; i<HISTORY; i++) {
-      int j= wordform.length()-HISTORY+i;
-      if (j<0)
-	instance += "= ";
+  // when compacting, all classes are gathered in class_pool first
+  Toad::StringPool class_pool;
+  vector<string_id> raw_class;
+  vector<string_id> word_class;
+  vector<string_id> reduced_class; // only the most frequent part per tag
+  if ( compact ){
+    raw_class.reserve( words.size() );
+    word_class.reserve( words.size() );
+    reduced_class.reserve( words.size() );
+  }
+  // handle the words in blocks, so we don't need to keep ALL lines in
+  // memory. The output order is the same as the order of the words.
+  const size_t block_size = 100000;
+  vector<UnicodeString> classes;
+  vector<UnicodeString> canonical;
+  vector<UnicodeString> reduced;
+  for ( size_t start=0; start < words.size(); start += block_size ){
+    size_t end = min( start + block_size, words.size() );
+    classes.resize( end - start );
+    canonical.resize( end - start );
+    reduced.resize( end - start );
+#pragma omp parallel for schedule(dynamic,256) if(!debug)
+    for ( size_t w=start; w < end; ++w ){
+      UnicodeString wordform = lemma_pool.get( words[w]->first );
+      classes[w-start] = mblem_classes( wordform, words[w]->second,
+					scripter, canonical[w-start],
+					reduced[w-start] );
+    }
+    for ( size_t w=start; w < end; ++w ){
+      const UnicodeString& cls = classes[w-start];
+      if ( compact ){
+	string_id raw = class_pool.intern( cls );
+	raw_class.push_back( raw );
+	if ( merge_classes ){
+	  word_class.push_back( class_pool.intern( canonical[w-start] ) );
+	}
+	else {
+	  word_class.push_back( raw );
+	}
+	if ( class_threshold > 0 ){
+	  reduced_class.push_back( class_pool.intern( reduced[w-start] ) );
+	}
+      }
       else {
-	UChar uc = wordform[j];
-	instance += uc;
-	instance += " ";
+	UnicodeString wordform = lemma_pool.get( words[w]->first );
+	os << mblem_instance( wordform ) << cls << "\n";
       }
     }
-    if ( safeInstance.isEmpty() ){
-      // first time around
-      if ( debug ){
-	cerr << "NEW instance " << instance << endl;
+  }
+  if ( compact ){
+    class_inventory inv;
+    inv.instances = words.size();
+    inv.raw_classes = count_distinct( raw_class, class_pool.size() );
+    inv.merged_classes = count_distinct( word_class, class_pool.size() );
+    if ( class_threshold > 0 ){
+      // rare (combined) classes only keep the most frequent part of every
+      // tag. So an ambiguous word keeps a lemma for each of its tags.
+      vector<size_t> freqs( class_pool.size(), 0 );
+      for ( const auto& id : word_class ){
+	++freqs[id];
       }
-      safeInstance = instance;
-      outLine = instance;
-    }
-    else if ( instance != safeInstance ){
-      // instance changed. Spit out what we have...
-      if ( debug ){
-	cerr << "instance changed from: " << safeInstance << endl
-	     << "to " << instance << endl;
+      for ( size_t w=0; w < word_class.size(); ++w ){
+	if ( freqs[word_class[w]] < class_threshold
+	     && reduced_class[w] != word_class[w] ){
+	  word_class[w] = reduced_class[w];
+	  ++inv.pruned_instances;
+	}
       }
-      string out = UnicodeToUTF8(outLine);
-      out.erase( out.length()-1 );
-      os << out << endl;
-      safeInstance = instance;
-      outLine = instance;
     }
-    multimap<size_t, multimap<UnicodeString,UnicodeString>,std::greater<size_t>> sorted;
-    for ( const auto& it2 : data_it.second ){
-      for ( const auto& it3: it2.second ){
-	multimap<UnicodeString,UnicodeString> mm;
-	mm.insert(make_pair(it3.first,it2.first));
-	sorted.insert(make_pair(it3.second,mm));
+    inv.final_classes = count_distinct( word_class, class_pool.size() );
+    ofstream full_os;
+    if ( !full_filename.empty() ){
+      temp_create( temp_dir + full_filename, estimate );
+      full_os.open( temp_dir + full_filename );
+      if ( !full_os ){
+	cerr << "couldn't create mblem datafile: "
+	     << temp_dir + full_filename << endl;
+	exit( EXIT_FAILURE );
       }
     }
-    if ( debug ){
-      cerr << "sorted: " << endl;
-      for ( const auto& it : sorted ){
-	cerr << it.second << " (" << it.first << " )" << endl;
+    for ( size_t w=0; w < words.size(); ++w ){
+      UnicodeString instance = mblem_instance( lemma_pool.get( words[w]->first ) );
+      os << instance << class_pool.get( word_class[w] ) << "\n";
+      if ( full_os.is_open() ){
+	full_os << instance << class_pool.get( raw_class[w] ) << "\n";
       }
     }
-    for ( const auto& it2 : sorted ){
-      for( const auto& it3 : it2.second ){
-	UnicodeString tag = it3.first;
-	UnicodeString lemma  = it3.second;
-	if ( debug ){
-	  cerr << "LEMMA = " << lemma << endl;
-	  cerr << "tag = " << tag << endl;
-	}
-	outLine += tag;
-	UnicodeString prefixed;
-	UnicodeString thisform = wordform;
-	//  find out whether there may be a prefix or infix particle
-	for( const auto& it : particles ){
-	  if ( !prefixed.isEmpty() ){
-	    break;
-	  }
-	  thisform = wordform;
-	  if ( tag.indexOf(it.first) >= 0 ){
-	    // the POS tag matches, so potentially yes
-	    for ( const auto& part : it.second ){
-	      // loop over potential particles.
-	      int part_pos = thisform.indexOf(part);
-	      if ( part_pos != -1 ){
-		if ( debug ){
-		  cerr << "alert - " << thisform << " " << lemma << endl;
-		  cerr << "matched " << part << " position: " << part_pos << endl;
-		}
-		UnicodeString edit = thisform;
-		//
-		// A bit tricky here
-		// We remove the first particle
-		// the last would be better (e.g 'tegemoetgekomen' )
-		// but then frogs mblem module needs modification too
-		// need more thinking. Are there counterexamples?
-		if ( (size_t)part_pos != string::npos
-		     && part_pos < thisform.length()-5 ){
-		  prefixed = part;
-		  edit = edit.remove( part_pos, prefixed.length() );
-		  if ( debug ){
-		    cerr << " simplified from " << thisform
-			 << " to " << edit << " vergelijk: " << lemma << endl;
-		  }
-		  int ident=0;
-		  while ( ( ident < edit.length() ) &&
-			  ( ident < lemma.length() ) &&
-			  ( edit[ident]==lemma[ident] ) ){
-		    ident++;
-		  }
-		  if (ident<5) {
-		    // so we want at least 5 characters in common between lemma and our
-		    // edit. Otherwise discard.
-		    if ( debug )
-		      cerr << " must be a fake!" << endl;
-		    prefixed = "";
-		  }
-		  else {
-		    thisform = edit;
-		    if ( debug ){
-		      cerr << " edited wordform " << thisform << endl;
-		    }
-		  }
-		}
-	      }
-	      if ( !prefixed.isEmpty() )
-		break;
-	    }
-	  }
-	}
+    cout << "mblem class inventory:" << endl
+	 << "\tinstances:              " << inv.instances << endl
+	 << "\tclasses:                " << inv.raw_classes << endl;
+    if ( merge_classes ){
+      cout << "\tafter merging:          " << inv.merged_classes << endl;
+    }
+    if ( class_threshold > 0 ){
+      cout << "\tafter pruning (<" << class_threshold << "):   "
+	   << inv.final_classes << endl
+	   << "\tpruned instances:       " << inv.pruned_instances << endl;
+    }
+    if ( full_os.is_open() ){
+      full_os.close();
+      temp_done( temp_dir + full_filename );
+    }
+  }
+  os.close();
+  temp_done( filename );
+  cout << "created a temprorary mblem trainingsfile: " << filename << endl;
+}
 
-	UnicodeString deleted;
-	UnicodeString inserted;
-	int ident=0;
-	while ( ident < thisform.length() &&
-		ident < lemma.length() &&
-		thisform[ident]==lemma[ident] )
-	  ident++;
-	if ( ident < thisform.length() ) {
-	  for ( int i=ident; i< thisform.length(); i++) {
-	    deleted += thisform[i];
-	  }
-	}
-	if ( ident< lemma.length() ) {
-	  for ( int i=ident; i< lemma.length(); i++) {
-	    inserted += lemma[i];
-	  }
-	}
-	if ( debug ){
-	  cerr << " word " << thisform << ", lemma " << lemma
-	       << ", prefix " << prefixed
-	       << ", insert " << inserted
-	       << ", delete " << deleted << endl;
+double classify_speed( const string& timblopts,
+		       const string& treefile,
+		       const vector<string>& sample ){
+  // load 'treefile' and return the number of classifications per second
+  // over 'sample'
+  Timbl::TimblAPI timbl( timblopts );
+  if ( !timbl.GetInstanceBase( treefile ) ){
+    return 0.0;
+  }
+  auto start = chrono::steady_clock::now();
+  for ( const auto& line : sample ){
+    timbl.Classify( line );
+  }
+  chrono::duration<double> secs = chrono::steady_clock::now() - start;
+  if ( secs.count() <= 0.0 ){
+    return 0.0;
+  }
+  return sample.size() / secs.count();
+}
+
+int weighting_of( const string& timblopts ){
+  // the Timbl weighting from the options: 1=GR (the default), 2=IG, ...
+  int result = 1;
+  vector<string> parts = TiCC::split( timblopts );
+  for ( size_t i=0; i < parts.size(); ++i ){
+    string val;
+    if ( parts[i] == "-w" && i+1 < parts.size() ){
+      val = parts[i+1];
+    }
+    else if ( parts[i].substr( 0, 2 ) == "-w" ){
+      val = parts[i].substr( 2 );
+    }
+    else {
+      continue;
+    }
+    if ( !TiCC::stringTo( val, result ) ){
+      result = -1;
+    }
+  }
+  return result;
+}
+
+bool is_igtree( const string& timblopts ){
+  vector<string> parts = TiCC::split( timblopts );
+  for ( size_t i=0; i < parts.size(); ++i ){
+    string val;
+    if ( parts[i] == "-a" && i+1 < parts.size() ){
+      val = parts[i+1];
+    }
+    else if ( parts[i].substr( 0, 2 ) == "-a" ){
+      val = parts[i].substr( 2 );
+    }
+    else {
+      continue;
+    }
+    return val == "1" || val == "IGTREE";
+  }
+  return false;
+}
+
+bool verify_merged_tree( const string& timblopts,
+			 const vector<string>& shard_data,
+			 const vector<string>& shard_trees,
+			 const vector<set<string>>& plan,
+			 const string& merged_tree ){
+  // the merged tree should classify a sample of every shard in exactly
+  // the same way as the shard's own tree. Loading the merged tree would
+  // take all the memory that sharding saves, so every shard is compared
+  // with a copy of its own branches of the merged tree.
+  for ( size_t i=0; i < shard_trees.size(); ++i ){
+    vector<string> sample = Toad::sample_lines( shard_data[i], 1000 );
+    vector<string> expected;
+    {
+      Timbl::TimblAPI timbl( timblopts );
+      if ( !timbl.GetInstanceBase( shard_trees[i] ) ){
+	return false;
+      }
+      for ( const auto& line : sample ){
+	string cls;
+	if ( !timbl.Classify( line, cls ) ){
+	  return false;
 	}
-	if ( !prefixed.isEmpty() )
-	  outLine += "+P" + prefixed;
-	if ( !deleted.isEmpty() )
-	  outLine += "+D" + deleted;
-	if ( !inserted.isEmpty() )
-	  outLine += "+I" + inserted;
-	outLine += "|";
+	expected.push_back( cls );
+      }
+    }
+    string part = shard_trees[i] + ".merged";
+    temp_store.add( part );
+    string error;
+    if ( !Toad::extract_shard( merged_tree, plan[i], part, error ) ){
+      cerr << error << endl;
+      return false;
+    }
+    Timbl::TimblAPI timbl( timblopts );
+    if ( !timbl.GetInstanceBase( part ) ){
+      return false;
+    }
+    for ( size_t j=0; j < sample.size(); ++j ){
+      string cls;
+      if ( !timbl.Classify( sample[j], cls )
+	   || cls != expected[j] ){
+	return false;
       }
     }
+    temp_store.remove( part );
+  }
+  return true;
+}
+
+void report_peak( const string& phase, long base, bool resets ){
+  // the measured memory use of a phase of the sharded training.
+  // 'resets' tells that the peak can be reset, so it is the peak of this
+  // phase only.
+  long peak = Toad::peak_resident_size();
+  if ( peak < 0 ){
+    return;
   }
-  if ( !outLine.isEmpty() ){
-    string out = UnicodeToUTF8(outLine);
-    out.erase( out.length()-1 );
-    os << out << endl;
-    outLine.remove();
+  const long MB = 1024 * 1024;
+  cout << "Timbl: peak resident size " << phase << ": " << peak / MB << " MB";
+  if ( base >= 0 ){
+    cout << " (+" << ( peak - base ) / MB << " MB)";
+  }
+  if ( !resets ){
+    cout << " (peak since the start of froggen)";
+  }
+  cout << endl;
+  if ( resets ){
+    Toad::reset_peak_resident_size();
   }
-  cout << "created a temprorary mblem trainingsfile: " << filename << endl;
+}
+
+bool train_sharded_mblem( const string& timblopts,
+			  const string& inputfile,
+			  const string& outfile ){
+  // train an IGTree per shard, and merge them. Only 'shard_jobs' shards
+  // are in memory at any time.
+  // returns false when this fails, and normal training is needed
+  if ( !is_igtree( timblopts ) ){
+    cerr << "sharded training is only possible for IGTREE (-a1)" << endl;
+    return false;
+  }
+  int weighting = weighting_of( timblopts );
+  if ( weighting != 1 && weighting != 2 ){
+    cerr << "sharded training needs GR or IG weighting (-w1 or -w2)" << endl;
+    return false;
+  }
+  bool resets = Toad::reset_peak_resident_size();
+  long base = Toad::resident_size();
+  cout << "Timbl: gathering statistics from: " << inputfile << endl;
+  Toad::data_stats stats;
+  if ( !Toad::gather_stats( inputfile, weighting == 2, stats ) ){
+    cerr << "unable to gather statistics from " << inputfile << endl;
+    return false;
+  }
+  string weights_file = inputfile + ".wgt";
+  temp_store.add( weights_file );
+  if ( !Toad::write_weights( weights_file, stats ) ){
+    cerr << "unable to write " << weights_file << endl;
+    return false;
+  }
+  vector<set<string>> plan = Toad::plan_shards( stats, mblem_shards );
+  vector<string> shard_data = Toad::split_instances( inputfile,
+						     stats.top_feature(),
+						     plan,
+						     inputfile );
+  if ( shard_data.empty() ){
+    cerr << "unable to split " << inputfile << " in shards" << endl;
+    return false;
+  }
+  string shard_opts = timblopts + " -w " + weights_file;
+  vector<string> shard_trees;
+  for ( const auto& name : shard_data ){
+    shard_trees.push_back( name + ".tree" );
+    temp_store.add( name );
+    temp_store.add( name + ".tree" );
+  }
+  // only the weights and class frequencies are needed from here on
+  stats.value_freqs.clear();
+  report_peak( "splitting", base, resets );
+  cout << "Timbl: training " << shard_data.size() << " shards, split on "
+       << "feature " << stats.top_feature()+1 << ", "
+       << shard_jobs << " at a time" << endl;
+  vector<int> ok( shard_data.size(), 0 );
+#pragma omp parallel for schedule(dynamic,1) num_threads(int(shard_jobs))
+  for ( size_t i=0; i < shard_data.size(); ++i ){
+    Timbl::TimblAPI timbl( shard_opts );
+    ok[i] = timbl.Learn( shard_data[i] )
+      && timbl.WriteInstanceBase( shard_trees[i] );
+  }
+  if ( find( ok.begin(), ok.end(), 0 ) != ok.end() ){
+    cerr << "training of a shard failed" << endl;
+    return false;
+  }
+  size_t largest = 0;
+  for ( const auto& tree : shard_trees ){
+    largest = max( largest, Toad::file_size( tree ) );
+  }
+  report_peak( "training the shards", base, resets );
+  cout << "Timbl: the largest shard instancebase is " << largest
+       << " bytes" << endl;
+  string error;
+  if ( !Toad::merge_igtrees( shard_trees, plan, stats, outfile, error ) ){
+    cerr << "merging the shards failed: " << error << endl;
+    return false;
+  }
+  report_peak( "merging", base, resets );
+  if ( !verify_merged_tree( shard_opts, shard_data, shard_trees, plan,
+			    outfile ) ){
+    cerr << "the merged tree doesn't match the shards" << endl;
+    return false;
+  }
+  report_peak( "verifying", base, resets );
+  for ( size_t i=0; i < shard_data.size(); ++i ){
+    temp_store.remove( shard_data[i] );
+    temp_store.remove( shard_trees[i] );
+  }
+  return true;
 }
 
 void train_mblem( const Configuration& config,
@@ -531,14 +1021,52 @@ void train_mblem( const Configuration& config,
   string inputfile = temp_dir + datafile;
   cout << "Timbl: Start training Lemmas from: " << inputfile
        << " with Options: '" << timblopts << "'" << endl;
-  Timbl::TimblAPI timbl( timblopts );
-  timbl.Learn( inputfile );
-  timbl.WriteInstanceBase( outfile );
+  if ( mblem_shards > 1 ){
+    if ( train_sharded_mblem( timblopts, inputfile, outfile ) ){
+      cout << "Timbl: Done, stored Lemma instancebase : " << outfile << endl;
+      // without loading the merged tree, that is what sharding avoids
+      Toad::report_tree( timblopts, outfile, inputfile, false );
+      return;
+    }
+    cerr << "falling back to normal training" << endl;
+  }
+  {
+    Timbl::TimblAPI timbl( timblopts );
+    timbl.Learn( inputfile );
+    timbl.WriteInstanceBase( outfile );
+  }
   cout << "Timbl: Done, stored Lemma instancebase : " << outfile << endl;
+  Toad::report_tree( timblopts, outfile, inputfile );
+}
+
+void report_compaction( const Configuration& config,
+			const string& full_datafile,
+			const string& outfile ){
+  // compare the compacted instancebase 'outfile' with one trained on the
+  // full classes in 'full_datafile'
+  string timblopts = config.lookUp( "timblOpts", "mblem" );
+  string full_tree = temp_dir + full_datafile + ".tree";
+  temp_store.add( full_tree );
+  cout << "Timbl: training the uncompacted lemmatizer, for comparison" << endl;
+  {
+    Timbl::TimblAPI timbl( timblopts );
+    timbl.Learn( temp_dir + full_datafile );
+    timbl.WriteInstanceBase( full_tree );
+  }
+  vector<string> sample = Toad::sample_lines( temp_dir + full_datafile,
+						10000 );
+  double full_speed = classify_speed( timblopts, full_tree, sample );
+  double compact_speed = classify_speed( timblopts, outfile, sample );
+  cout << "class compaction effect (on " << sample.size()
+       << " sample instances):" << endl
+       << "\tinstancebase size: " << Toad::file_size( full_tree ) << " --> "
+       << Toad::file_size( outfile ) << " bytes" << endl
+       << "\tclassifications/sec: " << size_t(full_speed) << " --> "
+       << size_t(compact_speed) << endl;
 }
 
 void create_lemmatizer( const Configuration& config,
-			const multimap<UnicodeString,map<UnicodeString,map<UnicodeString,size_t>>>& data,
+			const lemma_data& data,
 			const map<UnicodeString,set<UnicodeString>>& particles,
 			const string& mblem_tree_file ){
   if ( data.empty() ){
@@ -549,28 +1077,1001 @@ void create_lemmatizer( const Configuration& config,
   string mblem_data_file = mblem_base + ".data";
   string output_file = output_dir + mblem_base;
   cout << "create a lemmatizer into: " << output_file << endl;
-  create_mblem_trainfile( data, particles, mblem_data_file );
-  train_mblem( config, mblem_data_file, output_file );
+  if ( merge_classes || class_threshold > 0 ){
+    string full_data_file = mblem_base + ".full.data";
+    create_mblem_trainfile( data, particles, mblem_data_file, full_data_file );
+    train_mblem( config, mblem_data_file, output_file );
+    report_compaction( config, full_data_file, output_file );
+  }
+  else {
+    create_mblem_trainfile( data, particles, mblem_data_file );
+    train_mblem( config, mblem_data_file, output_file );
+  }
 }
 
-void check_data( Tokenizer::TokenizerClass *tokenizer,
-		 const multimap<UnicodeString,map<UnicodeString,map<UnicodeString,size_t>>>& data ){
+class tokenizer_pool {
+  // the tokenizers of check_data. A new one is only made when a thread
+  // finds none free, so there are never more than there are threads.
+public:
+  explicit tokenizer_pool( const string& rules ): _rules( rules ) {};
+  ~tokenizer_pool(){
+    for ( const auto& tok : _all ){
+      delete tok;
+    }
+  };
+  Tokenizer::TokenizerClass *acquire(){
+    {
+      lock_guard<mutex> lock( _mutex );
+      if ( !_free.empty() ){
+	Tokenizer::TokenizerClass *tok = _free.back();
+	_free.pop_back();
+	return tok;
+      }
+    }
+    // reading the rules takes a while, don't block the others
+    Tokenizer::TokenizerClass *tok = new Tokenizer::TokenizerClass();
+    tok->init( _rules );
+    lock_guard<mutex> lock( _mutex );
+    _all.push_back( tok );
+    return tok;
+  };
+  void release( Tokenizer::TokenizerClass *tok ){
+    lock_guard<mutex> lock( _mutex );
+    _free.push_back( tok );
+  };
+  size_t size() const { return _all.size(); };
+private:
+  string _rules;
+  mutex _mutex;
+  vector<Tokenizer::TokenizerClass*> _all;
+  vector<Tokenizer::TokenizerClass*> _free;
+};
+
+struct token_problem {
+  // a word of the lexicon that the tokenizer doesn't keep whole
+  UnicodeString word;
+  vector<UnicodeString> parts;
+};
+
+struct tokenizer_check {
+  size_t words = 0;
+  size_t tokenizers = 0;
+  double seconds = 0.0;
+  vector<token_problem> problems; // in the order of the lexicon
+};
+
+void check_data( const string& rules,
+		 const lemma_data& data,
+		 tokenizer_check& result ){
+  // tokenize every word of the lexicon on its own. Frog never sees a word
+  // that doesn't come out as 1 token, so its lemma is of no use.
+  // Only reads the lemma_pool, so it can run while training.
+  auto start = chrono::steady_clock::now();
+  vector<string_id> words;
+  words.reserve( data.size() );
   for ( const auto& word : data ){
-    tokenizer->tokenizeLine( word.first );
-    vector<Tokenizer::Token> v = tokenizer->popSentence();
-    if ( v.size() != 1 ){
-      cerr << "the provided tokenizer doesn't handle '" << word.first
-	   << "' well (splits it into " << v.size() << " parts.)" << endl;
-      cerr << "[";
-      for ( const auto& w : v ){
-	cerr << w.us << " ";
+    words.push_back( word.first );
+  }
+  const size_t batch_size = 1000;
+  size_t num_batches = ( words.size() + batch_size - 1 ) / batch_size;
+  vector<vector<token_problem>> found( num_batches );
+  tokenizer_pool pool( rules );
+#pragma omp parallel for schedule(dynamic,1)
+  for ( size_t b=0; b < num_batches; ++b ){
+    Tokenizer::TokenizerClass *tokenizer = pool.acquire();
+    size_t end = min( (b+1) * batch_size, words.size() );
+    for ( size_t w=b*batch_size; w < end; ++w ){
+      UnicodeString wordform = lemma_pool.get( words[w] );
+      tokenizer->tokenizeLine( wordform );
+      vector<Tokenizer::Token> v = tokenizer->popSentence();
+      if ( v.size() != 1 ){
+	token_problem problem;
+	problem.word = wordform;
+	for ( const auto& tok : v ){
+	  problem.parts.push_back( tok.us );
+	}
+	found[b].push_back( problem );
       }
-      cerr << "]" << endl;
+      tokenizer->reset();
+    }
+    pool.release( tokenizer );
+  }
+  for ( auto& batch : found ){
+    for ( auto& problem : batch ){
+      result.problems.push_back( std::move( problem ) );
+    }
+  }
+  result.words = words.size();
+  result.tokenizers = pool.size();
+  result.seconds
+    = chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+}
+
+void report_check( const tokenizer_check& check, const string& filename ){
+  // a summary on cout, and ALL problems in 'filename', as TAB separated
+  // lines: word, number of tokens and the tokens
+  cout << "tokenizer check: " << check.words << " words in "
+       << check.seconds << " seconds, using " << check.tokenizers
+       << " tokenizer(s)" << endl;
+  if ( check.problems.empty() ){
+    cout << "the tokenizer keeps every word whole" << endl;
+    return;
+  }
+  const size_t shown = 10;
+  cout << "the tokenizer splits " << check.problems.size() << " words";
+  if ( check.problems.size() > shown ){
+    cout << ", the first " << shown;
+  }
+  cout << ":" << endl;
+  for ( size_t i=0; i < check.problems.size() && i < shown; ++i ){
+    cout << "\t" << check.problems[i].word << " -->";
+    for ( const auto& part : check.problems[i].parts ){
+      cout << " [" << part << "]";
+    }
+    cout << endl;
+  }
+  ofstream os( filename );
+  os << "# word\ttokens\tparts" << endl;
+  for ( const auto& problem : check.problems ){
+    os << problem.word << "\t" << problem.parts.size() << "\t";
+    for ( size_t i=0; i < problem.parts.size(); ++i ){
+      os << ( i > 0 ? " " : "" ) << problem.parts[i];
+    }
+    os << endl;
+  }
+  if ( os ){
+    cout << "stored the tokenizer problems in: " << filename << endl;
+  }
+  else {
+    cerr << "unable to write: " << filename << endl;
+  }
+}
+
+struct cv_fold {
+  // one fold of a cross validation. Trained on all sentences except its
+  // own, tested on its own.
+  string train_corpus;
+  string settings;
+  string mblem_data;
+  string mblem_tree;
+  string test_file;   // its own sentences, see read_test()
+  // only filled while testing
+  vector<Toad::labeled_sentence> test;  // words with their gold POS tags
+  vector<vector<UnicodeString>> test_lemmas; // gold lemmas (may be empty)
+  bool tagger_ok = false;
+  bool mblem_ok = false;
+  double tagger_seconds = 0.0;
+  double mblem_seconds = 0.0;
+  size_t tagger_bytes = 0;
+  size_t mblem_bytes = 0;
+  size_t tokens = 0;
+  size_t tags_correct = 0;
+  size_t lemmas = 0;
+  size_t lemmas_correct = 0;
+  double tokens_per_sec = 0.0;
+};
+
+string extract_folia( const string& name,
+		      const string& base_name,
+		      const UnicodeString& eos_mark ){
+  // write the words, lemmas and POS tags of the FoLiA document(s) in
+  // 'name' to a temporary corpus file, and return its name
+  string corpus_name = temp_dir + base_name + ".folia.data";
+  cout << "extracting a corpus from FoLiA: " << name << endl;
+  // the columns are always smaller than the XML they come from
+  size_t xml_size = 0;
+  for ( const auto& file : Toad::folia_files( name ) ){
+    size_t size = text_size( file );
+    if ( size == Toad::TempStore::unknown_size ){
+      xml_size = size;
+      break;
+    }
+    xml_size += size;
+  }
+  temp_create( corpus_name, xml_size );
+  string eos_line = ( eos_mark == "EL" ) ? "" : TiCC::UnicodeToUTF8( eos_mark );
+  Toad::folia_stats stats;
+  string error;
+  if ( !Toad::folia_to_file( name,
+			     { Toad::folia_column::WORD,
+			       Toad::folia_column::LEMMA,
+			       Toad::folia_column::POS },
+			     eos_line, corpus_name, stats, error ) ){
+    cerr << error << endl;
+    exit( EXIT_FAILURE );
+  }
+  temp_done( corpus_name );
+  stats.report( cout );
+  return corpus_name;
+}
+
+void add_lemmas( const vector<vector<UnicodeString>>& sentence,
+		 lemma_data& lemmas ){
+  for ( const auto& parts : sentence ){
+    if ( parts.size() == 3 ){
+      string_id word = lemma_pool.intern( TiCC::utrim(parts[0]) );
+      string_id lemma = lemma_pool.intern( TiCC::utrim(parts[1]) );
+      string_id tag = lemma_pool.intern( TiCC::utrim(parts[2]) );
+      ++lemmas[word][lemma][tag];
     }
-    tokenizer->reset();
   }
 }
 
+void remove_lemmas( const lemma_data& own, lemma_data& lemmas ){
+  // subtract the frequencies in 'own' from 'lemmas'
+  for ( const auto& word : own ){
+    lemma_tags& lems = lemmas[word.first];
+    for ( const auto& lemma : word.second ){
+      tag_freqs& tags = lems[lemma.first];
+      for ( const auto& tag : lemma.second ){
+	if ( (tags[tag.first] -= tag.second) == 0 ){
+	  tags.erase( tag.first );
+	}
+      }
+      if ( tags.empty() ){
+	lems.erase( lemma.first );
+      }
+    }
+    if ( lems.empty() ){
+      lemmas.erase( word.first );
+    }
+  }
+}
+
+bool prepare_folds( const string& corpus_name,
+		    size_t num_folds,
+		    const vector<string>& fold_names,
+		    const string& lemma_name,
+		    const set<UnicodeString>& pos_tags,
+		    const map<UnicodeString,set<UnicodeString>>& particles,
+		    const UnicodeString& eos_mark,
+		    vector<cv_fold>& folds ){
+  // sentence s is in fold s % num_folds. The first fold_names.size()
+  // folds are prepared: a test file with the fold's sentences, and a
+  // tagger datafile and an mblem trainingfile made from the other folds.
+  // The corpus is read once, and not kept in memory. Only the lemma
+  // frequencies are: of the whole corpus, and of every prepared fold.
+  folds.assign( fold_names.size(), cv_fold() );
+  size_t corpus_size = text_size( corpus_name );
+  size_t fold_size = corpus_size / num_folds;
+  size_t train_size = fold_size * ( num_folds - 1 );
+  if ( corpus_size == Toad::TempStore::unknown_size ){
+    fold_size = train_size = corpus_size;
+  }
+  vector<unique_ptr<ofstream>> train_os;
+  vector<unique_ptr<ofstream>> test_os;
+  for ( size_t f=0; f < folds.size(); ++f ){
+    cv_fold& fold = folds[f];
+    fold.train_corpus = temp_dir + fold_names[f] + ".data";
+    fold.settings = temp_dir + fold_names[f] + ".settings";
+    fold.mblem_data = fold_names[f] + ".mblem.data";
+    fold.mblem_tree = temp_dir + fold_names[f] + ".mblem.tree";
+    fold.test_file = temp_dir + fold_names[f] + ".test";
+    temp_create( fold.train_corpus, train_size );
+    train_os.emplace_back( new ofstream( fold.train_corpus ) );
+    temp_create( fold.test_file, fold_size );
+    test_os.emplace_back( new ofstream( fold.test_file ) );
+    if ( !*train_os.back() || !*test_os.back() ){
+      cerr << "couldn't create the files of fold " << f+1 << endl;
+      return false;
+    }
+  }
+  UnicodeString eos_line = ( eos_mark == "EL" ) ? "" : eos_mark;
+  lemma_data all_lemmas;
+  vector<lemma_data> own_lemmas( folds.size() );
+  size_t sentence_count = 0;
+  vector<vector<UnicodeString>> sentence;
+  auto add_sentence = [&](){
+    size_t own = sentence_count++ % num_folds;
+    for ( size_t f=0; f < folds.size(); ++f ){
+      if ( f == own ){
+	// all the columns, read back by read_test()
+	for ( const auto& parts : sentence ){
+	  for ( size_t i=0; i < parts.size(); ++i ){
+	    *test_os[f] << ( i > 0 ? "\t" : "" ) << parts[i];
+	  }
+	  *test_os[f] << endl;
+	}
+	*test_os[f] << endl;
+      }
+      else {
+	for ( const auto& parts : sentence ){
+	  *train_os[f] << parts[0] << "\t" << parts.back() << endl;
+	}
+	*train_os[f] << eos_line << endl;
+      }
+    }
+    add_lemmas( sentence, all_lemmas );
+    if ( own < folds.size() ){
+      add_lemmas( sentence, own_lemmas[own] );
+    }
+    sentence.clear();
+  };
+  Toad::InputFile corpus;
+  open_input( corpus, corpus_name );
+  UnicodeString line;
+  size_t line_count = 0;
+  while ( TiCC::getline( corpus, line, encoding ) ){
+    ++line_count;
+    if ( ( line.isEmpty() && eos_mark == "EL" )
+	 || line == eos_mark ){
+      if ( !sentence.empty() ){
+	add_sentence();
+      }
+      continue;
+    }
+    if ( line.isEmpty() ){
+      continue;
+    }
+    vector<UnicodeString> parts = TiCC::split_at( line, "\t" );
+    if ( parts.size() != 2 && parts.size() != 3 ){
+      cerr << "invalid input line (" << line_count << "): '" << line
+	   << "'" << endl;
+      return false;
+    }
+    sentence.push_back( parts );
+  }
+  check_input( corpus );
+  if ( !sentence.empty() ){
+    add_sentence();
+  }
+  for ( size_t f=0; f < folds.size(); ++f ){
+    train_os[f]->close();
+    test_os[f]->close();
+    temp_done( folds[f].train_corpus );
+    temp_done( folds[f].test_file );
+  }
+  if ( sentence_count < num_folds ){
+    cerr << "not enough sentences (" << sentence_count << ") for "
+	 << num_folds << " folds" << endl;
+    return false;
+  }
+  cout << "found " << sentence_count << " sentences" << endl;
+  for ( size_t f=0; f < folds.size(); ++f ){
+    // one fold at a time, so only one copy of the frequencies is extra
+    lemma_data lemmas = all_lemmas;
+    remove_lemmas( own_lemmas[f], lemmas );
+    own_lemmas[f].clear();
+    if ( !lemma_name.empty() ){
+      Toad::InputFile is;
+      open_input( is, lemma_name );
+      fill_lemmas( is, lemmas, pos_tags, eos_mark );
+      check_input( is );
+    }
+    if ( !lemmas.empty() ){
+      create_mblem_trainfile( lemmas, particles, folds[f].mblem_data );
+    }
+    else {
+      folds[f].mblem_data.clear();
+    }
+  }
+  return true;
+}
+
+void read_test( cv_fold& fold ){
+  // the test sentences of 'fold', as prepare_folds() wrote them
+  ifstream is( fold.test_file );
+  UnicodeString line;
+  Toad::labeled_sentence test;
+  vector<UnicodeString> test_lemmas;
+  while ( TiCC::getline( is, line ) ){
+    if ( !line.isEmpty() ){
+      vector<UnicodeString> parts = TiCC::split_at( line, "\t" );
+      test.words.push_back( TiCC::utrim( parts[0] ) );
+      test.labels.push_back( TiCC::utrim( parts.back() ) );
+      test_lemmas.push_back( parts.size() == 3 ? TiCC::utrim( parts[1] )
+			     : "" );
+    }
+    else if ( !test.words.empty() ){
+      fold.test.push_back( test );
+      fold.test_lemmas.push_back( test_lemmas );
+      test = Toad::labeled_sentence();
+      test_lemmas.clear();
+    }
+  }
+}
+
+void free_test( cv_fold& fold ){
+  vector<Toad::labeled_sentence>().swap( fold.test );
+  vector<vector<UnicodeString>>().swap( fold.test_lemmas );
+}
+
+vector<string> tagger_files( const string& settings ){
+  // the known and unknown words instancebases, as listed in the MBT
+  // settings file
+  ifstream is( settings );
+  string dir = TiCC::dirname( settings );
+  string line;
+  vector<string> result;
+  while ( getline( is, line ) ){
+    vector<string> parts = TiCC::split( line );
+    if ( parts.size() == 2 && ( parts[0] == "k" || parts[0] == "u" ) ){
+      string file = parts[1];
+      if ( file[0] != '/' ){
+	file = dir + "/" + file;
+      }
+      result.push_back( file );
+    }
+  }
+  return result;
+}
+
+size_t tagger_size( const string& settings ){
+  size_t result = 0;
+  for ( const auto& file : tagger_files( settings ) ){
+    result += Toad::file_size( file );
+  }
+  return result;
+}
+
+void temp_tagger( const string& settings ){
+  // a tagger that is only trained for testing
+  temp_store.add( settings );
+  for ( const auto& file : tagger_files( settings ) ){
+    temp_store.add( file );
+  }
+}
+
+struct score {
+  size_t total = 0;
+  size_t correct = 0;
+  double per_sec = 0.0;  // tokens or classifications per second
+  double accuracy() const {
+    return total ? 100.0 * correct / total : 0.0;
+  }
+};
+
+bool score_tagger( const string& settings,
+		   const vector<Toad::labeled_sentence>& test,
+		   score& result ){
+  static TiCC::LogStream cv_log( cerr );
+  MbtAPI tagger( "-s " + settings, cv_log );
+  if ( !tagger.isInit() ){
+    return false;
+  }
+  Toad::BatchTagger batch_tagger( &tagger );
+  vector<vector<Tagger::TagResult>> results;
+  batch_tagger.tag( test, test.size(), results );
+  for ( size_t i=0; i < test.size(); ++i ){
+    const vector<UnicodeString>& gold = test[i].labels;
+    result.total += gold.size();
+    for ( size_t j=0; j < gold.size() && j < results[i].size(); ++j ){
+      if ( results[i][j].assigned_tag() == gold[j] ){
+	++result.correct;
+      }
+    }
+  }
+  if ( batch_tagger.tag_seconds() > 0.0 ){
+    result.per_sec = batch_tagger.words() / batch_tagger.tag_seconds();
+  }
+  return true;
+}
+
+bool score_lemmatizer( const string& timblopts,
+		       const string& treefile,
+		       const vector<Toad::labeled_sentence>& test,
+		       const vector<vector<UnicodeString>>& test_lemmas,
+		       const map<UnicodeString,set<UnicodeString>>& particles,
+		       score& result ){
+  // a lemma is correct when the gold tag and edit are one of the
+  // alternatives of the class. Frog chooses between those on the tag.
+  Timbl::TimblAPI timbl( timblopts );
+  if ( !timbl.GetInstanceBase( treefile ) ){
+    return false;
+  }
+  Toad::EditScripter scripter( particles );
+  set<UnicodeString> tags;
+  for ( const auto& sent : test ){
+    tags.insert( sent.labels.begin(), sent.labels.end() );
+  }
+  for ( const auto& tag : tags ){
+    scripter.add_tag( tag );
+  }
+  double seconds = 0.0;
+  for ( size_t i=0; i < test.size(); ++i ){
+    const Toad::labeled_sentence& sent = test[i];
+    for ( size_t j=0; j < test_lemmas[i].size(); ++j ){
+      const UnicodeString& lemma = test_lemmas[i][j];
+      if ( lemma.isEmpty() ){
+	continue;
+      }
+      ++result.total;
+      string cls;
+      string instance = TiCC::UnicodeToUTF8( mblem_instance( sent.words[j] ) )
+	+ "?";
+      auto start = chrono::steady_clock::now();
+      bool classified = timbl.Classify( instance, cls );
+      seconds
+	+= chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+      if ( !classified ){
+	continue;
+      }
+      UnicodeString gold = sent.labels[j]
+	+ scripter.derive( sent.words[j], lemma, sent.labels[j] ).label();
+      for ( const auto& part
+	      : TiCC::split_at( TiCC::UnicodeFromUTF8( cls ), "|" ) ){
+	if ( part == gold ){
+	  ++result.correct;
+	  break;
+	}
+      }
+    }
+  }
+  if ( seconds > 0.0 ){
+    result.per_sec = result.total / seconds;
+  }
+  return true;
+}
+
+class memory_budget {
+  // lets trainings start while their estimated memory fits. A job that
+  // is larger than the whole budget runs when nothing else does.
+public:
+  explicit memory_budget( size_t bytes ): _free( bytes ), _running( 0 ) {};
+  size_t acquire( size_t bytes ){
+    // wait for room, and return what is taken from the budget
+    unique_lock<mutex> lock( _mutex );
+    _cv.wait( lock, [&]{ return bytes <= _free || _running == 0; } );
+    size_t taken = min( bytes, _free );
+    _free -= taken;
+    ++_running;
+    return taken;
+  };
+  void release( size_t taken ){
+    {
+      lock_guard<mutex> lock( _mutex );
+      _free += taken;
+      --_running;
+    }
+    _cv.notify_all();
+  };
+private:
+  mutex _mutex;
+  condition_variable _cv;
+  size_t _free;
+  size_t _running;
+};
+
+// rough memory use of a training, in times the size of its datafile
+const size_t mbt_memory_factor = 8;   // known AND unknown words trees
+const size_t timbl_memory_factor = 4;
+
+bool cross_validate( const Configuration& config,
+		     const string& base_name,
+		     const string& corpus_name,
+		     const string& lemma_name,
+		     const set<UnicodeString>& pos_tags,
+		     const map<UnicodeString,set<UnicodeString>>& particles,
+		     const UnicodeString& eos_mark,
+		     size_t num_folds,
+		     size_t memory_mb ){
+  // split the corpus in 'num_folds' folds of whole sentences, train a
+  // tagger and a lemmatizer for every fold on the other folds, at the
+  // same time as far as 'memory_mb' allows, and test them on the fold.
+  cout << "cross validation: reading sentences from " << corpus_name << endl;
+  vector<string> fold_names;
+  for ( size_t f=0; f < num_folds; ++f ){
+    fold_names.push_back( base_name + ".cv" + TiCC::toString( f+1 ) );
+  }
+  vector<cv_fold> folds;
+  if ( !prepare_folds( corpus_name, num_folds, fold_names, lemma_name,
+		       pos_tags, particles, eos_mark, folds ) ){
+    return false;
+  }
+  // training t < num_folds is the tagger of fold t, the others are the
+  // lemmatizers. The largest first, so the small ones fill the gaps
+  vector<size_t> estimates( 2*num_folds, 0 );
+  for ( size_t f=0; f < num_folds; ++f ){
+    estimates[f] = mbt_memory_factor * Toad::file_size( folds[f].train_corpus );
+    if ( !folds[f].mblem_data.empty() ){
+      estimates[num_folds+f] = timbl_memory_factor
+	* Toad::file_size( temp_dir + folds[f].mblem_data );
+    }
+  }
+  vector<size_t> order( 2*num_folds );
+  for ( size_t t=0; t < order.size(); ++t ){
+    order[t] = t;
+  }
+  stable_sort( order.begin(), order.end(),
+	       [&]( size_t t1, size_t t2 ){
+		 return estimates[t1] > estimates[t2];
+	       } );
+  cout << "training " << num_folds << " taggers and lemmatizers";
+  if ( memory_mb > 0 ){
+    cout << " within " << memory_mb << " MB";
+  }
+  cout << ". this may take several minutes, depending on the corpus size."
+       << endl;
+  memory_budget budget( memory_mb > 0 ? memory_mb * 1024 * 1024
+			: numeric_limits<size_t>::max() );
+  string mblem_opts = config.lookUp( "timblOpts", "mblem" );
+#pragma omp parallel for schedule(dynamic,1)
+  for ( size_t i=0; i < order.size(); ++i ){
+    size_t t = order[i];
+    cv_fold& fold = folds[t % num_folds];
+    if ( t >= num_folds && fold.mblem_data.empty() ){
+      continue;
+    }
+    size_t taken = budget.acquire( estimates[t] );
+    auto start = chrono::steady_clock::now();
+    if ( t < num_folds ){
+      fold.tagger_ok
+	= MbtAPI::GenerateTagger( tagger_command( config,
+						  fold.train_corpus,
+						  fold.settings ) );
+      fold.tagger_seconds
+	= chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+    }
+    else if ( !fold.mblem_data.empty() ){
+      Timbl::TimblAPI timbl( mblem_opts );
+      fold.mblem_ok = timbl.Learn( temp_dir + fold.mblem_data )
+	&& timbl.WriteInstanceBase( fold.mblem_tree );
+      fold.mblem_seconds
+	= chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+    }
+    budget.release( taken );
+  }
+  // evaluate one fold at a time, so the speeds are comparable, and only
+  // one test set is in memory
+  for ( auto& fold : folds ){
+    read_test( fold );
+    if ( fold.tagger_ok ){
+      score tag_score;
+      if ( score_tagger( fold.settings, fold.test, tag_score ) ){
+	fold.tokens = tag_score.total;
+	fold.tags_correct = tag_score.correct;
+	fold.tokens_per_sec = tag_score.per_sec;
+      }
+      fold.tagger_bytes = tagger_size( fold.settings );
+      temp_tagger( fold.settings );
+    }
+    if ( fold.mblem_ok ){
+      score lem_score;
+      if ( score_lemmatizer( mblem_opts, fold.mblem_tree, fold.test,
+			     fold.test_lemmas, particles, lem_score ) ){
+	fold.lemmas = lem_score.total;
+	fold.lemmas_correct = lem_score.correct;
+      }
+      fold.mblem_bytes = Toad::file_size( fold.mblem_tree );
+      temp_store.add( fold.mblem_tree );
+    }
+    free_test( fold );
+    temp_store.remove( fold.test_file );
+  }
+  cout << "fold\ttag acc\tlem acc\ttag train s\tlem train s\ttagger bytes"
+       << "\tmblem bytes\ttokens/sec" << endl;
+  double tag_sum = 0.0;
+  double lem_sum = 0.0;
+  double speed_sum = 0.0;
+  size_t tag_folds = 0;
+  size_t lem_folds = 0;
+  for ( size_t f=0; f < num_folds; ++f ){
+    const cv_fold& fold = folds[f];
+    cout << f+1 << "\t";
+    if ( fold.tagger_ok && fold.tokens > 0 ){
+      double acc = 100.0 * fold.tags_correct / fold.tokens;
+      tag_sum += acc;
+      speed_sum += fold.tokens_per_sec;
+      ++tag_folds;
+      cout << acc;
+    }
+    else {
+      cout << "-";
+    }
+    cout << "\t";
+    if ( fold.mblem_ok && fold.lemmas > 0 ){
+      double acc = 100.0 * fold.lemmas_correct / fold.lemmas;
+      lem_sum += acc;
+      ++lem_folds;
+      cout << acc;
+    }
+    else {
+      cout << "-";
+    }
+    cout << "\t" << fold.tagger_seconds << "\t" << fold.mblem_seconds
+	 << "\t" << fold.tagger_bytes << "\t" << fold.mblem_bytes
+	 << "\t" << size_t(fold.tokens_per_sec) << endl;
+  }
+  if ( tag_folds > 0 ){
+    cout << "mean tagger accuracy: " << tag_sum / tag_folds << "% at "
+	 << size_t(speed_sum / tag_folds) << " tokens/sec" << endl;
+  }
+  if ( lem_folds > 0 ){
+    cout << "mean lemmatizer accuracy: " << lem_sum / lem_folds << "%"
+	 << endl;
+  }
+  bool ok = true;
+  for ( const auto& fold : folds ){
+    if ( !fold.tagger_ok || ( !fold.mblem_data.empty() && !fold.mblem_ok ) ){
+      ok = false;
+    }
+  }
+  if ( !ok ){
+    cerr << "the training of some folds failed" << endl;
+  }
+  return ok;
+}
+
+struct sweep_axis {
+  // one line of a sweep file: "module key = value | value | ..."
+  string module;
+  string key;
+  vector<string> values;
+};
+
+bool read_sweep( const string& filename,
+		 vector<sweep_axis>& axes ){
+  ifstream is( filename );
+  if ( !is ){
+    cerr << "unable to open sweep file: " << filename << endl;
+    return false;
+  }
+  const set<string> tagger_keys = { "p", "P", "M", "n", "timblOpts" };
+  string line;
+  size_t line_count = 0;
+  while ( getline( is, line ) ){
+    ++line_count;
+    line = TiCC::trim( line );
+    if ( line.empty() || line[0] == '#' ){
+      continue;
+    }
+    string::size_type eq = line.find( '=' );
+    vector<string> head;
+    if ( eq != string::npos ){
+      head = TiCC::split( line.substr( 0, eq ) );
+    }
+    if ( head.size() != 2
+	 || ( head[0] == "tagger" && tagger_keys.count( head[1] ) == 0 )
+	 || ( head[0] == "mblem" && head[1] != "timblOpts" )
+	 || ( head[0] != "tagger" && head[0] != "mblem" ) ){
+      cerr << "invalid line " << line_count << " in " << filename << ": '"
+	   << line << "'" << endl
+	   << "expected 'tagger p|P|M|n|timblOpts = value | value ...' or "
+	   << "'mblem timblOpts = value | value ...'" << endl;
+      return false;
+    }
+    sweep_axis axis;
+    axis.module = head[0];
+    axis.key = head[1];
+    for ( const auto& other : axes ){
+      if ( other.module == axis.module && other.key == axis.key ){
+	// the values of a key are alternatives, two axes can't be combined
+	cerr << "line " << line_count << " in " << filename << ": '"
+	     << axis.module << " " << axis.key
+	     << "' is already swept, put all its values on one line" << endl;
+	return false;
+      }
+    }
+    for ( const auto& value : TiCC::split_at( line.substr( eq+1 ), "|" ) ){
+      axis.values.push_back( TiCC::trim( value ) );
+    }
+    if ( axis.values.empty() ){
+      cerr << "no values on line " << line_count << " in " << filename
+	   << endl;
+      return false;
+    }
+    axes.push_back( axis );
+  }
+  return true;
+}
+
+struct sweep_job {
+  string module;
+  vector<pair<string,string>> settings; // the swept keys and their values
+  string data;         // tagger: a link to the shared datafile
+  string model;        // tagger: settingsfile, mblem: tree
+  string timblopts;    // mblem
+  size_t estimate = 0; // bytes of memory, roughly
+  bool ok = false;
+  double train_seconds = 0.0;
+  size_t bytes = 0;
+  score result;
+  bool pareto = false;
+};
+
+vector<vector<pair<string,string>>> grid( const vector<sweep_axis>& axes,
+					  const string& module ){
+  // all combinations of the values of the axes of 'module'
+  vector<vector<pair<string,string>>> result( 1 );
+  for ( const auto& axis : axes ){
+    if ( axis.module != module ){
+      continue;
+    }
+    vector<vector<pair<string,string>>> next;
+    for ( const auto& partial : result ){
+      for ( const auto& value : axis.values ){
+	next.push_back( partial );
+	next.back().push_back( make_pair( axis.key, value ) );
+      }
+    }
+    result = next;
+  }
+  if ( result.size() == 1 && result[0].empty() ){
+    result.clear();
+  }
+  return result;
+}
+
+void mark_pareto( vector<sweep_job>& jobs ){
+  // a job is on the front when no other job of the same module is at
+  // least as accurate, fast and small, and better in one of those.
+  for ( auto& job : jobs ){
+    if ( !job.ok ){
+      continue;
+    }
+    job.pareto = true;
+    for ( const auto& other : jobs ){
+      if ( &other == &job || !other.ok || other.module != job.module ){
+	continue;
+      }
+      double acc = job.result.accuracy();
+      double o_acc = other.result.accuracy();
+      if ( o_acc >= acc
+	   && other.result.per_sec >= job.result.per_sec
+	   && other.bytes <= job.bytes
+	   && ( o_acc > acc
+		|| other.result.per_sec > job.result.per_sec
+		|| other.bytes < job.bytes ) ){
+	job.pareto = false;
+	break;
+      }
+    }
+  }
+}
+
+bool sweep( const Configuration& config,
+	    const string& base_name,
+	    const string& corpus_name,
+	    const string& lemma_name,
+	    const string& sweep_name,
+	    size_t memory_mb,
+	    size_t holdout,
+	    const set<UnicodeString>& pos_tags,
+	    const map<UnicodeString,set<UnicodeString>>& particles,
+	    const UnicodeString& eos_mark ){
+  // train a tagger or lemmatizer for every combination of the settings
+  // in 'sweep_name', all on the same datafiles, and test them on the
+  // same held-out sentences (1 in 'holdout').
+  vector<sweep_axis> axes;
+  if ( !read_sweep( sweep_name, axes ) ){
+    return false;
+  }
+  // the first of 'holdout' folds
+  vector<cv_fold> folds;
+  if ( !prepare_folds( corpus_name, holdout, { base_name + ".sweep" },
+		       lemma_name, pos_tags, particles, eos_mark, folds ) ){
+    return false;
+  }
+  cv_fold& shared = folds[0];
+  read_test( shared );
+  temp_store.remove( shared.test_file );
+  vector<sweep_job> jobs;
+  for ( const auto& settings : grid( axes, "tagger" ) ){
+    sweep_job job;
+    job.module = "tagger";
+    job.settings = settings;
+    string name = temp_dir + base_name + ".sweep"
+      + TiCC::toString( jobs.size()+1 );
+    // MBT names its files after the datafile, so every job gets its own
+    // name for the shared one. Both are in temp_dir, and a relative link
+    // target is relative to the directory of the link.
+    job.data = name + ".data";
+    remove( job.data.c_str() );
+    temp_store.add( job.data );
+    string target = TiCC::basename( shared.train_corpus );
+    if ( symlink( target.c_str(), job.data.c_str() ) != 0 ){
+      ifstream is( shared.train_corpus );
+      ofstream os( job.data );
+      os << is.rdbuf();
+    }
+    job.model = name + ".settings";
+    job.estimate = mbt_memory_factor * Toad::file_size( shared.train_corpus );
+    jobs.push_back( job );
+  }
+  if ( !shared.mblem_data.empty() ){
+    // timblOpts is the only mblem key, so there is at most one axis
+    for ( const auto& settings : grid( axes, "mblem" ) ){
+      sweep_job job;
+      job.module = "mblem";
+      job.settings = settings;
+      job.timblopts = settings[0].second;
+      job.model = temp_dir + base_name + ".sweep"
+	+ TiCC::toString( jobs.size()+1 ) + ".tree";
+      job.estimate = timbl_memory_factor
+	* Toad::file_size( temp_dir + shared.mblem_data );
+      jobs.push_back( job );
+    }
+  }
+  if ( jobs.empty() ){
+    cerr << "nothing to sweep in " << sweep_name << endl;
+    return false;
+  }
+  // the largest first, so the small ones fill the gaps
+  stable_sort( jobs.begin(), jobs.end(),
+	       []( const sweep_job& j1, const sweep_job& j2 ){
+		 return j1.estimate > j2.estimate;
+	       } );
+  cout << "sweep: training " << jobs.size() << " models";
+  if ( memory_mb > 0 ){
+    cout << " within " << memory_mb << " MB";
+  }
+  cout << endl;
+  memory_budget budget( memory_mb > 0 ? memory_mb * 1024 * 1024
+			: numeric_limits<size_t>::max() );
+#pragma omp parallel for schedule(dynamic,1)
+  for ( size_t j=0; j < jobs.size(); ++j ){
+    sweep_job& job = jobs[j];
+    size_t taken = budget.acquire( job.estimate );
+    auto start = chrono::steady_clock::now();
+    if ( job.module == "tagger" ){
+      Configuration job_config = config;
+      for ( const auto& setting : job.settings ){
+	job_config.setatt( setting.first, setting.second, "tagger" );
+      }
+      job.ok = MbtAPI::GenerateTagger( tagger_command( job_config,
+						       job.data,
+						       job.model ) );
+    }
+    else {
+      Timbl::TimblAPI timbl( job.timblopts );
+      job.ok = timbl.Learn( temp_dir + shared.mblem_data )
+	&& timbl.WriteInstanceBase( job.model );
+    }
+    job.train_seconds
+      = chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+    budget.release( taken );
+  }
+  // test one at a time, so the speeds are comparable
+  for ( auto& job : jobs ){
+    if ( !job.ok ){
+      continue;
+    }
+    if ( job.module == "tagger" ){
+      job.ok = score_tagger( job.model, shared.test, job.result );
+      job.bytes = tagger_size( job.model );
+      temp_tagger( job.model );
+    }
+    else {
+      job.ok = score_lemmatizer( job.timblopts, job.model, shared.test,
+				 shared.test_lemmas, particles, job.result );
+      job.bytes = Toad::file_size( job.model );
+      temp_store.add( job.model );
+    }
+  }
+  mark_pareto( jobs );
+  stable_sort( jobs.begin(), jobs.end(),
+	       []( const sweep_job& j1, const sweep_job& j2 ){
+		 if ( j1.module != j2.module ){
+		   return j1.module > j2.module; // tagger first
+		 }
+		 return j1.result.accuracy() > j2.result.accuracy();
+	       } );
+  cout << "module\taccuracy\tper sec\tbytes\ttrain s\tpareto\tsettings"
+       << endl;
+  bool ok = true;
+  for ( const auto& job : jobs ){
+    cout << job.module << "\t";
+    if ( job.ok ){
+      cout << job.result.accuracy() << "\t" << size_t(job.result.per_sec)
+	   << "\t" << job.bytes << "\t" << job.train_seconds << "\t"
+	   << ( job.pareto ? "*" : "" );
+    }
+    else {
+      cout << "FAILED\t\t\t\t";
+      ok = false;
+    }
+    cout << "\t";
+    for ( size_t i=0; i < job.settings.size(); ++i ){
+      cout << ( i > 0 ? " " : "" ) << job.settings[i].first << "=\""
+	   << job.settings[i].second << "\"";
+    }
+    cout << endl;
+  }
+  cout << "'*' marks the models on the speed/accuracy/size Pareto front"
+       << endl;
+  return ok;
+}
+
 void add_cgn_files( const string& output_dir,
 		    Configuration& config ){
   // copy the cgn files to the output_dir
@@ -626,7 +2127,9 @@ void add_cgn_files( const string& output_dir,
 
 int main( int argc, char * const argv[] ) {
   TiCC::CL_Options opts( "b:t:T:l:e:O:c:hV",
-			 "help,version,postags:,eos:,lemma-out:,temp-dir:,CGN");
+			 "help,version,postags:,eos:,lemma-out:,temp-dir:,CGN,"
+			 "merge-classes,prune-classes:,shards:,shard-jobs:,cv:,sweep:,sweep-memory:,"
+			 "temp-memory:,keep-temp,folia");
   try {
     opts.parse_args( argc, argv );
   }
@@ -659,15 +2162,24 @@ int main( int argc, char * const argv[] ) {
 	 << "of the input files." << endl;
     return EXIT_FAILURE;
   }
+  bool use_folia = opts.extract( "folia" );
   if ( !opts.extract( 'T', corpusname ) ){
     cout << "Missing a corpus!, (-T option), assuming lemmas only" << endl;
     lemma_file_only = true;
+    if ( use_folia ){
+      cerr << "--folia needs a corpus (-T option)" << endl;
+      exit( EXIT_FAILURE );
+    }
   }
-  else if ( !isFile( corpusname ) ){
+  else if ( !isFile( corpusname )
+	    && !( use_folia && isDir( corpusname ) ) ){
     cerr << "unable to find the corpus: " << corpusname << endl;
     exit( EXIT_FAILURE );
   }
   else {
+    while ( corpusname.size() > 1 && corpusname.back() == '/' ){
+      corpusname.pop_back();
+    }
     base_name = TiCC::basename( corpusname );
   }
   if ( opts.extract( 'c', configfile ) ){
@@ -725,10 +2237,74 @@ int main( int argc, char * const argv[] ) {
   }
   UnicodeString eos_mark = "<utt>";
   string value;
-  opts.extract( "eos", value );
-  if ( !value.empty() ){
+  if ( opts.extract( "eos", value ) && !value.empty() ){
     eos_mark = TiCC::UnicodeFromUTF8(value);
   }
+  if ( opts.extract( "temp-memory", value ) ){
+    size_t mb = 0;
+    if ( !TiCC::stringTo( value, mb ) ){
+      cerr << "illegal value for --temp-memory: " << value << endl;
+      return EXIT_FAILURE;
+    }
+    if ( mb > 0 && !Toad::TempStore::memory_supported() ){
+      cerr << "--temp-memory is not supported on this system. "
+	   << "Using the temp-dir" << endl;
+    }
+    else {
+      temp_store.set_budget( mb * 1024 * 1024 );
+    }
+  }
+  temp_store.keep( opts.extract( "keep-temp" ) );
+  merge_classes = opts.extract( "merge-classes" );
+  if ( opts.extract( "prune-classes", value ) ){
+    if ( !TiCC::stringTo( value, class_threshold ) ){
+      cerr << "illegal value for --prune-classes: " << value << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if ( opts.extract( "shards", value ) ){
+    if ( !TiCC::stringTo( value, mblem_shards ) ){
+      cerr << "illegal value for --shards: " << value << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if ( opts.extract( "shard-jobs", value ) ){
+    if ( !TiCC::stringTo( value, shard_jobs ) || shard_jobs < 1 ){
+      cerr << "illegal value for --shard-jobs: " << value << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if ( shard_jobs == 0 ){
+#ifdef HAVE_OPENMP
+    shard_jobs = omp_get_max_threads();
+#else
+    shard_jobs = 1;
+#endif
+  }
+  size_t cv_folds = 0;
+  if ( opts.extract( "cv", value ) ){
+    if ( !TiCC::stringTo( value, cv_folds ) || cv_folds < 2 ){
+      cerr << "illegal value for --cv: " << value << endl;
+      return EXIT_FAILURE;
+    }
+    if ( lemma_file_only ){
+      cerr << "--cv needs a corpus (-T option)" << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  string sweep_name;
+  opts.extract( "sweep", sweep_name );
+  size_t sweep_memory = 0;
+  if ( opts.extract( "sweep-memory", value ) ){
+    if ( !TiCC::stringTo( value, sweep_memory ) ){
+      cerr << "illegal value for --sweep-memory: " << value << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if ( !sweep_name.empty() && lemma_file_only ){
+    cerr << "--sweep needs a corpus (-T option)" << endl;
+    return EXIT_FAILURE;
+  }
   bool t_opt = opts.extract( 't', tokfile );
   if ( !t_opt ){
     string tokdir = use_config.getatt( "configDir", "tokenizer" );
@@ -741,7 +2317,7 @@ int main( int argc, char * const argv[] ) {
       tokfile = tokdir + file;
     }
   }
-  Tokenizer::TokenizerClass *tokenizer = 0;
+  string check_rules; // the tokenizer to check the lexicon with
   if ( !tokfile.empty() ) {
     if ( !isFile(tokfile) ){
       cerr << "unable to find: '" << tokfile << "'" << endl;
@@ -757,8 +2333,7 @@ int main( int argc, char * const argv[] ) {
     }
     use_config.setatt( "rulesFile", TiCC::basename(tokfile), "tokenizer" );
     if ( t_opt ){
-      tokenizer = new Tokenizer::TokenizerClass();
-      tokenizer->init( tokfile );
+      check_rules = tokfile;
     }
   }
   opts.extract( 'e', encoding );
@@ -785,27 +2360,36 @@ int main( int argc, char * const argv[] ) {
     return EXIT_FAILURE;
   }
   set<UnicodeString> pos_tags = fill_postags( pos_tags_file );
-  multimap<UnicodeString,map<UnicodeString,map<UnicodeString,size_t>>> data;
-  // WTF is this?
-  // a mutimap of Words to a map of lemmas to a frequency list of POS tags.
-  // this structure is probably overly complex. redesign is needed.
-  // e.g. on output we have te re-sort it to make it usable.
+  if ( use_folia ){
+    // from here on, the corpus is the extracted one
+    corpusname = extract_folia( corpusname, base_name, eos_mark );
+  }
+  if ( !sweep_name.empty() ){
+    return sweep( use_config, base_name, corpusname, lemma_name, sweep_name,
+		  sweep_memory, cv_folds > 0 ? cv_folds : 10,
+		  pos_tags, particles, eos_mark )
+      ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if ( cv_folds > 0 ){
+    return cross_validate( use_config, base_name, corpusname, lemma_name,
+			   pos_tags, particles, eos_mark, cv_folds,
+			   sweep_memory )
+      ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  lemma_data data;
+  // a map of Words to a map of lemmas to a frequency list of POS tags.
+  // all strings are interned in lemma_pool, so every distinct word, lemma
+  // and tag is stored only once.
   if ( !lemma_file_only ){
     cout << "start reading lemmas from the corpus: " << corpusname << endl;
     cout << "EOS marker = '" << eos_mark << "'" << endl;
-    ifstream corpus( corpusname);
+    Toad::InputFile corpus;
+    open_input( corpus, corpusname );
     fill_lemmas( corpus, data, pos_tags, eos_mark );
+    check_input( corpus );
     if ( debug ){
       cerr << "current data" << endl;
-      for ( const auto& it1 : data ){
-	cerr << it1.first;
-	for( const auto& it2 : it1.second ){
-	  cerr << "\t" << it2.first << endl;
-	  for( const auto& it3 : it2.second ){
-	    cerr << "\t\t\t" << it3.first << " " << it3.second << endl;
-	  }
-	}
-      }
+      dump_lemmas( cerr, data );
     }
     if ( data.size() == 0 ){
       cout << "no lemma information found. carry on " << endl;
@@ -816,33 +2400,19 @@ int main( int argc, char * const argv[] ) {
   }
   if ( !lemma_name.empty() ){
     cout << "start reading extra lemmas from: " << lemma_name << endl;
-    ifstream is( lemma_name);
+    Toad::InputFile is;
+    open_input( is, lemma_name );
     fill_lemmas( is, data, pos_tags, eos_mark );
+    check_input( is );
     if ( debug ){
       cerr << "current data" << endl;
-      for ( const auto& it1 : data ){
-	cerr << it1.first;
-	for( const auto& it2 : it1.second ){
-	  cerr << "\t" << it2.first << endl;
-	  for( const auto& it3 : it2.second ){
-	    cerr << "\t\t\t" << it3.first << " " << it3.second << endl;
-	  }
-	}
-      }
+      dump_lemmas( cerr, data );
     }
     cout << "done, total size=" << data.size() << endl;
   }
   if ( debug ){
     cerr << "current data" << endl;
-    for ( const auto& it1 : data ){
-      cerr << it1.first;
-      for( const auto& it2 : it1.second ){
-	cerr << "\t" << it2.first << endl;
-	for( const auto& it3 : it2.second ){
-	  cerr << "\t\t\t" << it3.first << " " << it3.second << endl;
-	}
-      }
-    }
+    dump_lemmas( cerr, data );
   }
   if ( !lemma_outname.empty() ){
     ofstream os( lemma_outname );
@@ -866,8 +2436,14 @@ int main( int argc, char * const argv[] ) {
   if ( tagger_set_name.empty() ){
     throw setting_error( "set", "mblem" );
   }
-  if ( tokenizer ){
-    check_data( tokenizer, data );
+  // the tokenizer check runs alongside the training
+  tokenizer_check check;
+  thread checker;
+  if ( !check_rules.empty() ){
+    cout << "start checking the lexicon with tokenizer: " << check_rules
+	 << endl;
+    checker = thread( check_data, cref( check_rules ), cref( data ),
+		      ref( check ) );
   }
   Configuration frog_config = use_config;
   if ( !lemma_file_only ){
@@ -881,6 +2457,13 @@ int main( int argc, char * const argv[] ) {
     frog_config.clearatt( "%", "tagger" );
   }
   create_lemmatizer( use_config, data, particles, mblem_tree_name );
+  if ( checker.joinable() ){
+    checker.join();
+    // like the lemmatizer tree: named after the lemma file with -l only
+    string check_base = lemma_file_only ? TiCC::basename( lemma_name )
+      : base_name;
+    report_check( check, output_dir + check_base + ".tokenizer.check" );
+  }
   frog_config.clearatt( "baseName", "global" );
   frog_config.clearatt( "particles", "mblem"  );
   if ( data.empty() ){
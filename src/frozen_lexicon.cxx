@@ -0,0 +1,334 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <algorithm>
+#include "ticcutils/StringOps.h"
+#include "ticcutils/Unicode.h"
+#include "toad/frozen_lexicon.h"
+
+using namespace std;
+using namespace icu;
+
+namespace Toad {
+
+  static const char lex_magic[8] = { 'T','O','A','D','L','E','X','\0' };
+  static const uint32_t lex_version = 1;
+  static const uint32_t lex_bom = 0x01020304;
+
+  struct lex_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t bom;
+    uint64_t count;       // number of words
+    uint64_t data_units;  // number of UChars in the data section
+  };
+
+  void LexiconBuilder::freeze( vector<char>& image ) const {
+    vector<string_id> ids( _words.size() );
+    for ( size_t i=0; i < ids.size(); ++i ){
+      ids[i] = i;
+    }
+    sort( ids.begin(), ids.end(),
+	  [this]( string_id a, string_id b ){
+	    return _words.compare( a, b ) < 0;
+	  } );
+    uint64_t units = 0;
+    for ( const auto& id : ids ){
+      units += _words.length( id );
+    }
+    lex_header h;
+    memcpy( h.magic, lex_magic, sizeof(lex_magic) );
+    h.version = lex_version;
+    h.bom = lex_bom;
+    h.count = ids.size();
+    h.data_units = units;
+    size_t offsets_size = (ids.size()+1) * sizeof(uint64_t);
+    image.assign( sizeof(h) + offsets_size + units * sizeof(UChar), 0 );
+    memcpy( image.data(), &h, sizeof(h) );
+    uint64_t *offsets = reinterpret_cast<uint64_t*>( image.data() + sizeof(h) );
+    UChar *data = reinterpret_cast<UChar*>( image.data() + sizeof(h)
+					    + offsets_size );
+    uint64_t pos = 0;
+    for ( size_t i=0; i < ids.size(); ++i ){
+      offsets[i] = pos;
+      int32_t len = _words.length( ids[i] );
+      memcpy( data + pos, _words.data( ids[i] ), len * sizeof(UChar) );
+      pos += len;
+    }
+    offsets[ids.size()] = pos;
+  }
+
+  bool LexiconBuilder::write( const string& filename, string& error ) const {
+    vector<char> image;
+    freeze( image );
+    ofstream os( filename, ios::binary );
+    if ( !os ){
+      error = "unable to create: '" + filename + "'";
+      return false;
+    }
+    os.write( image.data(), image.size() );
+    if ( !os ){
+      error = "write error on: '" + filename + "'";
+      return false;
+    }
+    return true;
+  }
+
+  FrozenLexicon::FrozenLexicon():
+    _map( 0 ),
+    _map_size( 0 ),
+    _offsets( 0 ),
+    _data( 0 ),
+    _count( 0 )
+  {
+  }
+
+  FrozenLexicon::~FrozenLexicon(){
+    close();
+  }
+
+  void FrozenLexicon::close(){
+    if ( _map ){
+      munmap( _map, _map_size );
+      _map = 0;
+      _map_size = 0;
+    }
+    _image.clear();
+    _offsets = 0;
+    _data = 0;
+    _count = 0;
+  }
+
+  bool FrozenLexicon::attach( const char *buf, size_t size, string& error ){
+    // check the header and set up the pointers into 'buf'
+    if ( size < sizeof(lex_header) ){
+      error = "file too small for a lexicon";
+      return false;
+    }
+    lex_header h;
+    memcpy( &h, buf, sizeof(h) );
+    if ( memcmp( h.magic, lex_magic, sizeof(lex_magic) ) != 0 ){
+      error = "not a lexicon file";
+      return false;
+    }
+    if ( h.bom != lex_bom ){
+      error = "lexicon file has the wrong byte order";
+      return false;
+    }
+    if ( h.version != lex_version ){
+      error = "unsupported lexicon version " + TiCC::toString( h.version );
+      return false;
+    }
+    size_t expected = sizeof(h) + (h.count+1) * sizeof(uint64_t)
+      + h.data_units * sizeof(UChar);
+    if ( size != expected ){
+      error = "lexicon file is truncated or corrupt";
+      return false;
+    }
+    _offsets = reinterpret_cast<const uint64_t*>( buf + sizeof(h) );
+    _data = reinterpret_cast<const UChar*>( buf + sizeof(h)
+					    + (h.count+1) * sizeof(uint64_t) );
+    _count = h.count;
+    if ( _offsets[_count] != h.data_units ){
+      error = "lexicon file is corrupt";
+      _offsets = 0;
+      _data = 0;
+      _count = 0;
+      return false;
+    }
+    return true;
+  }
+
+  bool FrozenLexicon::open( const string& filename, string& error ){
+    close();
+    int fd = ::open( filename.c_str(), O_RDONLY );
+    if ( fd < 0 ){
+      error = "unable to open '" + filename + "': " + strerror( errno );
+      return false;
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 ){
+      error = "unable to stat '" + filename + "': " + strerror( errno );
+      ::close( fd );
+      return false;
+    }
+    _map_size = st.st_size;
+    if ( _map_size > 0 ){
+      _map = mmap( 0, _map_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    }
+    ::close( fd );
+    if ( _map == MAP_FAILED || _map == 0 ){
+      error = "unable to map '" + filename + "'";
+      _map = 0;
+      _map_size = 0;
+      return false;
+    }
+    if ( !attach( static_cast<const char*>(_map), _map_size, error ) ){
+      error = filename + ": " + error;
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void FrozenLexicon::assign( const LexiconBuilder& builder ){
+    close();
+    builder.freeze( _image );
+    string error;
+    attach( _image.data(), _image.size(), error );
+  }
+
+  static int compare_units( const UChar *a, int32_t alen,
+			    const UChar *b, int32_t blen ){
+    // code unit order, like UnicodeString::compare()
+    int32_t len = min( alen, blen );
+    for ( int32_t i=0; i < len; ++i ){
+      if ( a[i] != b[i] ){
+	return a[i] < b[i] ? -1 : 1;
+      }
+    }
+    if ( alen == blen ){
+      return 0;
+    }
+    return alen < blen ? -1 : 1;
+  }
+
+  bool FrozenLexicon::contains( const UChar *s, int32_t len ) const {
+    size_t low = 0;
+    size_t high = _count;
+    while ( low < high ){
+      size_t mid = low + (high-low)/2;
+      int cmp = compare_units( _data + _offsets[mid],
+			       _offsets[mid+1] - _offsets[mid],
+			       s, len );
+      if ( cmp == 0 ){
+	return true;
+      }
+      else if ( cmp < 0 ){
+	low = mid+1;
+      }
+      else {
+	high = mid;
+      }
+    }
+    return false;
+  }
+
+  UnicodeString FrozenLexicon::word( size_t i ) const {
+    return UnicodeString( false,
+			  _data + _offsets[i],
+			  _offsets[i+1] - _offsets[i] );
+  }
+
+  long add_first_fields( LexiconBuilder& builder,
+			 const string& filename,
+			 bool lowercase ){
+    ifstream is( filename );
+    if ( !is ){
+      return -1;
+    }
+    long count = 0;
+    UnicodeString line;
+    while ( TiCC::getline( is, line ) ){
+      vector<UnicodeString> vec = TiCC::split( line );
+      if ( vec.empty() ){
+	continue;
+      }
+      if ( lowercase ){
+	vec[0].toLower();
+      }
+      builder.add( vec[0] );
+      ++count;
+    }
+    return count;
+  }
+
+  long add_mbma_words( LexiconBuilder& builder,
+		       const string& filename,
+		       ostream *problems ){
+    ifstream is( filename );
+    if ( !is ){
+      return -1;
+    }
+    long count = 0;
+    UnicodeString line;
+    while ( TiCC::getline( is, line ) ){
+      vector<UnicodeString> parts = TiCC::split_at( line, " " );
+      if ( parts.size() < 2 ){
+	if ( problems ){
+	  *problems << "Problem in line '" << line << "' (to short?)" << endl;
+	}
+	continue;
+      }
+      UnicodeString word = parts[0];
+      word.toLower();
+      int num = (int)parts.size()-1;
+      if ( word.length() != num ){
+	if ( problems ){
+	  *problems << "Problem in line '" << line << "' (" << word.length()
+		    << " letters, but got " << num << " morphemes)" << endl;
+	}
+	continue;
+      }
+      builder.add( word );
+      ++count;
+    }
+    return count;
+  }
+
+  long add_mblem_words( LexiconBuilder& builder,
+			const string& filename,
+			ostream *problems ){
+    ifstream is( filename );
+    if ( !is ){
+      return -1;
+    }
+    long count = 0;
+    UnicodeString line;
+    while ( TiCC::getline( is, line ) ){
+      vector<UnicodeString> parts = TiCC::split_at_first_of( line, " \t" );
+      if ( parts.size() != 3 ){
+	if ( problems ){
+	  *problems << "Problem in line '" << line << "' (to short?)" << endl;
+	}
+	continue;
+      }
+      UnicodeString word = parts[0];
+      word.toLower();
+      builder.add( word );
+      ++count;
+    }
+    return count;
+  }
+
+}
@@ -0,0 +1,927 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <cmath>
+#include <cctype>
+#include <limits>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <unordered_map>
+#include <memory>
+#include "toad/igtree_shards.h"
+
+using namespace std;
+
+namespace Toad {
+
+  static vector<string> split_ws( const string& line ){
+    vector<string> result;
+    istringstream is( line );
+    string tok;
+    while ( is >> tok ){
+      result.push_back( tok );
+    }
+    return result;
+  }
+
+  static double entropy( const unordered_map<string,size_t>& freqs,
+			 size_t total ){
+    double result = 0.0;
+    for ( const auto& it : freqs ){
+      double p = double(it.second) / total;
+      result -= p * log2( p );
+    }
+    return result;
+  }
+
+  size_t data_stats::top_feature() const {
+    size_t result = 0;
+    for ( size_t i=1; i < weights.size(); ++i ){
+      if ( weights[i] > weights[result] ){
+	result = i;
+      }
+    }
+    return result;
+  }
+
+  bool gather_stats( const string& datafile,
+		     bool ig,
+		     data_stats& stats ){
+    ifstream is( datafile );
+    if ( !is ){
+      return false;
+    }
+    stats = data_stats();
+    size_t num_feats = 0;
+    // per feature: value -> class -> frequency
+    vector<unordered_map<string,unordered_map<string,size_t>>> joint;
+    string line;
+    while ( getline( is, line ) ){
+      vector<string> parts = split_ws( line );
+      if ( parts.empty() ){
+	continue;
+      }
+      if ( num_feats == 0 ){
+	num_feats = parts.size() - 1;
+	if ( num_feats == 0 ){
+	  return false;
+	}
+	joint.resize( num_feats );
+	stats.value_freqs.resize( num_feats );
+      }
+      else if ( parts.size() != num_feats + 1 ){
+	return false;
+      }
+      const string& cls = parts.back();
+      ++stats.class_freqs[cls];
+      for ( size_t f=0; f < num_feats; ++f ){
+	++stats.value_freqs[f][parts[f]];
+	++joint[f][parts[f]][cls];
+      }
+      ++stats.instances;
+    }
+    if ( stats.instances == 0 ){
+      return false;
+    }
+    unordered_map<string,size_t> cf( stats.class_freqs.begin(),
+				     stats.class_freqs.end() );
+    double db_entropy = entropy( cf, stats.instances );
+    for ( size_t f=0; f < num_feats; ++f ){
+      double cond = 0.0;
+      double split = 0.0;
+      for ( const auto& it : joint[f] ){
+	size_t vf = stats.value_freqs[f][it.first];
+	double p = double(vf) / stats.instances;
+	cond += p * entropy( it.second, vf );
+	split -= p * log2( p );
+      }
+      double gain = db_entropy - cond;
+      if ( gain < 0.0 ){
+	gain = 0.0;
+      }
+      if ( ig ){
+	stats.weights.push_back( gain );
+      }
+      else {
+	stats.weights.push_back( split > 0.0 ? gain / split : 0.0 );
+      }
+    }
+    return true;
+  }
+
+  bool write_weights( const string& filename,
+		      const data_stats& stats ){
+    ofstream os( filename );
+    if ( !os ){
+      return false;
+    }
+    // make sure the top feature is unique, so Timbl can't choose another
+    // one on a tie
+    size_t top = stats.top_feature();
+    os << "# Classes: " << stats.class_freqs.size() << endl;
+    os << "# Lines of data: " << stats.instances << endl;
+    os << "# Fea.\tWeight" << endl;
+    os << setprecision(12);
+    for ( size_t f=0; f < stats.weights.size(); ++f ){
+      double w = stats.weights[f];
+      if ( f == top ){
+	w += 1.0e-6;
+      }
+      os << f+1 << "\t" << w << endl;
+    }
+    os << "#" << endl;
+    return os.good();
+  }
+
+  vector<set<string>> plan_shards( const data_stats& stats, size_t num ){
+    const auto& values = stats.value_freqs[stats.top_feature()];
+    // largest values first, into the least filled shard
+    vector<pair<size_t,string>> sorted;
+    for ( const auto& it : values ){
+      sorted.push_back( make_pair( it.second, it.first ) );
+    }
+    sort( sorted.begin(), sorted.end(),
+	  []( const pair<size_t,string>& p1, const pair<size_t,string>& p2 ){
+	    if ( p1.first != p2.first ){
+	      return p1.first > p2.first;
+	    }
+	    return p1.second < p2.second;
+	  } );
+    if ( num > sorted.size() ){
+      num = sorted.size();
+    }
+    vector<set<string>> result( num );
+    vector<size_t> fill( num, 0 );
+    for ( const auto& it : sorted ){
+      size_t best = min_element( fill.begin(), fill.end() ) - fill.begin();
+      result[best].insert( it.second );
+      fill[best] += it.first;
+    }
+    return result;
+  }
+
+  vector<string> split_instances( const string& datafile,
+				  size_t feature,
+				  const vector<set<string>>& shards,
+				  const string& prefix ){
+    vector<string> names;
+    unordered_map<string,size_t> shard_of;
+    vector<unique_ptr<ofstream>> outs;
+    for ( size_t i=0; i < shards.size(); ++i ){
+      for ( const auto& v : shards[i] ){
+	shard_of[v] = i;
+      }
+      names.push_back( prefix + "." + to_string( i ) );
+      outs.emplace_back( new ofstream( names.back() ) );
+      if ( !*outs.back() ){
+	return vector<string>();
+      }
+    }
+    ifstream is( datafile );
+    string line;
+    while ( getline( is, line ) ){
+      vector<string> parts = split_ws( line );
+      if ( parts.empty() ){
+	continue;
+      }
+      if ( feature >= parts.size()-1 ){
+	return vector<string>();
+      }
+      auto it = shard_of.find( parts[feature] );
+      if ( it == shard_of.end() ){
+	return vector<string>();
+      }
+      *outs[it->second] << line << "\n";
+    }
+    return names;
+  }
+
+
+  // the header and hash tables of a hashed Timbl tree file
+  struct tree_tables {
+    vector<string> header;     // the comment lines before the tables
+    map<int,string> classes;   // hashed index -> class name
+    map<int,string> features;  // hashed index -> feature value
+    string table_sep = "\t";
+    bool blank_line = false;   // is there an empty line before the tree?
+  };
+
+  static bool read_tables( istream& is,
+			   const string& name,
+			   tree_tables& tt,
+			   string& error ){
+    // read up to the start of the tree, which is left in 'is'
+    enum { HEADER, CLASSES, FEATURES } state = HEADER;
+    bool hashed = false;
+    string line;
+    while ( is.peek() != '(' && getline( is, line ) ){
+      if ( line == "Classes" ){
+	state = CLASSES;
+	continue;
+      }
+      if ( line == "Features" ){
+	state = FEATURES;
+	continue;
+      }
+      if ( line.empty() ){
+	tt.blank_line = true;
+	continue;
+      }
+      if ( line[0] == '#' ){
+	if ( line.find( "(Hashed)" ) != string::npos ){
+	  hashed = true;
+	}
+	if ( state == HEADER ){
+	  tt.header.push_back( line );
+	}
+	continue;
+      }
+      if ( state == HEADER ){
+	error = name + ": unexpected line: " + line;
+	return false;
+      }
+      size_t pos = line.find_first_of( " \t" );
+      if ( pos == string::npos
+	   || pos == 0
+	   || line.find_first_not_of( "0123456789" ) < pos ){
+	error = name + ": invalid hash entry: " + line;
+	return false;
+      }
+      tt.table_sep = line.substr( pos, 1 );
+      int idx = stoi( line.substr( 0, pos ) );
+      string value = line.substr( pos+1 );
+      if ( state == CLASSES ){
+	tt.classes[idx] = value;
+      }
+      else {
+	tt.features[idx] = value;
+      }
+    }
+    if ( !hashed ){
+      error = name + ": not a hashed tree file";
+      return false;
+    }
+    if ( is.peek() != '(' ){
+      error = name + ": no tree found";
+      return false;
+    }
+    return true;
+  }
+
+  static void write_tables( ostream& os, const tree_tables& tt ){
+    for ( const auto& line : tt.header ){
+      os << line << "\n";
+    }
+    os << "Classes\n";
+    for ( const auto& it : tt.classes ){
+      os << it.first << tt.table_sep << it.second << "\n";
+    }
+    os << "Features\n";
+    for ( const auto& it : tt.features ){
+      os << it.first << tt.table_sep << it.second << "\n";
+    }
+    if ( tt.blank_line ){
+      os << "\n";
+    }
+  }
+
+  // In a hashed tree, all values are numbers: hashed indices and counts.
+  // The punctuation is coded as negative numbers.
+  const int OPEN_NODE = -1;   // (
+  const int CLOSE_NODE = -2;  // )
+  const int OPEN_LIST = -3;   // [
+  const int CLOSE_LIST = -4;  // ]
+  const int OPEN_DIST = -5;   // {
+  const int CLOSE_DIST = -6;  // }
+  const int COMMA = -7;
+  const int END = -8;         // end of the input
+  const int BAD = -9;         // anything else
+
+  class token_reader {
+    // reads a tree one token at a time, so it is never in memory as a
+    // whole
+  public:
+    explicit token_reader( istream& is ):
+      _is( is ), _tok( 0 ), _have( false ), _count( 0 ) {};
+    int peek();
+    int next(){
+      int tok = peek();
+      _have = false;
+      ++_count;
+      return tok;
+    };
+    size_t count() const { return _count; };
+  private:
+    istream& _is;
+    int _tok;
+    bool _have;
+    size_t _count;
+  };
+
+  int token_reader::peek(){
+    if ( _have ){
+      return _tok;
+    }
+    _have = true;
+    int c = _is.get();
+    while ( c != EOF && isspace( c ) ){
+      c = _is.get();
+    }
+    switch ( c ){
+    case EOF: _tok = END; break;
+    case '(': _tok = OPEN_NODE; break;
+    case ')': _tok = CLOSE_NODE; break;
+    case '[': _tok = OPEN_LIST; break;
+    case ']': _tok = CLOSE_LIST; break;
+    case '{': _tok = OPEN_DIST; break;
+    case '}': _tok = CLOSE_DIST; break;
+    case ',': _tok = COMMA; break;
+    default:
+      if ( !isdigit( c ) ){
+	_tok = BAD;
+	break;
+      }
+      long value = c - '0';
+      while ( isdigit( _is.peek() ) && value <= numeric_limits<int>::max() ){
+	value = 10 * value + ( _is.get() - '0' );
+      }
+      _tok = ( value > numeric_limits<int>::max() ) ? BAD : int(value);
+    }
+    return _tok;
+  }
+
+  static void write_token( ostream& os, int tok ){
+    // 'pretty' print: a newline after every closing bracket
+    switch ( tok ){
+    case OPEN_NODE: os << "( "; break;
+    case CLOSE_NODE: os << ")\n"; break;
+    case OPEN_LIST: os << "[ "; break;
+    case CLOSE_LIST: os << "] "; break;
+    case OPEN_DIST: os << "{ "; break;
+    case CLOSE_DIST: os << "} "; break;
+    case COMMA: os << ", "; break;
+    default:
+      os << tok << " ";
+    }
+  }
+
+  // copies the nodes of one shard's tree, with the indices of the merged
+  // hash tables
+  class tree_remapper {
+  public:
+    tree_remapper( istream& is,
+		   const unordered_map<int,int>& classes,
+		   const unordered_map<int,int>& features,
+		   bool comma ):
+      tokens( is ), _classes( classes ), _features( features ),
+      _comma( comma ) {};
+    bool node( vector<int>& out );
+    bool dist( vector<int>& out );
+    bool expect( int );
+    bool number( int& );
+    int class_index( int ) const;
+    int feature_index( int ) const;
+    token_reader tokens;
+    string error;
+  private:
+    bool child_list( vector<pair<int,vector<int>>>& children );
+    const unordered_map<int,int>& _classes;
+    const unordered_map<int,int>& _features;
+    bool _comma;
+  };
+
+  static int add_name( map<string,int>& table, const string& name ){
+    auto it = table.find( name );
+    if ( it != table.end() ){
+      return it->second;
+    }
+    int idx = table.size() + 1;
+    table[name] = idx;
+    return idx;
+  }
+
+  int tree_remapper::class_index( int idx ) const {
+    auto it = _classes.find( idx );
+    if ( it == _classes.end() ){
+      return -1;
+    }
+    return it->second;
+  }
+
+  int tree_remapper::feature_index( int idx ) const {
+    auto it = _features.find( idx );
+    if ( it == _features.end() ){
+      return -1;
+    }
+    return it->second;
+  }
+
+  bool tree_remapper::expect( int tok ){
+    if ( tokens.peek() == tok ){
+      tokens.next();
+      return true;
+    }
+    ostringstream os;
+    write_token( os, tok );
+    error = "expected '" + os.str().substr( 0, 1 ) + "' at token "
+      + to_string( tokens.count() );
+    return false;
+  }
+
+  bool tree_remapper::number( int& result ){
+    if ( tokens.peek() == END ){
+      error = "unexpected end of tree";
+      return false;
+    }
+    if ( tokens.peek() < 0 ){
+      error = "expected a number at token " + to_string( tokens.count() );
+      return false;
+    }
+    result = tokens.next();
+    return true;
+  }
+
+  bool tree_remapper::dist( vector<int>& out ){
+    // '{' class count [,] ... '}'
+    if ( !expect( OPEN_DIST ) ){
+      return false;
+    }
+    out.push_back( OPEN_DIST );
+    while ( tokens.peek() != CLOSE_DIST && tokens.peek() != END ){
+      if ( tokens.peek() == COMMA ){
+	out.push_back( tokens.next() );
+	continue;
+      }
+      int cls;
+      int count;
+      if ( !number( cls ) || !number( count ) ){
+	return false;
+      }
+      int idx = class_index( cls );
+      if ( idx < 0 ){
+	error = "unknown class index " + to_string( cls );
+	return false;
+      }
+      out.push_back( idx );
+      out.push_back( count );
+    }
+    if ( !expect( CLOSE_DIST ) ){
+      return false;
+    }
+    out.push_back( CLOSE_DIST );
+    return true;
+  }
+
+  bool tree_remapper::child_list( vector<pair<int,vector<int>>>& children ){
+    // '[' value node [,] value node ... ']'
+    if ( !expect( OPEN_LIST ) ){
+      return false;
+    }
+    while ( tokens.peek() != CLOSE_LIST && tokens.peek() != END ){
+      if ( tokens.peek() == COMMA ){
+	tokens.next();
+	continue;
+      }
+      int value;
+      if ( !number( value ) ){
+	return false;
+      }
+      int idx = feature_index( value );
+      if ( idx < 0 ){
+	error = "unknown feature index " + to_string( value );
+	return false;
+      }
+      vector<int> sub;
+      sub.push_back( idx );
+      if ( !node( sub ) ){
+	return false;
+      }
+      children.push_back( make_pair( idx, sub ) );
+    }
+    return expect( CLOSE_LIST );
+  }
+
+  static void add_children( vector<int>& out,
+			    vector<pair<int,vector<int>>>& children,
+			    bool comma ){
+    // keep the children sorted on their (new) index
+    stable_sort( children.begin(), children.end(),
+		 []( const pair<int,vector<int>>& p1,
+		     const pair<int,vector<int>>& p2 ){
+		   return p1.first < p2.first;
+		 } );
+    out.push_back( OPEN_LIST );
+    bool first = true;
+    for ( const auto& child : children ){
+      if ( !first && comma ){
+	out.push_back( COMMA );
+      }
+      first = false;
+      out.insert( out.end(), child.second.begin(), child.second.end() );
+    }
+    out.push_back( CLOSE_LIST );
+  }
+
+  bool tree_remapper::node( vector<int>& out ){
+    // '(' class [dist] [children] ')'
+    if ( !expect( OPEN_NODE ) ){
+      return false;
+    }
+    out.push_back( OPEN_NODE );
+    int cls;
+    if ( !number( cls ) ){
+      return false;
+    }
+    int idx = class_index( cls );
+    if ( idx < 0 ){
+      error = "unknown class index " + to_string( cls );
+      return false;
+    }
+    out.push_back( idx );
+    if ( tokens.peek() == OPEN_DIST ){
+      if ( !dist( out ) ){
+	return false;
+      }
+    }
+    if ( tokens.peek() == OPEN_LIST ){
+      vector<pair<int,vector<int>>> children;
+      if ( !child_list( children ) ){
+	return false;
+      }
+      add_children( out, children, _comma );
+    }
+    if ( !expect( CLOSE_NODE ) ){
+      return false;
+    }
+    out.push_back( CLOSE_NODE );
+    return true;
+  }
+
+  static bool open_tree( const string& name,
+			 ifstream& is,
+			 tree_tables& tt,
+			 string& error ){
+    is.open( name );
+    if ( !is ){
+      error = "unable to open " + name;
+      return false;
+    }
+    return read_tables( is, name, tt, error );
+  }
+
+  bool merge_igtrees( const vector<string>& trees,
+		      const vector<set<string>>& shard_values,
+		      const data_stats& stats,
+		      const string& outfile,
+		      string& error ){
+    // The merged tree is written while reading the shard trees one by
+    // one, and only one top branch of a shard is in memory at a time:
+    // the children of a node must be sorted on their new index.
+    // Timbl sorts the children on their hashed index. So when the top
+    // feature values of a shard get consecutive new indices, in the order
+    // of the shard's own index, the top branches of the shards can be
+    // copied one after the other.
+    if ( trees.empty() || trees.size() != shard_values.size() ){
+      error = "no trees to merge";
+      return false;
+    }
+    map<string,int> classes;
+    map<string,int> features;
+    tree_tables first;
+    bool comma = false;
+    bool has_dist = false;
+    vector<vector<int>> top_values( trees.size() );
+    for ( size_t i=0; i < trees.size(); ++i ){
+      ifstream is;
+      tree_tables tt;
+      if ( !open_tree( trees[i], is, tt, error ) ){
+	return false;
+      }
+      unordered_map<string,int> local;
+      for ( const auto& it : tt.features ){
+	local[it.second] = it.first;
+      }
+      // values that IGTree pruned completely aren't in the table, they go
+      // last
+      vector<pair<int,string>> ordered;
+      for ( const auto& value : shard_values[i] ){
+	auto it = local.find( value );
+	ordered.push_back( make_pair( it == local.end()
+				      ? numeric_limits<int>::max()
+				      : it->second,
+				      value ) );
+      }
+      sort( ordered.begin(), ordered.end() );
+      for ( const auto& it : ordered ){
+	top_values[i].push_back( add_name( features, it.second ) );
+      }
+      for ( const auto& it : tt.classes ){
+	add_name( classes, it.second );
+      }
+      if ( i == 0 ){
+	first = tt;
+	token_reader tokens( is );
+	has_dist = tokens.next() == OPEN_NODE
+	  && tokens.next() >= 0
+	  && tokens.peek() == OPEN_DIST;
+	is.ignore( numeric_limits<streamsize>::max(), ',' );
+	comma = !is.eof();
+      }
+    }
+    // the other values, in a second pass
+    for ( size_t i=0; i < trees.size(); ++i ){
+      ifstream is;
+      tree_tables tt;
+      if ( !open_tree( trees[i], is, tt, error ) ){
+	return false;
+      }
+      for ( const auto& it : tt.features ){
+	add_name( features, it.second );
+      }
+    }
+    // the default of the merged tree is the most frequent class overall
+    string default_class;
+    size_t max_freq = 0;
+    for ( const auto& it : stats.class_freqs ){
+      if ( it.second > max_freq ){
+	max_freq = it.second;
+	default_class = it.first;
+      }
+    }
+    vector<int> root;
+    root.push_back( OPEN_NODE );
+    root.push_back( add_name( classes, default_class ) );
+    if ( has_dist ){
+      root.push_back( OPEN_DIST );
+      bool f = true;
+      for ( const auto& it : stats.class_freqs ){
+	if ( !f && comma ){
+	  root.push_back( COMMA );
+	}
+	f = false;
+	root.push_back( add_name( classes, it.first ) );
+	root.push_back( it.second );
+      }
+      root.push_back( CLOSE_DIST );
+    }
+    root.push_back( OPEN_LIST );
+    ofstream os( outfile );
+    if ( !os ){
+      error = "unable to create " + outfile;
+      return false;
+    }
+    tree_tables merged = first;
+    merged.classes.clear();
+    merged.features.clear();
+    for ( const auto& it : classes ){
+      merged.classes[it.second] = it.first;
+    }
+    for ( const auto& it : features ){
+      merged.features[it.second] = it.first;
+    }
+    write_tables( os, merged );
+    merged = tree_tables();
+    for ( const auto& tok : root ){
+      write_token( os, tok );
+    }
+    bool first_child = true;
+    for ( size_t i=0; i < trees.size(); ++i ){
+      ifstream is;
+      tree_tables tt;
+      if ( !open_tree( trees[i], is, tt, error ) ){
+	return false;
+      }
+      unordered_map<int,int> class_map;
+      for ( const auto& it : tt.classes ){
+	class_map[it.first] = classes[it.second];
+      }
+      unordered_map<int,int> feature_map;
+      for ( const auto& it : tt.features ){
+	feature_map[it.first] = features[it.second];
+      }
+      tt = tree_tables();
+      tree_remapper mapper( is, class_map, feature_map, comma );
+      int c;
+      if ( !mapper.expect( OPEN_NODE ) || !mapper.number( c ) ){
+	error = trees[i] + ": " + mapper.error;
+	return false;
+      }
+      int shard_cls = mapper.class_index( c );
+      if ( shard_cls < 0 ){
+	error = trees[i] + ": unknown class index " + to_string( c );
+	return false;
+      }
+      if ( mapper.tokens.peek() == OPEN_DIST ){
+	// the merged tree has its own
+	vector<int> dummy;
+	if ( !mapper.dist( dummy ) ){
+	  error = trees[i] + ": " + mapper.error;
+	  return false;
+	}
+      }
+      // IGTree prunes branches that have the same class as their parent.
+      // Our parent was the shard's root, but in the merged tree it is the
+      // overall root, so add those branches again, explicitly.
+      const vector<int>& tops = top_values[i];
+      size_t next_top = 0;
+      auto add_pruned = [&]( int limit ){
+	while ( next_top < tops.size() && tops[next_top] < limit ){
+	  if ( !first_child && comma ){
+	    write_token( os, COMMA );
+	  }
+	  first_child = false;
+	  write_token( os, tops[next_top++] );
+	  write_token( os, OPEN_NODE );
+	  write_token( os, shard_cls );
+	  write_token( os, CLOSE_NODE );
+	}
+      };
+      if ( mapper.tokens.peek() == OPEN_LIST ){
+	mapper.tokens.next();
+	while ( mapper.tokens.peek() != CLOSE_LIST
+		&& mapper.tokens.peek() != END ){
+	  if ( mapper.tokens.peek() == COMMA ){
+	    mapper.tokens.next();
+	    continue;
+	  }
+	  int value;
+	  if ( !mapper.number( value ) ){
+	    error = trees[i] + ": " + mapper.error;
+	    return false;
+	  }
+	  int idx = mapper.feature_index( value );
+	  if ( idx < 0 ){
+	    error = trees[i] + ": unknown feature index " + to_string( value );
+	    return false;
+	  }
+	  vector<int> branch;
+	  if ( !mapper.node( branch ) ){
+	    error = trees[i] + ": " + mapper.error;
+	    return false;
+	  }
+	  add_pruned( idx );
+	  if ( next_top == tops.size() || tops[next_top] != idx ){
+	    error = trees[i] + ": unexpected top branch for feature index "
+	      + to_string( value );
+	    return false;
+	  }
+	  ++next_top;
+	  if ( !first_child && comma ){
+	    write_token( os, COMMA );
+	  }
+	  first_child = false;
+	  write_token( os, idx );
+	  for ( const auto& tok : branch ){
+	    write_token( os, tok );
+	  }
+	}
+	if ( !mapper.expect( CLOSE_LIST ) ){
+	  error = trees[i] + ": " + mapper.error;
+	  return false;
+	}
+      }
+      if ( !mapper.expect( CLOSE_NODE ) ){
+	error = trees[i] + ": " + mapper.error;
+	return false;
+      }
+      add_pruned( numeric_limits<int>::max() );
+    }
+    write_token( os, CLOSE_LIST );
+    write_token( os, CLOSE_NODE );
+    return os.good();
+  }
+
+  static bool copy_node( token_reader& tokens, ostream *os ){
+    // copy one node, with all its children, to 'os'. Or just skip it
+    // when 'os' is 0
+    int depth = 0;
+    do {
+      int tok = tokens.next();
+      if ( tok == END || tok == BAD ){
+	return false;
+      }
+      if ( os ){
+	write_token( *os, tok );
+      }
+      if ( tok == OPEN_NODE ){
+	++depth;
+      }
+      else if ( tok == CLOSE_NODE ){
+	--depth;
+      }
+    } while ( depth > 0 );
+    return true;
+  }
+
+  bool extract_shard( const string& merged,
+		      const set<string>& values,
+		      const string& outfile,
+		      string& error ){
+    ifstream is;
+    tree_tables tt;
+    if ( !open_tree( merged, is, tt, error ) ){
+      return false;
+    }
+    set<int> wanted;
+    for ( const auto& it : tt.features ){
+      if ( values.find( it.second ) != values.end() ){
+	wanted.insert( it.first );
+      }
+    }
+    ofstream os( outfile );
+    if ( !os ){
+      error = "unable to create " + outfile;
+      return false;
+    }
+    write_tables( os, tt );
+    tt = tree_tables();
+    token_reader tokens( is );
+    // the root as it is, and only the wanted top branches
+    if ( tokens.peek() != OPEN_NODE ){
+      error = merged + ": no tree found";
+      return false;
+    }
+    write_token( os, tokens.next() );
+    if ( tokens.peek() < 0 ){
+      error = merged + ": expected a class at token "
+	+ to_string( tokens.count() );
+      return false;
+    }
+    write_token( os, tokens.next() );
+    if ( tokens.peek() == OPEN_DIST ){
+      int tok;
+      do {
+	tok = tokens.next();
+	if ( tok == END || tok == BAD ){
+	  error = merged + ": invalid distribution at the root";
+	  return false;
+	}
+	write_token( os, tok );
+      } while ( tok != CLOSE_DIST );
+    }
+    if ( tokens.peek() == OPEN_LIST ){
+      write_token( os, tokens.next() );
+      bool comma = false;
+      bool first = true;
+      while ( tokens.peek() != CLOSE_LIST ){
+	int value = tokens.next();
+	if ( value == COMMA ){
+	  comma = true;
+	  continue;
+	}
+	if ( value < 0 ){
+	  error = merged + ": expected a feature value at token "
+	    + to_string( tokens.count() );
+	  return false;
+	}
+	bool copy = wanted.find( value ) != wanted.end();
+	if ( copy ){
+	  if ( !first && comma ){
+	    write_token( os, COMMA );
+	  }
+	  first = false;
+	  write_token( os, value );
+	}
+	if ( !copy_node( tokens, copy ? &os : 0 ) ){
+	  error = merged + ": invalid node at token "
+	    + to_string( tokens.count() );
+	  return false;
+	}
+      }
+      write_token( os, tokens.next() );
+    }
+    if ( tokens.next() != CLOSE_NODE ){
+      error = merged + ": expected ')' at token "
+	+ to_string( tokens.count() );
+      return false;
+    }
+    write_token( os, CLOSE_NODE );
+    return os.good();
+  }
+
+}
@@ -0,0 +1,136 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include "ticcutils/CommandLine.h"
+#include "ticcutils/StringOps.h"
+#include "toad/frozen_lexicon.h"
+#include "config.h"
+
+using namespace std;
+
+void usage( const string& name ){
+  cerr << "usage: " << name << " -o <outfile> [--lower <file>]... "
+       << "[--mbma <file>]... [--mblem <file>]... [file]..." << endl;
+  cerr << "compile word lists into a binary lexicon for checkmbma and "
+       << "checkmblem." << endl;
+  cerr << "The first field of every line is used, duplicates are removed."
+       << endl;
+  cerr << "\t -o <outfile> the lexicon to create" << endl;
+  cerr << "\t --lower <file> lowercase the words from 'file'" << endl;
+  cerr << "\t --mbma <file> the lowercased words from an MBMA lexicon, "
+       << "skipping the same" << endl
+       << "\t\t lines as checkmbma does" << endl;
+  cerr << "\t --mblem <file> the lowercased words from a lemma lexicon, "
+       << "skipping the same" << endl
+       << "\t\t lines as checkmblem does" << endl;
+  cerr << "\t -V or --version show version info" << endl;
+  cerr << "\t -h or --help this message" << endl;
+  cerr << "examples:" << endl;
+  cerr << "\t " << name << " -o lemmas.lexbin --mbma mbma-merged.lex "
+       << "sonar.lemmas known.lemmas" << endl;
+  cerr << "\t " << name << " -o morphs.lexbin known.morphs" << endl;
+  cerr << "\t " << name << " -o mblem.lexbin --mblem mblem.lex "
+       << "sonar.lemmas known.lemmas" << endl;
+}
+
+enum input_kind { PLAIN, LOWER, MBMA, MBLEM };
+
+int main( int argc, char * const argv[] ){
+  TiCC::CL_Options opts( "o:hV", "lower:,mbma:,mblem:,help,version" );
+  try {
+    opts.parse_args( argc, argv );
+  }
+  catch ( TiCC::OptionError& e ){
+    cerr << e.what() << endl;
+    usage( opts.prog_name() );
+    return EXIT_FAILURE;
+  }
+  if ( opts.extract( 'h' ) || opts.extract( "help" ) ){
+    usage( opts.prog_name() );
+    return EXIT_SUCCESS;
+  }
+  if ( opts.extract( 'V' ) || opts.extract( "version" ) ){
+    cerr << opts.prog_name() << " " << VERSION << endl;
+    return EXIT_SUCCESS;
+  }
+  string outname;
+  if ( !opts.extract( 'o', outname ) ){
+    cerr << "missing -o option" << endl;
+    usage( opts.prog_name() );
+    return EXIT_FAILURE;
+  }
+  vector<pair<string,input_kind>> inputs;
+  string file;
+  while ( opts.extract( "lower", file ) ){
+    inputs.push_back( make_pair( file, LOWER ) );
+  }
+  while ( opts.extract( "mbma", file ) ){
+    inputs.push_back( make_pair( file, MBMA ) );
+  }
+  while ( opts.extract( "mblem", file ) ){
+    inputs.push_back( make_pair( file, MBLEM ) );
+  }
+  for ( const auto& f : opts.getMassOpts() ){
+    inputs.push_back( make_pair( f, PLAIN ) );
+  }
+  if ( inputs.empty() ){
+    cerr << "no input files" << endl;
+    usage( opts.prog_name() );
+    return EXIT_FAILURE;
+  }
+  Toad::LexiconBuilder builder;
+  for ( const auto& input : inputs ){
+    long count;
+    switch ( input.second ){
+    case MBMA:
+      count = Toad::add_mbma_words( builder, input.first, &cerr );
+      break;
+    case MBLEM:
+      count = Toad::add_mblem_words( builder, input.first, &cerr );
+      break;
+    default:
+      count = Toad::add_first_fields( builder, input.first,
+				      input.second == LOWER );
+    }
+    if ( count < 0 ){
+      cerr << "could not open input file '" << input.first << "'" << endl;
+      return EXIT_FAILURE;
+    }
+    cout << "added " << count << " words from " << input.first
+	 << ", size is now: " << builder.size() << " words" << endl;
+  }
+  string error;
+  if ( !builder.write( outname, error ) ){
+    cerr << error << endl;
+    return EXIT_FAILURE;
+  }
+  cout << "wrote a lexicon of " << builder.size() << " words to "
+       << outname << endl;
+  return EXIT_SUCCESS;
+}
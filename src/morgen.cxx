@@ -27,10 +27,15 @@
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <vector>
 #include <map>
 #include <set>
 #include <string>
+#include <algorithm>
+#include <cstdint>
+#include <chrono>
+#include <cstdio>
 #include "ticcutils/StringOps.h"
 #include "ticcutils/CommandLine.h"
 #include "ticcutils/FileUtils.h"
@@ -42,17 +47,30 @@
 #include "unicode/ustream.h"
 #include "unicode/unistr.h"
 #include "frog/mbma_mod.h"
+#include "toad/string_pool.h"
+#include "toad/tree_report.h"
+#include "toad/owned_list.h"
+#include "toad/compressed_input.h"
+#include "toad/temp_store.h"
 #include "config.h"
 
 using namespace std;
 using namespace	icu;
+using Toad::string_id;
 
-const int LEFT = 6;
-const int RIGHT = 6;
+// the instance window: letters to the left and right of the focus letter,
+// and the feature value for positions outside the word.
+// configured with windowLeft, windowRight and windowPadding in [[mbma]]
+struct window_spec {
+  int left = 6;
+  int right = 6;
+  UnicodeString padding = "_";
+};
 
 int debug = 0;
 bool have_config = false;
 string temp_dir = "/tmp/froggen";
+static Toad::TempStore temp_store; // the datafiles in temp_dir
 string base_name = "morgen";
 string cgn_dir = string(SYSCONF_PATH) + "/frog/nld/";
 string encoding = "UTF-8";
@@ -62,6 +80,66 @@ static Mbma myMbma(new TiCC::LogStream(cerr));
 static TiCC::Configuration default_config;
 static TiCC::Configuration use_config;
 
+static Toad::StringPool morpheme_pool; // all morpheme class labels
+
+struct pool_less {
+  // sort pooled strings as the UnicodeStrings they represent
+  bool operator()( string_id a, string_id b ) const {
+    return morpheme_pool.compare( a, b ) < 0;
+  }
+};
+
+// the morpheme classes seen for every letter of the current word.
+// one bitset over the pooled class ids per letter, in one flat buffer.
+// reset() only clears the letters of the new word.
+class morpheme_slots {
+public:
+  morpheme_slots(): _len(0), _stride(1) {};
+  void reset( size_t len ){
+    _len = len;
+    if ( _bits.size() < _len * _stride ){
+      _bits.resize( _len * _stride );
+    }
+    fill( _bits.begin(), _bits.begin() + _len * _stride, 0 );
+  }
+  void add( size_t pos, string_id id ){
+    size_t word = id / 64;
+    if ( word >= _stride ){
+      grow( word + 1 );
+    }
+    _bits[pos * _stride + word] |= uint64_t(1) << ( id % 64 );
+  }
+  void get( size_t pos, vector<string_id>& ids ) const {
+    // the classes at 'pos', in the order of their strings
+    ids.clear();
+    for ( size_t w=0; w < _stride; ++w ){
+      uint64_t bits = _bits[pos * _stride + w];
+      while ( bits ){
+	int b = __builtin_ctzll( bits );
+	ids.push_back( w * 64 + b );
+	bits &= bits - 1;
+      }
+    }
+    sort( ids.begin(), ids.end(), pool_less() );
+  }
+private:
+  void grow( size_t stride ){
+    // a new class id doesn't fit: widen all bitsets. This only happens
+    // when the number of classes passes a multiple of 64
+    vector<uint64_t> bits( max( _len, size_t(1) ) * stride, 0 );
+    for ( size_t pos=0; pos < _len; ++pos ){
+      copy( _bits.begin() + pos * _stride,
+	    _bits.begin() + (pos+1) * _stride,
+	    bits.begin() + pos * stride );
+    }
+    _bits.swap( bits );
+    _stride = stride;
+  }
+  size_t _len;
+  size_t _stride; // uint64_t's per letter
+  vector<uint64_t> _bits;
+};
+
 void set_default_config(){
   default_config.setatt( "baseName", base_name, "mbma" );
   default_config.setatt( "cgn_clex_main", "cgntags.main", "mbma" );
@@ -70,6 +148,31 @@ void set_default_config(){
   default_config.setatt( "set", "http://ilk.uvt.nl/folia/sets/frog-mbma-nl", "mbma" );
   default_config.setatt( "clex_set", "http://ilk.uvt.nl/folia/sets/frog-mbpos-clex", "mbma" );
   default_config.setatt( "cgnDir", cgn_dir, "mbma" );
+  default_config.setatt( "windowLeft", "6", "mbma" );
+  default_config.setatt( "windowRight", "6", "mbma" );
+  default_config.setatt( "windowPadding", "_", "mbma" );
+}
+
+bool get_window( const TiCC::Configuration& config, window_spec& window ){
+  string value = config.lookUp( "windowLeft", "mbma" );
+  if ( !TiCC::stringTo( value, window.left ) || window.left < 0 ){
+    cerr << "invalid value for windowLeft: '" << value << "'" << endl;
+    return false;
+  }
+  value = config.lookUp( "windowRight", "mbma" );
+  if ( !TiCC::stringTo( value, window.right ) || window.right < 0 ){
+    cerr << "invalid value for windowRight: '" << value << "'" << endl;
+    return false;
+  }
+  window.padding = TiCC::UnicodeFromUTF8( config.lookUp( "windowPadding",
+							  "mbma" ) );
+  if ( window.padding.isEmpty()
+       || window.padding.indexOf( (UChar)',' ) >= 0 ){
+    cerr << "invalid value for windowPadding: '" << window.padding
+	 << "'" << endl;
+    return false;
+  }
+  return true;
 }
 
 void usage( const string& name ){
@@ -80,12 +183,29 @@ void usage( const string& name ){
        << " (Higly recommended)" << endl;
   cerr << "  --temp-dir 'dirname' \t The directory to store teporary files. "
        << "(default: " << temp_dir << " )" << endl;
+  cerr << "  --temp-memory 'MB' \t Keep the temporary datafiles in memory, "
+       << "as long as" << endl
+       << "\t\t\t together they fit in MB." << endl;
+  cerr << "  --keep-temp \t\t Don't remove the temporary files when done."
+       << endl;
   cerr << "  --cgn 'cgndir' \t The location of the (required) CGN datafiles."
        << " (default=" << cgn_dir << ")" << endl;
   cerr << "  -b 'basename' \t Set a basename for the outputfiles (default="
        << base_name << ")" << endl;
   cerr << "  -e 'encoding' \t Normally we handle UTF-8, but other encodings are supported." << endl;
   cerr << "\t\t\t The results will ALWAYS be stored in UTF-8 (NFC normalized)" << endl;
+  cerr << "  The instance window is set in the [[mbma]] section of the config:" << endl;
+  cerr << "\t windowLeft=6, windowRight=6 (letters around the focus) and" << endl;
+  cerr << "\t windowPadding=_ (the value outside the word)." << endl;
+  cerr << "\t NOTE: Frog has to use the same window to use the tree." << endl;
+  cerr << "  --evaluate 'windows' Don't create a tree, but train and test every"
+       << endl
+       << "\t\t\t window in the comma separated list on held-out words."
+       << endl
+       << "\t\t\t A window is 'N' (N left and right) or 'L:R'." << endl
+       << "\t\t\t e.g. --evaluate 3,4,5,6,3:5" << endl;
+  cerr << "  --heldout 'percent' \t The percentage of words to test on in "
+       << "--evaluate. (default 10)" << endl;
 }
 
 void copy_cgn_files( const string& output_dir, const string& cgn_path ){
@@ -120,58 +240,125 @@ void copy_cgn_files( const string& output_dir, const string& cgn_path ){
   }
 }
 
+void append_features( UnicodeString& out,
+		      const UnicodeString& word,
+		      int i,
+		      const window_spec& window ){
+  // the features of letter 'i' of 'word', each followed by a ','
+  // left context
+  for ( int j=0; j<window.left; j++){
+    if ((i-(window.left-j))<0)
+      out += window.padding;
+    else
+      out += word[i-(window.left-j)];
+    out += ",";
+  }
+  // focus
+  out += word[i];
+  out += ",";
+  // right context
+  for ( int j=0; j<window.right; j++) {
+    if ( (i+j+1) >= word.length() )
+      out += window.padding;
+    else
+      out += word[i+j+1];
+    out += ",";
+  }
+}
+
+// a word with the (joined) morpheme classes of its letters
+struct word_classes {
+  UnicodeString word;
+  vector<UnicodeString> classes;
+};
+
 void spitOut( ostream& os, const UnicodeString& word,
-	      vector<set<UnicodeString> >& morphemes ){
+	      const morpheme_slots& morphemes,
+	      const window_spec& window,
+	      vector<word_classes> *keep ){
+  vector<string_id> ids;
+  if ( keep ){
+    keep->push_back( word_classes{ word, vector<UnicodeString>() } );
+  }
   for ( int i=0; i < word.length(); ++i ){
     UnicodeString out;
-    // left context
-    for ( int j=0; j<LEFT; j++){
-      if ((i-(LEFT-j))<0)
-	out += "_";
-      else
-	out += word[i-(LEFT-j)];
-      out += ",";
-    }
-    // focus
-    out += word[i];
-    out += ",";
-    // right context
-    for ( int j=0; j<RIGHT; j++) {
-      if ( (i+j+1) >= word.length() )
-	out += "_";
-      else
-	out += word[i+j+1];
-      out += ",";
-    }
+    append_features( out, word, i, window );
+    int32_t class_start = out.length();
     // class
-    auto it = morphemes[i].begin();
-    while ( it != morphemes[i].end() ){
-      out += *it;
-      ++it;
-      if ( it != morphemes[i].end() )
+    morphemes.get( i, ids );
+    for ( size_t k=0; k < ids.size(); ++k ){
+      if ( k > 0 )
 	out += "|";
+      out.append( morpheme_pool.data( ids[k] ),
+		  morpheme_pool.length( ids[k] ) );
+    }
+    if ( keep ){
+      keep->back().classes.push_back( UnicodeString( out, class_start ) );
     }
     os << out << endl;
   }
 }
 
-void create_instance_file( const string& inpname, const string& outname ){
-  ifstream bron( inpname );
+size_t instance_file_estimate( const string& inpname,
+			       const window_spec& window ){
+  // the expected size of the instance file of 'inpname', from a quick
+  // pass over it: every letter of a word gives a line with the letters
+  // in the window around it, and its morphemes as the class.
+  Toad::InputFile bron( inpname );
+  if ( !bron ){
+    return Toad::TempStore::unknown_size;
+  }
+  size_t width = window.left + 1 + window.right;
+  size_t result = 0;
+  string line;
+  while ( getline( bron, line ) ){
+    string::size_type space = line.find_first_of( " \t" );
+    if ( space == string::npos ){
+      continue;
+    }
+    size_t letters = 0;
+    for ( size_t i=0; i < space; ++i ){
+      if ( ( line[i] & 0xC0 ) != 0x80 ){
+	++letters;
+      }
+    }
+    // the features and their commas, the morphemes, and the newlines
+    result += width * ( space + letters ) + ( line.size() - space ) + letters;
+  }
+  return result;
+}
+
+void create_instance_file( const string& inpname,
+			   const string& outname,
+			   const window_spec& window,
+			   vector<word_classes> *keep = 0 ){
+  // when 'keep' is given, the words and their classes are stored in it
+  Toad::InputFile bron( inpname );
   if ( !bron ){
-    cerr << "could not open input file '" << inpname << "'" << endl;
+    cerr << "could not open input file: " << bron.error() << endl;
     exit(EXIT_FAILURE);
   }
 
+  string error;
+  size_t estimate = Toad::TempStore::unknown_size;
+  if ( temp_store.budget() > 0 ){
+    estimate = instance_file_estimate( inpname, window );
+  }
+  if ( !temp_store.create( outname, error, estimate ) ){
+    cerr << error << endl;
+    exit(EXIT_FAILURE);
+  }
   ofstream os( outname );
   if ( !os ){
     cerr << "could not open output file '" << outname << "'" << endl;
     exit(EXIT_FAILURE);
   }
   cerr << "start converting inputfile: " << inpname << endl;
-  vector<set<UnicodeString> > morphemes;
-  morphemes.resize(250);
+  morpheme_slots morphemes;
   UnicodeString prevword;
   UnicodeString line;
+  // the rules of the current line. freed when the next line is done
+  Toad::OwnedList<Rule> rules;
   while ( TiCC::getline( bron, line, encoding ) ){
     if ( line.isEmpty() ){
 	continue;
@@ -189,26 +376,33 @@ void create_instance_file( const string& inpname, const string& outname ){
       exit(1);
     }
     parts.erase(parts.begin());
-    vector<Rule *> r = myMbma.execute( word, "", parts );
-    if ( r.empty() ){
+    rules.reset( myMbma.execute( word, "", parts ) );
+    if ( rules.empty() ){
       cerr << "problems with entry: '" << line << "'" << endl;
       continue;
     }
     if ( word != prevword ){
       if ( !prevword.isEmpty() ){
-	spitOut( os, prevword, morphemes );
+	spitOut( os, prevword, morphemes, window, keep );
       }
       prevword = word;
-      for ( size_t i=0; i < morphemes.size(); ++i ){
-	morphemes[i].clear();
-      }
+      morphemes.reset( word.length() );
     }
     for ( size_t i=0; i < parts.size(); ++i ){
-      morphemes[i].insert(parts[i]);
+      morphemes.add( i, morpheme_pool.intern( parts[i] ) );
     }
   }
+  if ( !bron.error().empty() ){
+    cerr << bron.error() << endl;
+    exit(EXIT_FAILURE);
+  }
   if ( !prevword.isEmpty() ){
-    spitOut( os, prevword, morphemes );
+    spitOut( os, prevword, morphemes, window, keep );
+  }
+  os.close();
+  if ( !temp_store.done( outname, error ) ){
+    cerr << error << endl;
+    exit(EXIT_FAILURE);
   }
   cerr << "created morphological datafile: " << outname << endl;
 }
@@ -218,14 +412,157 @@ void create_instance_base( const string& dataname, const string& treename ){
   cout << "Timbl: Start training " << dataname << " with Options: "
        << timblopts << endl;
 
-  Timbl::TimblAPI timbl( timblopts );
-  timbl.Learn( dataname );
-  timbl.WriteInstanceBase( treename );
+  {
+    Timbl::TimblAPI timbl( timblopts );
+    timbl.Learn( dataname );
+    timbl.WriteInstanceBase( treename );
+  }
   cout << "Timbl: Done, stored instancebase : " << treename << endl;
+  // post training analysis, stored next to the tree, for deployment sizing
+  Toad::report_tree( timblopts, treename, dataname );
+}
+
+bool parse_windows( const string& spec,
+		    const window_spec& base,
+		    vector<window_spec>& windows ){
+  // "3,4:2" --> 3 left and right, 4 left and 2 right
+  for ( const auto& part : TiCC::split_at( spec, "," ) ){
+    window_spec window = base;
+    vector<string> lr = TiCC::split_at( part, ":" );
+    if ( lr.size() == 1 ){
+      if ( !TiCC::stringTo( lr[0], window.left ) || window.left < 0 ){
+	return false;
+      }
+      window.right = window.left;
+    }
+    else if ( lr.size() != 2
+	      || !TiCC::stringTo( lr[0], window.left )
+	      || !TiCC::stringTo( lr[1], window.right )
+	      || window.left < 0
+	      || window.right < 0 ){
+      return false;
+    }
+    windows.push_back( window );
+  }
+  return !windows.empty();
+}
+
+void evaluate_windows( const vector<word_classes>& words,
+		       const vector<window_spec>& windows,
+		       int heldout ){
+  // train a tree for every window on most of the words, and test it on
+  // the held-out words: every n-th word, for the given percentage.
+  string timblopts = use_config.lookUp( "timblOpts", "mbma" );
+  size_t step = max( 1, 100 / heldout );
+  size_t test_words = 0;
+  size_t test_instances = 0;
+  for ( size_t w=0; w < words.size(); w += step ){
+    ++test_words;
+    test_instances += words[w].word.length();
+  }
+  cout << "evaluating " << windows.size() << " window(s) on "
+       << test_words << " held-out words (" << test_instances
+       << " instances), training on " << words.size() - test_words
+       << " words, with Timbl options: " << timblopts << endl;
+  vector<string> lines;
+  for ( const auto& window : windows ){
+    string name = temp_dir + base_name + ".eval."
+      + TiCC::toString( window.left ) + "-" + TiCC::toString( window.right );
+    string train_name = name + ".train";
+    string tree_name = name + ".tree";
+    // the features and their commas, the classes and the newlines
+    size_t width = window.left + 1 + window.right;
+    size_t estimate = 0;
+    for ( size_t w=0; w < words.size(); ++w ){
+      if ( w % step == 0 ){
+	continue;
+      }
+      const word_classes& wc = words[w];
+      size_t letters = wc.word.length();
+      estimate += width * ( TiCC::UnicodeToUTF8( wc.word ).size() + letters )
+	+ letters;
+      for ( const auto& cls : wc.classes ){
+	estimate += TiCC::UnicodeToUTF8( cls ).size();
+      }
+    }
+    string error;
+    if ( !temp_store.create( train_name, error, estimate ) ){
+      cerr << error << endl;
+      exit(EXIT_FAILURE);
+    }
+    ofstream os( train_name );
+    if ( !os ){
+      cerr << "could not open output file '" << train_name << "'" << endl;
+      exit(EXIT_FAILURE);
+    }
+    for ( size_t w=0; w < words.size(); ++w ){
+      if ( w % step == 0 ){
+	continue;
+      }
+      const word_classes& wc = words[w];
+      for ( int i=0; i < wc.word.length(); ++i ){
+	UnicodeString out;
+	append_features( out, wc.word, i, window );
+	out += wc.classes[i];
+	os << out << endl;
+      }
+    }
+    os.close();
+    if ( !temp_store.done( train_name, error ) ){
+      cerr << error << endl;
+      exit(EXIT_FAILURE);
+    }
+    Timbl::TimblAPI timbl( timblopts );
+    timbl.Learn( train_name );
+    timbl.WriteInstanceBase( tree_name );
+    size_t correct = 0;
+    size_t correct_words = 0;
+    auto start = chrono::steady_clock::now();
+    for ( size_t w=0; w < words.size(); w += step ){
+      const word_classes& wc = words[w];
+      bool word_ok = true;
+      for ( int i=0; i < wc.word.length(); ++i ){
+	UnicodeString inst;
+	append_features( inst, wc.word, i, window );
+	inst += wc.classes[i];
+	string answer;
+	if ( timbl.Classify( TiCC::UnicodeToUTF8( inst ), answer )
+	     && TiCC::UnicodeFromUTF8( answer ) == wc.classes[i] ){
+	  ++correct;
+	}
+	else {
+	  word_ok = false;
+	}
+      }
+      if ( word_ok ){
+	++correct_words;
+      }
+    }
+    chrono::duration<double> secs = chrono::steady_clock::now() - start;
+    size_t tree_size = Toad::file_size( tree_name );
+    temp_store.remove( train_name );
+    remove( tree_name.c_str() );
+    ostringstream line;
+    line << window.left << ":" << window.right << "\t"
+	 << ( window.left + window.right + 1 ) << "\t"
+	 << 100.0 * correct / max( test_instances, size_t(1) ) << "\t"
+	 << 100.0 * correct_words / max( test_words, size_t(1) ) << "\t"
+	 << tree_size << "\t"
+	 << size_t( test_instances / max( secs.count(), 1e-9 ) );
+    cout << "window " << line.str() << endl;
+    lines.push_back( line.str() );
+  }
+  cout << endl << "window\tfeatures\tinstance%\tword%\ttree bytes"
+       << "\tclassifications/sec" << endl;
+  for ( const auto& line : lines ){
+    cout << line << endl;
+  }
 }
 
 int main(int argc, char * const argv[] ) {
-  TiCC::CL_Options opts("b:O:c:hV","version,help,cgn:,temp-dir,encoding:");
+  TiCC::CL_Options opts("b:O:c:hV",
+			"version,help,cgn:,temp-dir:,encoding:,evaluate:,"
+			"heldout:,temp-memory:,keep-temp");
   try {
     opts.parse_args( argc, argv );
   }
@@ -278,6 +615,22 @@ int main(int argc, char * const argv[] ) {
       return EXIT_FAILURE;
     }
   }
+  string value;
+  if ( opts.extract( "temp-memory", value ) ){
+    size_t mb = 0;
+    if ( !TiCC::stringTo( value, mb ) ){
+      cerr << "invalid value for --temp-memory: '" << value << "'" << endl;
+      exit(EXIT_FAILURE);
+    }
+    if ( mb > 0 && !Toad::TempStore::memory_supported() ){
+      cerr << "--temp-memory is not supported on this system. "
+	   << "Using the temp-dir" << endl;
+    }
+    else {
+      temp_store.set_budget( mb * 1024 * 1024 );
+    }
+  }
+  temp_store.keep( opts.extract( "keep-temp" ) );
   opts.extract( 'e', encoding );
   vector<string> names = opts.getMassOpts();
   if ( names.size() == 0 ){
@@ -316,10 +669,35 @@ int main(int argc, char * const argv[] ) {
     exit(EXIT_FAILURE);
   }
 
+  window_spec window;
+  if ( !get_window( use_config, window ) ){
+    exit(EXIT_FAILURE);
+  }
+  string eval_spec;
+  if ( opts.extract( "evaluate", eval_spec ) ){
+    vector<window_spec> windows;
+    if ( !parse_windows( eval_spec, window, windows ) ){
+      cerr << "invalid value for --evaluate: '" << eval_spec << "'" << endl;
+      exit(EXIT_FAILURE);
+    }
+    int heldout = 10;
+    if ( opts.extract( "heldout", value ) ){
+      if ( !TiCC::stringTo( value, heldout )
+	   || heldout < 1 || heldout > 50 ){
+	cerr << "invalid value for --heldout: '" << value
+	     << "' (must be 1-50)" << endl;
+	exit(EXIT_FAILURE);
+      }
+    }
+    vector<word_classes> words;
+    create_instance_file( inpname, data_out_name, window, &words );
+    evaluate_windows( words, windows, heldout );
+    return EXIT_SUCCESS;
+  }
   copy_cgn_files( outputdir, cgn_dir );
   frog_config.setatt( "treeFile", treename, "mbma" );
   string full_treename = outputdir + treename;
-  create_instance_file( inpname, data_out_name );
+  create_instance_file( inpname, data_out_name, window );
   create_instance_base( data_out_name, full_treename );
 
   frog_config.clearatt( "baseName", "mbma" );
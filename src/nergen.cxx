@@ -41,6 +41,10 @@
 #include "unicode/ustream.h"
 #include "unicode/unistr.h"
 #include "frog/ner_tagger_mod.h"
+#include "toad/enrichment.h"
+#include "toad/compressed_input.h"
+#include "toad/temp_store.h"
+#include "toad/folia_reader.h"
 #include "config.h"
 
 using namespace std;
@@ -53,6 +57,7 @@ string EOS_MARK = "\n";
 
 static TiCC::Configuration default_config; // sane defaults
 static TiCC::Configuration use_config;     // the config we gonna use
+static Toad::TempStore temp_store;          // the data extracted from FoLiA
 
 void set_default_config(){
   default_config.setatt( "baseName", "nergen", "NER" );
@@ -99,6 +104,13 @@ void usage( const string& name ){
        << "\t\t so ONLY when there is NO CONFLICT" << endl;
   cerr << "--bootstrap\t override ALL NER tags with those derived from the gazeteers." << endl
        << "\t\t UNCONDITIONALLY. Creates a new trainfile for nergen, and stops then. " << endl;
+  cerr << "--pos-column K use the POS tags in column K of the inputfile,\n"
+       << "\t\t instead of tagging with MBT. The lines then have at least\n"
+       << "\t\t K+1 columns, with the NER tag in the last one." << endl;
+  cerr << "--folia\t The inputfile is a FoLiA document, or a directory of them.\n"
+       << "\t\t The words and entities are extracted from it." << endl;
+  cerr << "--folia-pos With --folia, use the POS tags of the FoLiA words,\n"
+       << "\t\t instead of tagging with MBT." << endl;
   cerr << "--running When using --bootstrap, you can specify this, to signal an input file" << endl
        << "\t\t with 'running text'. A simple file with one sentence per line." << endl
        << "\t\t Otherwise a 2 column tagged file is assumed ." << endl;
@@ -111,152 +123,37 @@ bool fill_gazet( const string& name ){
   return myNer.read_gazets( file, dir );
 }
 
-void spit_out( ostream& os,
-	       const vector<Tagger::TagResult>& tagv,
-	       const vector<UnicodeString>& orig_ner_file_tags,
-	       bool override,
-	       bool bootstrap ){
-  vector<UnicodeString> words;
-  vector<UnicodeString> tags;
-  for( const auto& tr : tagv ){
-    words.push_back( tr.word() );
-    tags.push_back( tr.assigned_tag() );
-  }
-
-  vector<UnicodeString> gazet_tags = myNer.create_ner_list( words );
-  vector<UnicodeString> ner_file_tags = orig_ner_file_tags;
-  if ( override ){
-    vector<tc_pair> orig_ners;
-    for ( const auto& it : orig_ner_file_tags ){
-      orig_ners.push_back( make_pair( it, 1.0 ) );
-    }
-    vector<tc_pair> gazet_ners;
-    for ( const auto& it : gazet_tags ){
-      gazet_ners.push_back( make_pair( it, 1.0 ) );
-    }
-    myNer.merge_override( orig_ners, gazet_ners, bootstrap, tags );
-  }
-  if ( bootstrap ){
-    for ( size_t i=0; i < words.size(); ++i ){
-      UnicodeString line = words[i] + "\t";
-      line += ner_file_tags[i];
-      os << line << endl;
-    }
-  }
-  else {
-    UnicodeString prevP = "_";
-    UnicodeString prevN = "_";
-    for ( size_t i=0; i < words.size(); ++i ){
-      UnicodeString line = words[i] + "\t" + prevP + "\t" + tags[i] + "\t";
-      prevP = tags[i];
-      if ( i < words.size() - 1 ){
-	line += tags[i+1] + "\t";
-      }
-      else {
-	line += "_\t";
-      }
-      line += prevN + "\t" + gazet_tags[i] + "\t";
-      prevN = gazet_tags[i];
-      if ( i < words.size() - 1 ){
-	line += gazet_tags[i+1] + "\t";
-      }
-      else {
-	line += "_\t";
-      }
-      line += ner_file_tags[i];
-      os << line << endl;
-    }
-  }
-  if ( EOS_MARK == "\n" ){
-    // avoid spurious newlines!
-    os << endl;
-  }
-  else {
-    os << EOS_MARK << endl;
-  }
-}
-
-UnicodeString to_tag( const UnicodeString& label ){
-  vector<UnicodeString> parts = TiCC::split_at( label, "+" );
-  if ( parts.size() > 1 ){
-    // undecided
-    return "O";
-  }
-  else {
-    return parts[0];
-  }
-}
-
-void boot_out( ostream& os,
-	       const vector<UnicodeString>& words ){
-  vector<UnicodeString> gazet_tags = myNer.create_ner_list( words );
-  UnicodeString prev_tag;
-  for ( size_t i=0; i < words.size(); ++i ){
-    UnicodeString line = words[i] + "\t";
-    UnicodeString tag = to_tag( gazet_tags[i] );
-    if ( tag != "O" ){
-      if ( tag == prev_tag ) {
-	line += "I-";
-      }
-      else {
-	line += "B-";
-      }
-      prev_tag = tag;
-    }
-    line += tag;
-    os << line << endl;
-  }
-  if ( EOS_MARK == "\n" ){
-    // avoid spurious newlines!
-    os << endl;
-  }
-  else {
-    os << EOS_MARK << endl;
-  }
-}
-
 void create_train_file( MbtAPI *tagger,
 			const string& inpname,
 			const string& outname,
+			size_t pos_column,
 			bool override ){
+  // without a tagger, the POS tags are taken from 'pos_column'
+  // of the input
+  string error;
+  Toad::EnrichmentWriter writer( &myNer, override );
+  if ( !writer.init( error ) ){
+    cerr << error << endl;
+    exit(EXIT_FAILURE);
+  }
   ofstream os( outname );
-  ifstream is( inpname );
-  string line;
-  UnicodeString blob;
-  vector<UnicodeString> ner_file_tags; // store the tags as specified in the input
-  size_t HeartBeat=0;
-  while ( getline( is, line ) ){
-    if ( line == "<utt>" ){
-      EOS_MARK = "<utt>";
-      line.clear();
-    }
-    if ( line.empty() ) {
-      if ( !blob.isEmpty() ){
-	vector<Tagger::TagResult> tagv = tagger->TagLine( blob );
-	spit_out( os, tagv, ner_file_tags, override, false );
-	if ( ++HeartBeat % 8000 == 0 ) {
-	  cout << endl;
-	}
-	if ( HeartBeat % 100 == 0 ) {
-	  cout << ".";
-	  cout.flush();
-	}
-	blob.remove();
-	ner_file_tags.clear();
-      }
-      continue;
-    }
-    vector<UnicodeString> parts = TiCC::split( TiCC::UnicodeFromUTF8( line ) );
-    if ( parts.size() != 2 ){
-      cerr << "DOOD: " << line << endl;
-      exit(EXIT_FAILURE);
-    }
-    blob += parts[0] + "\n";
-    ner_file_tags.push_back( parts[1] );
+  Toad::InputFile is( inpname );
+  if ( !is ){
+    cerr << is.error() << endl;
+    exit(EXIT_FAILURE);
   }
-  if ( !blob.isEmpty() ){
-    vector<Tagger::TagResult> tagv = tagger->TagLine( blob );
-    spit_out( os, tagv, ner_file_tags, override, false );
+  bool utt = false;
+  if ( !Toad::enrich_corpus( is, os, tagger, pos_column, writer,
+			     &cout, utt, error ) ){
+    cerr << error << endl;
+    exit(EXIT_FAILURE);
+  }
+  if ( !is.error().empty() ){
+    cerr << is.error() << endl;
+    exit(EXIT_FAILURE);
+  }
+  if ( utt ){
+    EOS_MARK = "<utt>";
   }
 }
 
@@ -264,53 +161,28 @@ void create_boot_file( const string& inpname,
 		       const string& outname,
 		       bool running=false ){
   ofstream os( outname );
-  ifstream is( inpname );
-  string line;
-  UnicodeString blob;
-  size_t HeartBeat=0;
-  while ( getline( is, line ) ){
-    if ( line == "<utt>" ){
-      EOS_MARK = "<utt>";
-      line.clear();
-    }
-    if ( line.empty() ) {
-      if ( !blob.isEmpty() ){
-	vector<UnicodeString> words = TiCC::split( blob );
-	boot_out( os, words );
-	if ( ++HeartBeat % 8000 == 0 ) {
-	  cout << endl;
-	}
-	if ( HeartBeat % 100 == 0 ) {
-	  cout << ".";
-	  cout.flush();
-	}
-	blob.remove();
-      }
-      continue;
-    }
-    if ( running ){
-      vector<UnicodeString> words = TiCC::split( TiCC::UnicodeFromUTF8(line) );
-      boot_out( os, words );
-    }
-    else {
-      vector<UnicodeString> parts = TiCC::split( TiCC::UnicodeFromUTF8(line) );
-      if ( parts.size() == 2 ){
-	blob += parts[0] + " ";
-      }
-      else {
-	cerr << "DOOD: " << line << endl;
-	exit(EXIT_FAILURE);
-      }
-    }
+  Toad::InputFile is( inpname );
+  if ( !is ){
+    cerr << is.error() << endl;
+    exit(EXIT_FAILURE);
+  }
+  bool utt = false;
+  string error;
+  if ( !Toad::bootstrap_corpus( is, os, myNer, running, &cout, utt, error ) ){
+    cerr << error << endl;
+    exit(EXIT_FAILURE);
+  }
+  if ( !is.error().empty() ){
+    cerr << is.error() << endl;
+    exit(EXIT_FAILURE);
   }
-  if ( !blob.isEmpty() ){
-    vector<UnicodeString> words = TiCC::split( blob );
-    boot_out( os, words );
+  if ( utt ){
+    EOS_MARK = "<utt>";
   }
 }
 
 int main(int argc, char * const argv[] ) {
-  TiCC::CL_Options opts("b:O:c:hVg:X","gazeteer:,help,version,override,bootstrap,running");
+  TiCC::CL_Options opts("b:O:c:hVg:X","gazeteer:,help,version,override,bootstrap,running,pos-column:,folia,folia-pos");
   try {
     opts.parse_args( argc, argv );
   }
@@ -379,6 +251,37 @@ int main(int argc, char * const argv[] ) {
   override = opts.extract( "override" );
   bootstrap = opts.extract( "bootstrap" );
   running = opts.extract( "running" );
+  bool use_folia = opts.extract( "folia" );
+  if ( use_folia && running ){
+    cerr << "option --running not allowed for --folia" << endl;
+    exit(EXIT_FAILURE);
+  }
+  bool folia_pos = opts.extract( "folia-pos" );
+  if ( folia_pos && !use_folia ){
+    cerr << "option --folia-pos only allowed for --folia" << endl;
+    exit(EXIT_FAILURE);
+  }
+  if ( folia_pos && bootstrap ){
+    cerr << "option --folia-pos not allowed for --bootstrap" << endl;
+    exit(EXIT_FAILURE);
+  }
+  size_t pos_column = 0;
+  string value;
+  if ( opts.extract( "pos-column", value ) ){
+    if ( !TiCC::stringTo( value, pos_column ) || pos_column < 2 ){
+      cerr << "invalid value for --pos-column: " << value << endl;
+      exit(EXIT_FAILURE);
+    }
+    if ( bootstrap ){
+      cerr << "option --pos-column not allowed for --bootstrap" << endl;
+      exit(EXIT_FAILURE);
+    }
+    if ( use_folia ){
+      cerr << "option --pos-column not allowed for --folia, "
+	   << "use --folia-pos" << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
   if ( running && !bootstrap ){
     cerr << "option --running only allowed for --bootstrap" << endl;
     exit(EXIT_FAILURE);
@@ -429,6 +332,27 @@ int main(int argc, char * const argv[] ) {
     exit(EXIT_FAILURE);
   }
   string inpname = names[0];
+  if ( use_folia ){
+    // continue with a file of the words, (POS tags) and entities
+    vector<Toad::folia_column> columns = { Toad::folia_column::WORD };
+    if ( folia_pos ){
+      columns.push_back( Toad::folia_column::POS );
+      pos_column = 2;
+    }
+    columns.push_back( Toad::folia_column::ENTITY );
+    inpname = outputdir + base_name + ".folia.data";
+    temp_store.keep( keepX );
+    cout << "extracting entities from FoLiA: " << names[0] << endl;
+    Toad::folia_stats stats;
+    string error;
+    if ( !temp_store.create( inpname, error )
+	 || !Toad::folia_to_file( names[0], columns, "", inpname,
+				  stats, error ) ){
+      cerr << error << endl;
+      exit(EXIT_FAILURE);
+    }
+    stats.report( cout );
+  }
   string outname = outputdir + base_name;
   if ( bootstrap ){
     outname += ".boosted";
@@ -447,16 +371,20 @@ int main(int argc, char * const argv[] ) {
   else {
     mbt_setting = "-s " + use_dir + mbt_setting + " -vcf" ;
   }
-  MbtAPI *PosTagger = new MbtAPI( mbt_setting, mylog );
-  if ( !PosTagger->isInit() ){
-    cerr << "unable to initialize a POS tagger using:" << mbt_setting << endl;
-    exit( EXIT_FAILURE );
+  MbtAPI *PosTagger = 0;
+  if ( pos_column == 0 ){
+    PosTagger = new MbtAPI( mbt_setting, mylog );
+    if ( !PosTagger->isInit() ){
+      cerr << "unable to initialize a POS tagger using:" << mbt_setting << endl;
+      exit( EXIT_FAILURE );
+    }
   }
   outname += ".data";
   string settings_name = outputdir + base_name + ".settings";
   cout << "Start enriching: " << inpname << " with POS tags"
        << " (every dot represents 100 tagged sentences)" << endl;
-  create_train_file( PosTagger, inpname, outname, override );
+  create_train_file( PosTagger, inpname, outname, pos_column, override );
+  delete PosTagger;
   cout << endl << "Created a trainingfile: " << outname << endl;
   string taggercommand = "-E " + outname
     + " -s " + settings_name
@@ -1,50 +1,384 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
 #include <string>
+#include <string_view>
 #include <iostream>
-#include <fstream>
 #include <vector>
-#include <ticcutils/StringOps.h>
+#include "ticcutils/StringOps.h"
+#include "ticcutils/CommandLine.h"
+#include "config.h"
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 
-int main(){
-  string line;
-  if ( !getline( cin, line ) ){
-    cerr << "empty input" << endl;
-    exit(EXIT_FAILURE);
-  }
-  vector<string> parts = TiCC::split_at( line, "\t" );
-  string word = parts[0];
-  string ner = parts[1];
-  string prev = "_";
-  string cur = parts[2];
-  while ( getline( cin, line ) ){
-    parts = TiCC::split_at( line, "\t" );
-    if ( parts.empty() ){
-      // ok, close previous group
-      cout << word << "\t" << "\t" << ner << "\t" << prev << "\t" << cur << "\t_" << endl << endl;
-      prev = "_";
-      if ( !getline( cin, line )){
-	break;
-      }
-      parts = TiCC::split_at( line, "\t" );
-      if ( parts.empty() ){
-	cerr << "2 empty lines in a row! " << endl;
-	exit(EXIT_FAILURE);
-      }
-      else {
-	word = parts[0];
-	ner = parts[1];
-	prev = cur;
-	cur = parts[2];
+// nerv reshapes sentences of TAB separated columns (one token per line,
+// an empty line after every sentence) into windows over those columns.
+// The input is read in large blocks that end on a sentence boundary. Each
+// block is split in one chunk per thread, also on sentence boundaries,
+// and the chunks are processed in parallel. The lines are never copied:
+// the columns are views into the block.
+
+// the old hardcoded layout: word, an empty column, the NER tag and the
+// previous, current and next POS tag, from 'word NER POS' input
+const string default_window = "1,,2,3-1,3,3+1";
+
+struct field_spec {
+  int column; // 0 based, -1 for an empty column
+  int offset;
+};
+
+void usage( const string& name ){
+  cerr << "usage: " << name << " [-w window] [-j threads] [-o outputfile] "
+       << "[inputfile]" << endl;
+  cerr << "reshape TAB separated columns into windows, sentence by sentence."
+       << endl;
+  cerr << "Reads from stdin and writes to stdout when no files are given."
+       << endl;
+  cerr << "\t -w <window> a comma separated list of columns (1 based), each "
+       << "with" << endl
+       << "\t    an optional offset to the current token. Outside the "
+       << "sentence" << endl
+       << "\t    a '_' is written. An empty entry gives an empty column."
+       << endl
+       << "\t    (default '" << default_window << "')" << endl;
+  cerr << "\t -j <threads> process chunks of the input in parallel" << endl;
+  cerr << "\t --block <MB> the size of the input blocks (default 64)"
+       << endl;
+  cerr << "\t -h or --help this message" << endl;
+  cerr << "\t -V or --version show version info" << endl;
+}
+
+bool parse_window( const string& spec,
+		   vector<field_spec>& fields,
+		   string& error ){
+  // not TiCC::split_at(), which drops the empty entries
+  string::size_type start = 0;
+  while ( start <= spec.size() ){
+    string::size_type comma = spec.find( ',', start );
+    if ( comma == string::npos ){
+      comma = spec.size();
+    }
+    string part = spec.substr( start, comma - start );
+    start = comma + 1;
+    field_spec f;
+    f.column = -1;
+    f.offset = 0;
+    string col = TiCC::trim( part );
+    if ( !col.empty() ){
+      string::size_type pos = col.find_first_of( "+-" );
+      if ( pos != string::npos ){
+	if ( !TiCC::stringTo( col.substr( pos+1 ), f.offset ) ){
+	  error = "invalid offset in '" + part + "'";
+	  return false;
+	}
+	if ( col[pos] == '-' ){
+	  f.offset = -f.offset;
+	}
+	col = col.substr( 0, pos );
+      }
+      if ( !TiCC::stringTo( col, f.column ) || f.column < 1 ){
+	error = "invalid column in '" + part + "'";
+	return false;
       }
+      --f.column;
+    }
+    fields.push_back( f );
+  }
+  if ( fields.size() == 1 && fields[0].column < 0 ){
+    error = "empty window";
+    return false;
+  }
+  return true;
+}
+
+// the columns of the lines of one sentence. The storage is kept between
+// sentences, to avoid reallocating.
+struct sentence_buffer {
+  vector<vector<string_view>> rows;
+  size_t size = 0;
+  vector<string_view>& next_row(){
+    if ( size == rows.size() ){
+      rows.emplace_back();
+    }
+    rows[size].clear();
+    return rows[size++];
+  }
+};
+
+bool emit_sentence( const sentence_buffer& sent,
+		    const vector<field_spec>& fields,
+		    string& out,
+		    string& error ){
+  long size = sent.size;
+  for ( long i=0; i < size; ++i ){
+    for ( size_t f=0; f < fields.size(); ++f ){
+      if ( f > 0 ){
+	out += '\t';
+      }
+      if ( fields[f].column < 0 ){
+	continue;
+      }
+      long pos = i + fields[f].offset;
+      if ( pos < 0 || pos >= size ){
+	out += '_';
+	continue;
+      }
+      const vector<string_view>& row = sent.rows[pos];
+      if ( size_t(fields[f].column) >= row.size() ){
+	error = "missing column " + TiCC::toString( fields[f].column+1 )
+	  + " in line starting with: '" + string( row[0] ) + "'";
+	return false;
+      }
+      out.append( row[fields[f].column].data(),
+		  row[fields[f].column].size() );
+    }
+    out += '\n';
+  }
+  out += '\n';
+  return true;
+}
+
+bool process_chunk( const char *begin,
+		    const char *end,
+		    const vector<field_spec>& fields,
+		    string& out,
+		    string& error ){
+  sentence_buffer sent;
+  const char *p = begin;
+  while ( p < end ){
+    const char *eol = static_cast<const char*>( memchr( p, '\n', end - p ) );
+    if ( !eol ){
+      eol = end;
+    }
+    const char *line_end = eol;
+    if ( line_end > p && line_end[-1] == '\r' ){
+      --line_end;
+    }
+    if ( line_end == p ){
+      // an empty line closes the sentence
+      if ( sent.size > 0 && !emit_sentence( sent, fields, out, error ) ){
+	return false;
+      }
+      sent.size = 0;
     }
     else {
-      cout << word << "\t" << "\t" << ner << "\t" << prev << "\t"
-	   << cur << "\t" << parts[2] << endl;
-      word = parts[0];
-      ner = parts[1];
-      prev = cur;
-      cur = parts[2];
+      vector<string_view>& row = sent.next_row();
+      const char *s = p;
+      while ( true ){
+	const char *tab = static_cast<const char*>( memchr( s, '\t',
+							    line_end - s ) );
+	if ( !tab ){
+	  row.emplace_back( s, line_end - s );
+	  break;
+	}
+	row.emplace_back( s, tab - s );
+	s = tab + 1;
+      }
     }
+    p = eol + 1;
+  }
+  if ( sent.size > 0 ){
+    // the input didn't end with an empty line
+    return emit_sentence( sent, fields, out, error );
+  }
+  return true;
+}
+
+const char *next_boundary( const char *p, const char *end ){
+  // the start of the first sentence after 'p': just after an empty line
+  while ( p < end ){
+    const char *eol = static_cast<const char*>( memchr( p, '\n', end - p ) );
+    if ( !eol ){
+      return end;
+    }
+    const char *next = eol + 1;
+    if ( next < end
+	 && ( *next == '\n'
+	      || ( *next == '\r' && next+1 < end && next[1] == '\n' ) ) ){
+      return static_cast<const char*>( memchr( next, '\n', end - next ) ) + 1;
+    }
+    p = next;
+  }
+  return end;
+}
+
+const char *last_boundary( const char *begin, const char *end ){
+  // the end of the last complete sentence in [begin,end), or 0
+  const char *p = end;
+  while ( p - begin >= 2 ){
+    --p;
+    if ( *p == '\n' ){
+      const char *q = p - 1;
+      if ( *q == '\r' && q > begin ){
+	--q;
+      }
+      if ( *q == '\n' ){
+	return p + 1;
+      }
+    }
+  }
+  return 0;
+}
+
+int main( int argc, char * const argv[] ){
+  TiCC::CL_Options opts( "w:j:o:hV", "block:,help,version" );
+  try {
+    opts.parse_args( argc, argv );
+  }
+  catch ( TiCC::OptionError& e ){
+    cerr << e.what() << endl;
+    usage( opts.prog_name() );
+    return EXIT_FAILURE;
+  }
+  if ( opts.extract( 'h' ) || opts.extract( "help" ) ){
+    usage( opts.prog_name() );
+    return EXIT_SUCCESS;
+  }
+  if ( opts.extract( 'V' ) || opts.extract( "version" ) ){
+    cerr << opts.prog_name() << " " << VERSION << endl;
+    return EXIT_SUCCESS;
+  }
+  string window = default_window;
+  opts.extract( 'w', window );
+  vector<field_spec> fields;
+  string error;
+  if ( !parse_window( window, fields, error ) ){
+    cerr << error << endl;
+    return EXIT_FAILURE;
+  }
+  int num_threads = 1;
+  string value;
+  if ( opts.extract( 'j', value ) ){
+    if ( !TiCC::stringTo( value, num_threads ) || num_threads < 1 ){
+      cerr << "invalid value for -j: " << value << endl;
+      return EXIT_FAILURE;
+    }
+  }
+#ifdef HAVE_OPENMP
+  omp_set_num_threads( num_threads );
+#else
+  if ( num_threads > 1 ){
+    cerr << "no OpenMP support. Running on 1 thread" << endl;
+    num_threads = 1;
+  }
+#endif
+  size_t block_size = 64;
+  if ( opts.extract( "block", value ) ){
+    if ( !TiCC::stringTo( value, block_size ) || block_size < 1 ){
+      cerr << "invalid value for --block: " << value << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  block_size *= 1024*1024;
+  FILE *in = stdin;
+  FILE *out = stdout;
+  vector<string> names = opts.getMassOpts();
+  if ( names.size() > 1 ){
+    cerr << "only 1 inputfile is allowed" << endl;
+    return EXIT_FAILURE;
+  }
+  if ( !names.empty() ){
+    in = fopen( names[0].c_str(), "rb" );
+    if ( !in ){
+      cerr << "unable to open: " << names[0] << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  string outname;
+  if ( opts.extract( 'o', outname ) ){
+    out = fopen( outname.c_str(), "wb" );
+    if ( !out ){
+      cerr << "unable to create: " << outname << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  vector<char> buf( block_size );
+  size_t filled = 0;
+  vector<string> results( num_threads );
+  bool eof = false;
+  while ( !eof ){
+    size_t got = fread( buf.data() + filled, 1, buf.size() - filled, in );
+    filled += got;
+    eof = ( filled < buf.size() );
+    const char *begin = buf.data();
+    const char *end = begin + filled;
+    if ( !eof ){
+      end = last_boundary( begin, end );
+      if ( !end ){
+	// a sentence larger than the buffer
+	buf.resize( 2 * buf.size() );
+	continue;
+      }
+    }
+    // split in chunks on sentence boundaries
+    vector<const char*> bounds( 1, begin );
+    for ( int t=1; t < num_threads; ++t ){
+      const char *target = begin + (end - begin) * t / num_threads;
+      bounds.push_back( max( bounds.back(), next_boundary( target, end ) ) );
+    }
+    bounds.push_back( end );
+    vector<string> errors( num_threads );
+    bool ok = true;
+#pragma omp parallel for schedule(static,1) reduction(&&:ok)
+    for ( int t=0; t < num_threads; ++t ){
+      results[t].clear();
+      ok = process_chunk( bounds[t], bounds[t+1], fields,
+			  results[t], errors[t] ) && ok;
+    }
+    if ( !ok ){
+      for ( const auto& e : errors ){
+	if ( !e.empty() ){
+	  cerr << e << endl;
+	}
+      }
+      return EXIT_FAILURE;
+    }
+    for ( const auto& res : results ){
+      if ( fwrite( res.data(), 1, res.size(), out ) != res.size() ){
+	cerr << "write error" << endl;
+	return EXIT_FAILURE;
+      }
+    }
+    // keep the incomplete sentence at the end of the block
+    size_t rest = begin + filled - end;
+    memmove( buf.data(), end, rest );
+    filled = rest;
+  }
+  if ( in != stdin ){
+    fclose( in );
+  }
+  if ( out != stdout && fclose( out ) != 0 ){
+    cerr << "write error on: " << outname << endl;
+    return EXIT_FAILURE;
   }
+  return EXIT_SUCCESS;
 }
@@ -0,0 +1,124 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <chrono>
+#include "ticcutils/StringOps.h"
+#include "ticcutils/Unicode.h"
+#include "toad/sentence_batch.h"
+
+using namespace std;
+using namespace icu;
+
+namespace Toad {
+
+  size_t SentenceReader::read_batch( vector<labeled_sentence>& batch,
+				     size_t max,
+				     string& error ){
+    if ( max == 0 ){
+      return 0;
+    }
+    if ( batch.size() < max ){
+      batch.resize( max );
+    }
+    size_t num = 0;
+    batch[0].words.clear();
+    batch[0].tags.clear();
+    batch[0].labels.clear();
+    while ( num < max && getline( _is, _line ) ){
+      if ( _line == "<utt>" ){
+	_utt = true;
+	_line.clear();
+      }
+      if ( _line.empty() ){
+	if ( !batch[num].words.empty() ){
+	  ++num;
+	  if ( num < max ){
+	    batch[num].words.clear();
+	    batch[num].tags.clear();
+	    batch[num].labels.clear();
+	  }
+	}
+	continue;
+      }
+      vector<UnicodeString> parts = TiCC::split( TiCC::UnicodeFromUTF8( _line ) );
+      if ( _pos_column > 0 ){
+	if ( parts.size() <= _pos_column ){
+	  error = "DOOD: " + _line;
+	  return 0;
+	}
+	batch[num].tags.push_back( parts[_pos_column-1] );
+      }
+      else if ( parts.size() != 2 ){
+	error = "DOOD: " + _line;
+	return 0;
+      }
+      batch[num].words.push_back( parts[0] );
+      batch[num].labels.push_back( parts.back() );
+    }
+    if ( num < max && !batch[num].words.empty() ){
+      // the last sentence, without a separator after it
+      ++num;
+      _unterminated = true;
+    }
+    return num;
+  }
+
+  void BatchTagger::tag( const vector<labeled_sentence>& batch,
+			 size_t num,
+			 vector<vector<Tagger::TagResult>>& results ){
+    if ( results.size() < num ){
+      results.resize( num );
+    }
+    for ( size_t i=0; i < num; ++i ){
+      auto t0 = chrono::steady_clock::now();
+      _buffer.remove();
+      for ( const auto& word : batch[i].words ){
+	_buffer += word;
+	_buffer += "\n";
+      }
+      auto t1 = chrono::steady_clock::now();
+      results[i] = _tagger->TagLine( _buffer );
+      auto t2 = chrono::steady_clock::now();
+      _prep_seconds += chrono::duration<double>( t1 - t0 ).count();
+      _tag_seconds += chrono::duration<double>( t2 - t1 ).count();
+      _words += batch[i].words.size();
+    }
+    _sentences += num;
+  }
+
+  void BatchTagger::report( ostream& os ) const {
+    if ( _sentences == 0 ){
+      return;
+    }
+    os << "tagged " << _sentences << " sentences (" << _words << " words)"
+       << endl
+       << "\tMBT:               " << 1e6 * _tag_seconds / _sentences
+       << " us per sentence" << endl
+       << "\tinput preparation: " << 1e6 * _prep_seconds / _sentences
+       << " us per sentence" << endl;
+  }
+
+}
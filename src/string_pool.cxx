@@ -0,0 +1,195 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <cstring>
+#include <stdexcept>
+#include "toad/string_pool.h"
+
+using namespace std;
+using namespace icu;
+
+namespace Toad {
+
+  static const UChar empty_string[1] = { 0 };
+
+  StringPool::StringPool( size_t block_size ):
+    _block_size( block_size ),
+    _used( block_size ),
+    _allocated( 0 )
+  {
+    if ( _block_size == 0 ){
+      throw invalid_argument( "StringPool: block size must be > 0" );
+    }
+  }
+
+  uint32_t StringPool::hash_of( const UChar *s, int32_t len ){
+    // FNV-1a over the UTF-16 code units
+    uint32_t h = 2166136261u;
+    for ( int32_t i=0; i < len; ++i ){
+      h ^= s[i];
+      h *= 16777619u;
+    }
+    return h;
+  }
+
+  size_t StringPool::lookup( const UChar *s,
+			     int32_t len,
+			     uint32_t h ) const {
+    // returns the slot in _index where s lives, or the empty slot where
+    // it should go
+    size_t mask = _index.size() - 1;
+    size_t slot = h & mask;
+    while ( _index[slot] != 0 ){
+      const entry& e = _entries[_index[slot]-1];
+      if ( e.hash == h
+	   && e.len == len
+	   && memcmp( e.ptr, s, len * sizeof(UChar) ) == 0 ){
+	break;
+      }
+      slot = (slot+1) & mask;
+    }
+    return slot;
+  }
+
+  const UChar *StringPool::store( const UChar *s, int32_t len ){
+    if ( len == 0 ){
+      return empty_string;
+    }
+    size_t ulen = len;
+    if ( ulen > _block_size/4 ){
+      // big strings get a block of their own, so we don't waste the
+      // remainder of the current block
+      _blocks.emplace( _blocks.begin(), new UChar[ulen] );
+      _allocated += ulen;
+      memcpy( _blocks.front().get(), s, ulen * sizeof(UChar) );
+      return _blocks.front().get();
+    }
+    if ( _used + ulen > _block_size ){
+      _blocks.emplace_back( new UChar[_block_size] );
+      _allocated += _block_size;
+      _used = 0;
+    }
+    UChar *result = _blocks.back().get() + _used;
+    memcpy( result, s, ulen * sizeof(UChar) );
+    _used += ulen;
+    return result;
+  }
+
+  void StringPool::rehash(){
+    size_t new_size = _index.empty() ? 1024 : 2 * _index.size();
+    _index.assign( new_size, 0 );
+    size_t mask = new_size - 1;
+    for ( size_t id=0; id < _entries.size(); ++id ){
+      size_t slot = _entries[id].hash & mask;
+      while ( _index[slot] != 0 ){
+	slot = (slot+1) & mask;
+      }
+      _index[slot] = id+1;
+    }
+  }
+
+  string_id StringPool::intern( const UChar *s, int32_t len ){
+    if ( 2*(_entries.size()+1) > _index.size() ){
+      // keep the load factor below 0.5
+      rehash();
+    }
+    uint32_t h = hash_of( s, len );
+    size_t slot = lookup( s, len, h );
+    if ( _index[slot] != 0 ){
+      return _index[slot]-1;
+    }
+    if ( _entries.size() == UINT32_MAX ){
+      throw range_error( "StringPool: too many strings" );
+    }
+    entry e;
+    e.ptr = store( s, len );
+    e.len = len;
+    e.hash = h;
+    _entries.push_back( e );
+    _index[slot] = _entries.size();
+    return _entries.size()-1;
+  }
+
+  string_id StringPool::intern( const UnicodeString& us ){
+    return intern( us.getBuffer(), us.length() );
+  }
+
+  bool StringPool::find( const UnicodeString& us, string_id& id ) const {
+    if ( _index.empty() ){
+      return false;
+    }
+    const UChar *s = us.getBuffer();
+    int32_t len = us.length();
+    size_t slot = lookup( s, len, hash_of( s, len ) );
+    if ( _index[slot] == 0 ){
+      return false;
+    }
+    id = _index[slot]-1;
+    return true;
+  }
+
+  UnicodeString StringPool::get( string_id id ) const {
+    // a read-only alias into the pool, NO copy is made.
+    // It stays valid as long as the pool is not cleared.
+    const entry& e = _entries[id];
+    return UnicodeString( false, e.ptr, e.len );
+  }
+
+  int StringPool::compare( string_id a, string_id b ) const {
+    // same ordering as UnicodeString::compare() (code unit order)
+    if ( a == b ){
+      return 0;
+    }
+    const entry& ea = _entries[a];
+    const entry& eb = _entries[b];
+    int32_t len = min( ea.len, eb.len );
+    for ( int32_t i=0; i < len; ++i ){
+      if ( ea.ptr[i] != eb.ptr[i] ){
+	return ea.ptr[i] < eb.ptr[i] ? -1 : 1;
+      }
+    }
+    if ( ea.len == eb.len ){
+      return 0;
+    }
+    return ea.len < eb.len ? -1 : 1;
+  }
+
+  size_t StringPool::memory_usage() const {
+    size_t result = _allocated * sizeof(UChar);
+    result += _entries.capacity() * sizeof(entry);
+    result += _index.capacity() * sizeof(string_id);
+    return result;
+  }
+
+  void StringPool::clear(){
+    _blocks.clear();
+    _entries.clear();
+    _index.clear();
+    _used = _block_size;
+    _allocated = 0;
+  }
+
+}
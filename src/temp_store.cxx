@@ -0,0 +1,232 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <iostream>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "ticcutils/FileUtils.h"
+#include "ticcutils/StringOps.h"
+#include "toad/temp_store.h"
+#include "config.h"
+
+using namespace std;
+
+namespace Toad {
+
+  bool TempStore::memory_supported(){
+#ifdef HAVE_MEMFD_CREATE
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  size_t TempStore::writing_size() const {
+    // the memory of the files that are still being written: their
+    // estimate, or their current size when that is more.
+    // (called with _mutex held)
+    size_t result = 0;
+    for ( const auto& it : _entries ){
+      const entry& e = it.second;
+      if ( !e.writing ){
+	continue;
+      }
+      size_t size = e.estimate;
+      struct stat st;
+      if ( e.fd >= 0
+	   && fstat( e.fd, &st ) == 0
+	   && size_t(st.st_size) > size ){
+	size = st.st_size;
+      }
+      result += size;
+    }
+    return result;
+  }
+
+  bool TempStore::create( const string& path,
+			  string& error,
+			  size_t estimate ){
+    if ( _budget > 0 && !memory_supported() ){
+      error = "temporary files in memory are not supported on this system";
+      return false;
+    }
+    ::remove( path.c_str() );
+    bool in_memory = false;
+    {
+      lock_guard<mutex> lock( _mutex );
+      auto it = _entries.find( path );
+      if ( it != _entries.end() ){
+	// made again, e.g. by a second run of the same step
+	if ( it->second.fd >= 0 ){
+	  close( it->second.fd );
+	}
+	_used -= it->second.size;
+	_entries.erase( it );
+      }
+      entry e;
+      size_t taken = _used + writing_size();
+      if ( _budget > 0
+	   && taken <= _budget
+	   && estimate <= _budget - taken ){
+	// reserve the estimate now, so files that are created at the same
+	// time don't all count on the same free memory
+	in_memory = true;
+	e.writing = true;
+	e.estimate = estimate;
+      }
+      _entries[path] = e;
+    }
+    if ( in_memory ){
+#ifdef HAVE_MEMFD_CREATE
+      int fd = memfd_create( TiCC::basename( path ).c_str(), MFD_CLOEXEC );
+#else
+      int fd = -1; // not reached, there is no budget without memfd's
+      errno = ENOSYS;
+#endif
+      if ( fd < 0 ){
+	error = "unable to create a memory file for '" + path + "': "
+	  + strerror( errno );
+	remove( path );
+	return false;
+      }
+      // the pid, not 'self', so a listing of the dir shows the owner
+      string target = "/proc/" + TiCC::toString( getpid() )
+	+ "/fd/" + TiCC::toString( fd );
+      if ( symlink( target.c_str(), path.c_str() ) != 0 ){
+	error = "unable to create '" + path + "': " + strerror( errno );
+	close( fd );
+	remove( path );
+	return false;
+      }
+      lock_guard<mutex> lock( _mutex );
+      _entries[path].fd = fd;
+    }
+    return true;
+  }
+
+  bool TempStore::done( const string& path, string& error ){
+    lock_guard<mutex> lock( _mutex );
+    auto it = _entries.find( path );
+    if ( it == _entries.end() || it->second.fd < 0 ){
+      return true;
+    }
+    entry& e = it->second;
+    e.writing = false;
+    struct stat st;
+    if ( fstat( e.fd, &st ) != 0 ){
+      error = "unable to stat '" + path + "': " + strerror( errno );
+      return false;
+    }
+    size_t size = st.st_size;
+    if ( _used + writing_size() + size <= _budget ){
+      e.size = size;
+      _used += size;
+      return true;
+    }
+    return to_disk( path, e, error );
+  }
+
+  bool TempStore::to_disk( const string& path, entry& e, string& error ){
+    // replace the symlink by a real file with the contents of the memfd
+    ::remove( path.c_str() );
+    FILE *out = fopen( path.c_str(), "wb" );
+    if ( !out ){
+      error = "unable to create '" + path + "': " + strerror( errno );
+      return false;
+    }
+    vector<char> buf( 1024*1024 );
+    off_t pos = 0;
+    ssize_t len;
+    while ( (len = pread( e.fd, buf.data(), buf.size(), pos )) > 0 ){
+      if ( fwrite( buf.data(), 1, len, out ) != size_t(len) ){
+	break;
+      }
+      pos += len;
+    }
+    bool ok = ( len == 0 );
+    if ( fclose( out ) != 0 ){
+      ok = false;
+    }
+    if ( !ok ){
+      error = "unable to move '" + path + "' to disk";
+    }
+    close( e.fd );
+    e.fd = -1;
+    _used -= e.size;
+    e.size = 0;
+    return ok;
+  }
+
+  void TempStore::add( const string& path ){
+    lock_guard<mutex> lock( _mutex );
+    _entries.insert( make_pair( path, entry() ) );
+  }
+
+  void TempStore::remove( const string& path ){
+    lock_guard<mutex> lock( _mutex );
+    auto it = _entries.find( path );
+    if ( it == _entries.end() ){
+      return;
+    }
+    ::remove( path.c_str() );
+    if ( it->second.fd >= 0 ){
+      close( it->second.fd );
+    }
+    _used -= it->second.size;
+    _entries.erase( it );
+  }
+
+  void TempStore::cleanup(){
+    lock_guard<mutex> lock( _mutex );
+    for ( auto& it : _entries ){
+      if ( _keep ){
+	if ( it.second.fd >= 0 ){
+	  string error;
+	  if ( !to_disk( it.first, it.second, error ) ){
+	    cerr << error << endl;
+	  }
+	}
+	continue;
+      }
+      ::remove( it.first.c_str() );
+      if ( it.second.fd >= 0 ){
+	close( it.second.fd );
+      }
+    }
+    _entries.clear();
+    _used = 0;
+  }
+
+  size_t TempStore::in_memory() const {
+    lock_guard<mutex> lock( _mutex );
+    return _used + writing_size();
+  }
+
+}
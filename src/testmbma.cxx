@@ -30,8 +30,15 @@
 #include <fstream>
 #include <vector>
 #include <map>
+#include <new>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <cstdlib>
 
 #include "config.h"
+#include "unicode/uclean.h"
+#include "unicode/utypes.h"
 #include "ticcutils/LogStream.h"
 #include "ticcutils/Configuration.h"
 #include "ticcutils/CommandLine.h"
@@ -42,6 +49,12 @@
 
 #include "frog/cgn_tagger_mod.h"
 #include "frog/mbma_mod.h"
+#include "toad/analysis_cache.h"
+#include "toad/owned_list.h"
+#include "toad/checkers.h"
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace	icu;
@@ -58,6 +71,56 @@ Configuration configuration;
 static string configDir = string(SYSCONF_PATH) + "/frog/nld/";
 static string configFileName = configDir + "frog.cfg";
 static Mbma myMbma(theErrLog);
+static string cacheFileName;
+static Toad::AnalysisCache *theCache = 0;
+static bool check_cache = false;
+static size_t cache_hits = 0;
+static size_t cache_differences = 0;
+static int bench_iterations = 0;
+static bool bench_classify = false;
+static int num_threads = 1;
+
+// count the heap allocations, per thread, for the benchmark. Only C++ new
+// and ICU's allocations are counted, and only while benchmarking. Direct
+// malloc() calls (in Timbl and the C library) are not.
+static bool count_allocs = false;
+static thread_local size_t alloc_count = 0;
+
+void *operator new( size_t size ){
+  if ( count_allocs ){
+    ++alloc_count;
+  }
+  void *p = malloc( size ? size : 1 );
+  if ( !p ){
+    throw bad_alloc();
+  }
+  return p;
+}
+
+void operator delete( void *p ) noexcept {
+  free( p );
+}
+
+void operator delete( void *p, size_t ) noexcept {
+  free( p );
+}
+
+extern "C" {
+  // the heap functions for ICU while benchmarking
+  static void * U_CALLCONV counting_alloc( const void *, size_t size ){
+    ++alloc_count;
+    return malloc( size );
+  }
+  static void * U_CALLCONV counting_realloc( const void *,
+					     void *mem,
+					     size_t size ){
+    ++alloc_count;
+    return realloc( mem, size );
+  }
+  static void U_CALLCONV counting_free( const void *, void *mem ){
+    free( mem );
+  }
+}
 
 
 void usage( ) {
@@ -66,6 +129,17 @@ void usage( ) {
        << "\t -t <testfile>          Run mbma on this file\n"
        << "\t -c <filename>    Set configuration file (default " << configFileName << ")\n"
        << "\t --deep-morph     Do deep morphe anlysis\n"
+       << "\t --cache <file>   Keep the analyses in this file, and only run mbma\n"
+       << "\t                  on lines not in it for the current tree and settings\n"
+       << "\t --check-cache    Also run mbma on the lines found in the cache,\n"
+       << "\t                  and report the ones with a different output\n"
+       << "\t============= BENCHMARK ================================================\n"
+       << "\t --bench <K>      Run mbma K times over the input, without output,\n"
+       << "\t                  and report the speed, latency and allocations\n"
+       << "\t                  (by C++ new and by ICU, not direct malloc() calls)\n"
+       << "\t --bench-classify Benchmark Classify() on the words, instead of\n"
+       << "\t                  execute() on the words and their classes\n"
+       << "\t --threads <N>    Run the benchmark on N threads\n"
        << "\t============= OTHER OPTIONS ============================================\n"
        << "\t -h. give some help.\n"
        << "\t -V or --version .   Show version info.\n"
@@ -116,6 +190,30 @@ bool parse_args( TiCC::CL_Options& Opts ) {
   if ( Opts.extract( "deep-morph" ) ){
     configuration.setatt( "deep-morph", "1", "mbma" );
   };
+  Opts.extract( "cache", cacheFileName );
+  check_cache = Opts.extract( "check-cache" );
+  if ( check_cache && cacheFileName.empty() ){
+    cerr << "--check-cache needs --cache" << endl;
+    return false;
+  }
+  if ( Opts.extract( "bench", value ) ){
+    if ( !TiCC::stringTo<int>( value, bench_iterations )
+	 || bench_iterations < 1 ){
+      cerr << "--bench value should be a positive integer" << endl;
+      return false;
+    }
+  }
+  bench_classify = Opts.extract( "bench-classify" );
+  if ( bench_classify && bench_iterations == 0 ){
+    bench_iterations = 1;
+  }
+  if ( Opts.extract( "threads", value ) ){
+    if ( !TiCC::stringTo<int>( value, num_threads )
+	 || num_threads < 1 ){
+      cerr << "--threads value should be a positive integer" << endl;
+      return false;
+    }
+  }
   return true;
 }
 
@@ -127,45 +225,226 @@ bool init(){
     cerr << "MBMA Initialization failed." << endl;
     return false;
   }
+  if ( !cacheFileName.empty() ){
+    uint64_t model_hash;
+    uint64_t config_hash;
+    string error;
+    if ( !Toad::mbma_fingerprint( configuration, model_hash, config_hash,
+				  error ) ){
+      cerr << error << endl;
+      return false;
+    }
+    theCache = new Toad::AnalysisCache( cacheFileName,
+					model_hash,
+					config_hash );
+    if ( !theCache->load( error ) ){
+      cerr << error << endl;
+      return false;
+    }
+    cerr << "found " << theCache->size() << " cached analyses in "
+	 << cacheFileName << endl;
+  }
   cerr << "Initialization done." << endl;
   return true;
 }
 
+bool save_cache(){
+  if ( !theCache ){
+    return true;
+  }
+  if ( check_cache ){
+    cerr << "checked " << cache_hits << " cached lines, "
+	 << cache_differences << " differ from a fresh analysis" << endl;
+  }
+  cerr << "adding " << theCache->added() << " analyses to "
+       << cacheFileName << endl;
+  string error;
+  bool result = theCache->save( error );
+  if ( !result ){
+    cerr << error << endl;
+  }
+  delete theCache;
+  theCache = 0;
+  return result && cache_differences == 0;
+}
+
 void Test( istream& in, bool deep ){
   UnicodeString line;
+  // reused for every line. The rules of a line are freed by the next one
+  Toad::OwnedList<Rule> rules;
+  vector<Toad::analysis> analyses;
+  vector<Toad::analysis> fresh;
   while ( TiCC::getline( in, line ) ){
-    line.trim();
-    if ( line.isEmpty() )
-      continue;
-    //    cerr << "processing: " << line << endl;
-    vector<UnicodeString> parts = TiCC::split( line );
-    if ( parts.size() < 2 ){
+    UnicodeString uWord;
+    vector<UnicodeString> parts;
+    if ( !Toad::split_test_line( line, uWord, parts ) ){
       continue;
     }
-    UnicodeString uWord = parts[0];
-    uWord.toLower();
-    parts.erase(parts.begin());
-    vector<Rule *> rules = myMbma.execute( uWord, "", parts );
-    if ( rules.empty() ){
-      cout << "no rule matched: " << line << endl;
-    }
-    else {
-      for ( auto const& r : rules ){
-	cout << uWord << "==> " << r->pretty_string( deep )
-	     << " " << r->tag << endl;
-	delete r;
+    // the analyses depend on the word AND the given classes
+    UnicodeString key = uWord;
+    for ( const auto& p : parts ){
+      key += " " + p;
+    }
+    const vector<Toad::analysis> *cached = 0;
+    analyses.clear();
+    if ( theCache ){
+      cached = theCache->find( key );
+    }
+    if ( cached && check_cache ){
+      ++cache_hits;
+      Toad::mbma_analyze( myMbma, rules, uWord, parts, deep, fresh );
+      if ( fresh != *cached ){
+	++cache_differences;
+	cerr << "cached output differs for: " << line << endl;
+      }
+    }
+    if ( !cached ){
+      Toad::mbma_analyze( myMbma, rules, uWord, parts, deep, analyses );
+      if ( theCache ){
+	theCache->add( key, analyses );
       }
+      cached = &analyses;
     }
+    Toad::write_analyses( cout, line, uWord, *cached );
   }
   return;
 }
 
+struct bench_item {
+  UnicodeString word;
+  vector<UnicodeString> classes;
+};
+
+bool read_bench_items( const string& filename, vector<bench_item>& items ){
+  ifstream in( filename );
+  if ( !in ){
+    return false;
+  }
+  UnicodeString line;
+  while ( TiCC::getline( in, line ) ){
+    vector<UnicodeString> parts = TiCC::split( line );
+    if ( parts.empty()
+	 || ( !bench_classify && parts.size() < 2 ) ){
+      // the same lines as Test() uses
+      continue;
+    }
+    bench_item item;
+    item.word = parts[0];
+    item.word.toLower();
+    item.classes.assign( parts.begin()+1, parts.end() );
+    items.push_back( item );
+  }
+  return true;
+}
+
+void run_bench_item( Mbma& mbma, const bench_item& item ){
+  if ( bench_classify ){
+    mbma.Classify( item.word );
+    vector<pair<UnicodeString,string>> res = mbma.getResults();
+  }
+  else {
+    Toad::OwnedList<Rule> rules( mbma.execute( item.word, "", item.classes ) );
+  }
+}
+
+double percentile( const vector<double>& sorted, double p ){
+  if ( sorted.empty() ){
+    return 0;
+  }
+  size_t pos = size_t( p * (sorted.size()-1) + 0.5 );
+  return sorted[pos];
+}
+
+bool Bench(){
+  vector<bench_item> items;
+  for ( const auto& name : fileNames ){
+    if ( !read_bench_items( name, items ) ){
+      cerr << "unable to open: " << name << endl;
+      return false;
+    }
+  }
+  if ( items.empty() ){
+    cerr << "nothing to benchmark" << endl;
+    return false;
+  }
+#ifdef HAVE_OPENMP
+  omp_set_num_threads( num_threads );
+#else
+  if ( num_threads > 1 ){
+    cerr << "no OpenMP support. Running on 1 thread" << endl;
+    num_threads = 1;
+  }
+#endif
+  // every thread needs its own Mbma. thread 0 uses the global one.
+  vector<unique_ptr<Mbma>> own_mbmas;
+  vector<Mbma*> mbmas( 1, &myMbma );
+  for ( int i=1; i < num_threads; ++i ){
+    own_mbmas.emplace_back( new Mbma( theErrLog ) );
+    if ( !own_mbmas.back()->init( configuration ) ){
+      cerr << "MBMA Initialization failed." << endl;
+      return false;
+    }
+    mbmas.push_back( own_mbmas.back().get() );
+  }
+  cerr << "benchmarking " << ( bench_classify ? "Classify()" : "execute()" )
+       << " on " << items.size() << " words, " << bench_iterations
+       << " times, with " << num_threads << " thread(s)" << endl;
+  vector<vector<double>> latencies( num_threads );
+  vector<size_t> allocs( num_threads, 0 );
+  // ICU's own allocations go through malloc(), and so do ours. So the
+  // memory allocated before this is freed as usual.
+  UErrorCode status = U_ZERO_ERROR;
+  u_setMemoryFunctions( 0, counting_alloc, counting_realloc, counting_free,
+			&status );
+  if ( U_FAILURE( status ) ){
+    cerr << "unable to count ICU's allocations: " << u_errorName( status )
+	 << endl;
+  }
+  count_allocs = true;
+  auto start = chrono::steady_clock::now();
+  for ( int it=0; it < bench_iterations; ++it ){
+#pragma omp parallel for schedule(dynamic,16)
+    for ( size_t i=0; i < items.size(); ++i ){
+      int thread = 0;
+#ifdef HAVE_OPENMP
+      thread = omp_get_thread_num();
+#endif
+      size_t before = alloc_count;
+      auto t0 = chrono::steady_clock::now();
+      run_bench_item( *mbmas[thread], items[i] );
+      auto t1 = chrono::steady_clock::now();
+      allocs[thread] += alloc_count - before;
+      latencies[thread].push_back( chrono::duration<double,micro>( t1 - t0 ).count() );
+    }
+  }
+  auto end = chrono::steady_clock::now();
+  count_allocs = false;
+  own_mbmas.clear();
+  vector<double> all;
+  size_t total_allocs = 0;
+  for ( int t=0; t < num_threads; ++t ){
+    all.insert( all.end(), latencies[t].begin(), latencies[t].end() );
+    total_allocs += allocs[t];
+  }
+  sort( all.begin(), all.end() );
+  double seconds = chrono::duration<double>( end - start ).count();
+  cout << "words:           " << all.size() << endl;
+  cout << "time:            " << seconds << " s" << endl;
+  cout << "words/sec:       " << all.size() / seconds << endl;
+  cout << "p50 latency:     " << percentile( all, 0.50 ) << " us" << endl;
+  cout << "p99 latency:     " << percentile( all, 0.99 ) << " us" << endl;
+  cout << "allocs per word: " << double(total_allocs) / all.size()
+       << " (C++ new and ICU)" << endl;
+  return true;
+}
 
 int main(int argc, char *argv[]) {
   std::ios_base::sync_with_stdio(false);
   cerr << "mbma_tester " << VERSION << " (c) LaMa 1998 - 2020" << endl;
   cerr << "Language Machine Group, Radboud University" << endl;
-  TiCC::CL_Options Opts("Vt:d:hc:","version,deep-morph");
+  TiCC::CL_Options Opts("Vt:d:hc:",
+			"version,deep-morph,cache:,check-cache,bench:,bench-classify,"
+			"threads:");
   try {
     Opts.parse_args(argc, argv);
   }
@@ -180,6 +459,9 @@ int main(int argc, char *argv[]) {
       cerr << "terminated." << endl;
       return EXIT_FAILURE;
     }
+    if ( bench_iterations > 0 ){
+      return Bench() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
     bool deep = !configuration.getatt( "deep-morph", "mbma" ).empty();
     for ( size_t i=0; i < fileNames.size(); ++i ){
       string TestFileName = fileNames[i];
@@ -190,9 +472,13 @@ int main(int argc, char *argv[]) {
       }
       else {
 	cerr << "unable to open: " << TestFileName << endl;
+	save_cache();
 	return EXIT_FAILURE;
       }
     }
+    if ( !save_cache() ){
+      return EXIT_FAILURE;
+    }
   }
   else {
     return EXIT_FAILURE;
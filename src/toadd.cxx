@@ -0,0 +1,773 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <cstdlib>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <csignal>
+#include <cerrno>
+#include <string>
+#include <iostream>
+#include <streambuf>
+#include <vector>
+#include <set>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "ticcutils/StringOps.h"
+#include "ticcutils/CommandLine.h"
+#include "ticcutils/FileUtils.h"
+#include "ticcutils/Configuration.h"
+#include "ticcutils/LogStream.h"
+#include "ticcutils/PrettyPrint.h"
+#include "ticcutils/Unicode.h"
+#include "unicode/ustream.h"
+#include "unicode/unistr.h"
+#include "mbt/MbtAPI.h"
+#include "frog/mbma_mod.h"
+#include "frog/mblem_mod.h"
+#include "frog/ner_tagger_mod.h"
+#include "toad/frozen_lexicon.h"
+#include "toad/owned_list.h"
+#include "toad/checkers.h"
+#include "toad/enrichment.h"
+#include "config.h"
+
+using namespace std;
+using namespace icu;
+
+// toadd keeps the models of the check and enrichment tools loaded, and
+// runs jobs for clients that connect to a Unix domain socket.
+// Every connection is one job. The client sends a line with the job and
+// its arguments, then the input, and then shuts down its side for
+// writing. The results are streamed back as they are produced, followed
+// by a status line: "#toadd OK" or "#toadd ERROR <message>".
+// The jobs run on a fixed pool of threads. Every thread has its own
+// MBMA, MBLEM and MBT tagger, the lexicons and the gazetteers are only
+// read, so they are shared.
+
+TiCC::LogStream *theErrLog = new TiCC::LogStream(cerr);
+
+static string configDir = string(SYSCONF_PATH) + "/frog/nld/";
+static string configFileName = configDir + "frog.cfg";
+static TiCC::Configuration configuration;
+
+// filled once in main(), after that only read. (shared by all threads)
+static Toad::FrozenLexicon lexicon;
+static Toad::FrozenLexicon mor_lexicon;
+static NERTagger *theNer = 0;
+static string mbt_setting;
+// the seconds a connection may be idle, see set_timeouts()
+static int idle_timeout = 300;
+
+const string status_prefix = "#toadd ";
+
+void usage( const string& name ){
+  cerr << "usage: " << name << " -S socket [-c configfile] [-j threads] "
+       << "[-L lexicon] [-M lexicon]" << endl
+       << "\t\t[--tagger settings] [-g gazetteer] [--timeout seconds]"
+       << endl;
+  cerr << "   or: " << name << " --client -S socket job [arguments]" << endl;
+  cerr << "Runs as a daemon, with the models loaded once, and handles jobs "
+       << "from" << endl
+       << "clients. The client mode sends stdin as the input of a job, and "
+       << "writes" << endl
+       << "the results to stdout." << endl;
+  cerr << "\t -S <socket> the Unix domain socket to listen on. An existing "
+       << "file is only" << endl
+       << "\t    replaced when it is a socket nobody listens on." << endl;
+  cerr << "\t -c <filename> the frog configuration (default "
+       << configFileName << ")" << endl;
+  cerr << "\t -j <threads> the number of jobs that run at the same time. "
+       << "Every" << endl
+       << "\t    thread has its own models. (default 1)" << endl;
+  cerr << "\t -L <lexicon> a binary lemma lexicon (made by makelex), needed "
+       << "by the" << endl
+       << "\t    'check' and 'lemma' jobs" << endl;
+  cerr << "\t -M <lexicon> a binary morpheme lexicon, for 'check -m'" << endl;
+  cerr << "\t --tagger <settings> a MBT settingsfile, needed by 'enrich'"
+       << endl;
+  cerr << "\t -g <gazetteer> a gazetteer file (see nergen), needed by "
+       << "'enrich ner'" << endl
+       << "\t    and 'bootstrap'" << endl;
+  cerr << "\t --timeout <seconds> end a job when its client sends or "
+       << "reads nothing" << endl
+       << "\t    for this long. 0 means never. (default " << idle_timeout
+       << ")" << endl;
+  cerr << "The jobs are:" << endl
+       << "\t test            lines with a word and its classes, as for "
+       << "testmbma" << endl
+       << "\t check [-m]      words, checked as by checkmbma" << endl
+       << "\t lemma           words, checked as by checkmblem. The "
+       << "mismatches" << endl
+       << "\t                 are written as word, lemma and tag" << endl
+       << "\t enrich chunk    a 2 column IOB corpus, enriched as by chunkgen"
+       << endl
+       << "\t enrich ner      a 2 column NER corpus, enriched as by nergen"
+       << endl
+       << "\t bootstrap [running] NER tags from the gazetteers, as by "
+       << "nergen --bootstrap" << endl;
+  cerr << "\t -h or --help this message" << endl;
+  cerr << "\t -V or --version show version info" << endl;
+}
+
+// a streambuf over a connected socket, so the jobs can use the same
+// istream and ostream code as the tools.
+class socket_buf: public streambuf {
+public:
+  explicit socket_buf( int fd ):
+    _fd( fd ), _failed( false ), _timed_out( false ) {
+    setg( _in, _in, _in );
+    setp( _out, _out + sizeof(_out) );
+  };
+  ~socket_buf(){ sync(); };
+  bool failed() const { return _failed; };
+  // true when a read ended on the receive timeout (SO_RCVTIMEO)
+  bool timed_out() const { return _timed_out; };
+protected:
+  int_type underflow() override {
+    ssize_t got;
+    do {
+      got = ::read( _fd, _in, sizeof(_in) );
+    } while ( got < 0 && errno == EINTR );
+    if ( got < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) ){
+      _timed_out = true;
+    }
+    if ( got <= 0 ){
+      return traits_type::eof();
+    }
+    setg( _in, _in, _in + got );
+    return traits_type::to_int_type( *gptr() );
+  };
+  int_type overflow( int_type c ) override {
+    if ( !flush_out() ){
+      return traits_type::eof();
+    }
+    if ( !traits_type::eq_int_type( c, traits_type::eof() ) ){
+      *pptr() = traits_type::to_char_type( c );
+      pbump( 1 );
+    }
+    return traits_type::not_eof( c );
+  };
+  int sync() override {
+    return flush_out() ? 0 : -1;
+  };
+private:
+  bool flush_out(){
+    const char *p = pbase();
+    while ( !_failed && p < pptr() ){
+      // MSG_NOSIGNAL: a client that went away is not a reason to die
+      ssize_t sent = ::send( _fd, p, pptr() - p, MSG_NOSIGNAL );
+      if ( sent < 0 ){
+	if ( errno == EINTR ){
+	  continue;
+	}
+	_failed = true;
+      }
+      else {
+	p += sent;
+      }
+    }
+    setp( _out, _out + sizeof(_out) );
+    return !_failed;
+  };
+  int _fd;
+  bool _failed;
+  bool _timed_out;
+  char _in[65536];
+  char _out[65536];
+};
+
+// the models of one thread of the pool
+struct thread_models {
+  Mbma *mbma = 0;
+  Mblem *mblem = 0;
+  MbtAPI *tagger = 0;
+};
+
+bool init_models( thread_models& models ){
+  models.mbma = new Mbma( theErrLog );
+  if ( !models.mbma->init( configuration ) ){
+    cerr << "unable to initialize MBMA from " << configFileName << endl;
+    return false;
+  }
+  models.mblem = new Mblem( theErrLog );
+  if ( !models.mblem->init( configuration ) ){
+    cerr << "unable to initialize MBLEM from " << configFileName << endl;
+    return false;
+  }
+  if ( !mbt_setting.empty() ){
+    models.tagger = new MbtAPI( mbt_setting, *theErrLog );
+    if ( !models.tagger->isInit() ){
+      cerr << "unable to initialize a POS tagger using:" << mbt_setting
+	   << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+void free_models( thread_models& models ){
+  delete models.mbma;
+  delete models.mblem;
+  delete models.tagger;
+}
+
+// the jobs call the same functions as the tools do (see checkers.h and
+// enrichment.h), so they give the same output.
+
+bool test_job( thread_models& models,
+	       istream& in,
+	       ostream& os,
+	       string& ){
+  // as testmbma, without the cache
+  UnicodeString line;
+  UnicodeString word;
+  vector<UnicodeString> classes;
+  Toad::OwnedList<Rule> rules;
+  vector<Toad::analysis> analyses;
+  while ( TiCC::getline( in, line ) ){
+    if ( Toad::split_test_line( line, word, classes ) ){
+      Toad::mbma_analyze( *models.mbma, rules, word, classes, false,
+			  analyses );
+      Toad::write_analyses( os, line, word, analyses );
+    }
+  }
+  return true;
+}
+
+bool check_job( thread_models& models,
+		const vector<string>& args,
+		istream& in,
+		ostream& os,
+		string& error ){
+  // as checkmbma, without the cache
+  bool doMor = ( args.size() > 1 && args[1] == "-m" );
+  if ( lexicon.size() == 0 ){
+    error = "no lemma lexicon loaded (-L)";
+    return false;
+  }
+  if ( doMor && mor_lexicon.size() == 0 ){
+    error = "no morpheme lexicon loaded (-M)";
+    return false;
+  }
+  UnicodeString line;
+  vector<Toad::analysis> unused;
+  while ( TiCC::getline( in, line ) ){
+    vector<UnicodeString> parts = TiCC::split( line );
+    if ( !parts.empty() ){
+      Toad::check_mbma_word( *models.mbma, 0,
+			     lexicon, doMor ? &mor_lexicon : 0,
+			     parts[0], os, unused );
+      unused.clear();
+    }
+  }
+  return true;
+}
+
+bool lemma_job( thread_models& models,
+		istream& in,
+		ostream& os,
+		string& error ){
+  // as checkmblem --tsv
+  if ( lexicon.size() == 0 ){
+    error = "no lemma lexicon loaded (-L)";
+    return false;
+  }
+  UnicodeString line;
+  vector<Toad::lemma_mismatch> mismatches;
+  while ( TiCC::getline( in, line ) ){
+    vector<UnicodeString> parts = TiCC::split( line );
+    if ( parts.empty() ){
+      continue;
+    }
+    UnicodeString ls = parts[0];
+    ls.toLower();
+    if ( parts[0] != ls ){
+      continue;
+    }
+    mismatches.clear();
+    Toad::check_lemma( *models.mblem, lexicon, parts[0], mismatches );
+    for ( const auto& mis : mismatches ){
+      os << mis.word << "\t" << mis.lemma << "\t" << mis.tag << endl;
+    }
+  }
+  return true;
+}
+
+bool enrich_job( thread_models& models,
+		 const vector<string>& args,
+		 istream& in,
+		 ostream& os,
+		 string& error ){
+  // as chunkgen and nergen, without the training
+  bool ner = ( args.size() > 1 && args[1] == "ner" );
+  if ( args.size() != 2 || ( !ner && args[1] != "chunk" ) ){
+    error = "usage: enrich chunk|ner";
+    return false;
+  }
+  if ( !models.tagger ){
+    error = "no POS tagger loaded (--tagger)";
+    return false;
+  }
+  if ( ner && !theNer ){
+    error = "no gazetteers loaded (-g)";
+    return false;
+  }
+  Toad::EnrichmentWriter writer( ner ? theNer : 0 );
+  if ( !writer.init( error ) ){
+    return false;
+  }
+  bool utt = false;
+  return Toad::enrich_corpus( in, os, models.tagger, 0, writer, 0,
+			      utt, error );
+}
+
+bool bootstrap_job( const vector<string>& args,
+		    istream& in,
+		    ostream& os,
+		    string& error ){
+  // as nergen --bootstrap. The input is a 2 column file, or with
+  // 'running', one sentence per line.
+  if ( !theNer ){
+    error = "no gazetteers loaded (-g)";
+    return false;
+  }
+  bool running = ( args.size() > 1 && args[1] == "running" );
+  bool utt = false;
+  return Toad::bootstrap_corpus( in, os, *theNer, running, 0, utt, error );
+}
+
+void run_job( thread_models& models, int fd ){
+  socket_buf buf( fd );
+  istream in( &buf );
+  ostream os( &buf );
+  string request;
+  getline( in, request );
+  vector<string> args = TiCC::split( request );
+  string error;
+  bool ok = false;
+  string job = args.empty() ? "" : args[0];
+  if ( job == "test" ){
+    ok = test_job( models, in, os, error );
+  }
+  else if ( job == "check" ){
+    ok = check_job( models, args, in, os, error );
+  }
+  else if ( job == "lemma" ){
+    ok = lemma_job( models, in, os, error );
+  }
+  else if ( job == "enrich" ){
+    ok = enrich_job( models, args, in, os, error );
+  }
+  else if ( job == "bootstrap" ){
+    ok = bootstrap_job( args, in, os, error );
+  }
+  else {
+    error = "unknown job: '" + request + "'";
+  }
+  if ( buf.timed_out() ){
+    // the input seemed complete to the job, but wasn't
+    ok = false;
+    error = "no input from the client for " + to_string( idle_timeout )
+      + " seconds";
+  }
+  if ( ok ){
+    os << status_prefix << "OK" << endl;
+  }
+  else {
+    os << status_prefix << "ERROR " << error << endl;
+  }
+  os.flush();
+  // read what is left of the input, so closing doesn't reset the
+  // connection before the client has the status
+  shutdown( fd, SHUT_WR );
+  in.ignore( numeric_limits<streamsize>::max() );
+}
+
+// the accepted connections, waiting for a thread of the pool.
+// -1 tells a thread to stop.
+static mutex queue_mutex;
+static condition_variable queue_cv;
+static deque<int> job_queue;
+
+void push_job( int fd ){
+  {
+    lock_guard<mutex> lock( queue_mutex );
+    job_queue.push_back( fd );
+  }
+  queue_cv.notify_one();
+}
+
+void pool_thread( thread_models *models ){
+  while ( true ){
+    int fd;
+    {
+      unique_lock<mutex> lock( queue_mutex );
+      queue_cv.wait( lock, []{ return !job_queue.empty(); } );
+      fd = job_queue.front();
+      job_queue.pop_front();
+    }
+    if ( fd < 0 ){
+      return;
+    }
+    run_job( *models, fd );
+    close( fd );
+  }
+}
+
+void set_timeouts( int fd ){
+  // a client that stops sending, or stops reading the results, must not
+  // keep a thread of the pool forever. A read or write that waits longer
+  // than 'idle_timeout' fails, and ends the job.
+  if ( idle_timeout > 0 ){
+    timeval tv;
+    tv.tv_sec = idle_timeout;
+    tv.tv_usec = 0;
+    setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv) );
+    setsockopt( fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv) );
+  }
+}
+
+bool make_address( const string& name, sockaddr_un& addr ){
+  memset( &addr, 0, sizeof(addr) );
+  addr.sun_family = AF_UNIX;
+  if ( name.size() >= sizeof(addr.sun_path) ){
+    cerr << "socket name too long: " << name << endl;
+    return false;
+  }
+  strcpy( addr.sun_path, name.c_str() );
+  return true;
+}
+
+int run_client( const string& socket_name, const vector<string>& job ){
+  sockaddr_un addr;
+  if ( !make_address( socket_name, addr ) ){
+    return EXIT_FAILURE;
+  }
+  int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if ( fd < 0
+       || connect( fd, (sockaddr*)&addr, sizeof(addr) ) < 0 ){
+    cerr << "unable to connect to: " << socket_name << " ("
+	 << strerror( errno ) << ")" << endl;
+    return EXIT_FAILURE;
+  }
+  // send stdin in a separate thread, while the results come back.
+  // Otherwise both sides could block on a full socket.
+  string request;
+  for ( const auto& arg : job ){
+    request += arg + " ";
+  }
+  request += "\n";
+  thread sender( [fd,request](){
+      socket_buf buf( fd );
+      ostream os( &buf );
+      os << request << cin.rdbuf();
+      os.flush();
+      shutdown( fd, SHUT_WR );
+    } );
+  socket_buf buf( fd );
+  istream in( &buf );
+  string line;
+  int result = EXIT_FAILURE;
+  while ( getline( in, line ) ){
+    if ( line.compare( 0, status_prefix.size(), status_prefix ) == 0 ){
+      string status = line.substr( status_prefix.size() );
+      if ( status == "OK" ){
+	result = EXIT_SUCCESS;
+      }
+      else {
+	cerr << status << endl;
+      }
+      break;
+    }
+    cout << line << "\n";
+  }
+  if ( result != EXIT_SUCCESS && line.empty() ){
+    cerr << "the connection to " << socket_name << " was lost" << endl;
+  }
+  sender.join();
+  close( fd );
+  cout.flush();
+  return result;
+}
+
+bool stale_socket( const string& name, const sockaddr_un& addr ){
+  // true when 'name' is a socket that no one accepts connections on, so
+  // one left behind by a toadd that didn't stop cleanly
+  struct stat st;
+  if ( lstat( name.c_str(), &st ) != 0 || !S_ISSOCK( st.st_mode ) ){
+    return false;
+  }
+  int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if ( fd < 0 ){
+    return false;
+  }
+  bool stale = ( connect( fd, (sockaddr*)&addr, sizeof(addr) ) < 0
+		 && errno == ECONNREFUSED );
+  close( fd );
+  return stale;
+}
+
+bool set_nonblocking( int fd, bool on ){
+  int flags = fcntl( fd, F_GETFL );
+  if ( flags < 0 ){
+    return false;
+  }
+  flags = on ? ( flags | O_NONBLOCK ) : ( flags & ~O_NONBLOCK );
+  return fcntl( fd, F_SETFL, flags ) == 0;
+}
+
+// SIGINT and SIGTERM are only handled by the main thread. The handler
+// writes to a pipe, which main() polls together with the socket, so a
+// signal is never missed, whenever it comes.
+static volatile sig_atomic_t stopping = 0;
+static int stop_pipe[2] = { -1, -1 };
+
+extern "C" void stop_handler( int ){
+  int saved = errno;
+  stopping = 1;
+  // when the pipe is full, main() is woken up already
+  ssize_t res = write( stop_pipe[1], "x", 1 );
+  (void)res;
+  errno = saved;
+}
+
+int main( int argc, char * const argv[] ){
+  TiCC::CL_Options opts( "S:c:j:L:M:g:hV",
+			 "tagger:,client,timeout:,help,version" );
+  try {
+    opts.parse_args( argc, argv );
+  }
+  catch ( TiCC::OptionError& e ){
+    cerr << e.what() << endl;
+    usage( opts.prog_name() );
+    return EXIT_FAILURE;
+  }
+  if ( opts.extract( 'h' ) || opts.extract( "help" ) ){
+    usage( opts.prog_name() );
+    return EXIT_SUCCESS;
+  }
+  if ( opts.extract( 'V' ) || opts.extract( "version" ) ){
+    cerr << opts.prog_name() << " " << VERSION << endl;
+    return EXIT_SUCCESS;
+  }
+  string socket_name;
+  if ( !opts.extract( 'S', socket_name ) ){
+    cerr << "missing -S option" << endl;
+    usage( opts.prog_name() );
+    return EXIT_FAILURE;
+  }
+  if ( opts.extract( "client" ) ){
+    vector<string> job = opts.getMassOpts();
+    if ( job.empty() ){
+      cerr << "missing job" << endl;
+      usage( opts.prog_name() );
+      return EXIT_FAILURE;
+    }
+    return run_client( socket_name, job );
+  }
+  opts.extract( 'c', configFileName );
+  if ( !configuration.fill( configFileName ) ){
+    cerr << "failed to read configuration from: " << configFileName << endl;
+    return EXIT_FAILURE;
+  }
+  int num_threads = 1;
+  string value;
+  if ( opts.extract( 'j', value ) ){
+    if ( !TiCC::stringTo( value, num_threads ) || num_threads < 1 ){
+      cerr << "invalid value for -j: " << value << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if ( opts.extract( "timeout", value ) ){
+    if ( !TiCC::stringTo( value, idle_timeout ) || idle_timeout < 0 ){
+      cerr << "invalid value for --timeout: " << value << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  string error;
+  if ( opts.extract( 'L', value ) ){
+    if ( !lexicon.open( value, error ) ){
+      cerr << error << endl;
+      return EXIT_FAILURE;
+    }
+    cout << "loaded " << lexicon.size() << " lemmas from " << value << endl;
+  }
+  if ( opts.extract( 'M', value ) ){
+    if ( !mor_lexicon.open( value, error ) ){
+      cerr << error << endl;
+      return EXIT_FAILURE;
+    }
+    cout << "loaded " << mor_lexicon.size() << " morphemes from " << value
+	 << endl;
+  }
+  if ( opts.extract( "tagger", value ) ){
+    mbt_setting = "-s " + value + " -vcf";
+  }
+  if ( opts.extract( 'g', value ) ){
+    value = TiCC::realpath( value );
+    theNer = new NERTagger( theErrLog );
+    if ( !theNer->read_gazets( TiCC::basename( value ),
+			       TiCC::dirname( value ) ) ){
+      return EXIT_FAILURE;
+    }
+  }
+  if ( !opts.getMassOpts().empty() ){
+    cerr << "jobs are only given in --client mode" << endl;
+    return EXIT_FAILURE;
+  }
+  // load the models of all threads at the same time
+  vector<thread_models> models( num_threads );
+  vector<char> loaded( num_threads, 0 );
+  {
+    vector<thread> loaders;
+    for ( int i=0; i < num_threads; ++i ){
+      loaders.emplace_back( [&models,&loaded,i](){
+	  loaded[i] = init_models( models[i] );
+	} );
+    }
+    for ( auto& t : loaders ){
+      t.join();
+    }
+  }
+  if ( find( loaded.begin(), loaded.end(), 0 ) != loaded.end() ){
+    return EXIT_FAILURE;
+  }
+
+  sockaddr_un addr;
+  if ( !make_address( socket_name, addr ) ){
+    return EXIT_FAILURE;
+  }
+  struct stat st;
+  if ( lstat( socket_name.c_str(), &st ) == 0 ){
+    // only replace a socket of a toadd that is gone
+    if ( !stale_socket( socket_name, addr ) ){
+      cerr << socket_name << " exists, and is not the socket of a stopped "
+	   << opts.prog_name() << ". Not removed." << endl;
+      return EXIT_FAILURE;
+    }
+    unlink( socket_name.c_str() );
+  }
+  int listen_fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if ( listen_fd < 0
+       || bind( listen_fd, (sockaddr*)&addr, sizeof(addr) ) < 0
+       || listen( listen_fd, 64 ) < 0
+       || lstat( socket_name.c_str(), &st ) < 0
+       || !set_nonblocking( listen_fd, true ) ){
+    cerr << "unable to listen on: " << socket_name << " ("
+	 << strerror( errno ) << ")" << endl;
+    return EXIT_FAILURE;
+  }
+  if ( pipe( stop_pipe ) < 0
+       || !set_nonblocking( stop_pipe[0], true )
+       || !set_nonblocking( stop_pipe[1], true ) ){
+    cerr << "unable to create a pipe: " << strerror( errno ) << endl;
+    return EXIT_FAILURE;
+  }
+  struct sigaction action;
+  memset( &action, 0, sizeof(action) );
+  action.sa_handler = stop_handler;
+  sigaction( SIGINT, &action, 0 );
+  sigaction( SIGTERM, &action, 0 );
+  // the threads of the pool inherit a mask that blocks the signals
+  sigset_t stop_signals;
+  sigset_t old_mask;
+  sigemptyset( &stop_signals );
+  sigaddset( &stop_signals, SIGINT );
+  sigaddset( &stop_signals, SIGTERM );
+  pthread_sigmask( SIG_BLOCK, &stop_signals, &old_mask );
+  vector<thread> pool;
+  for ( int i=0; i < num_threads; ++i ){
+    pool.emplace_back( pool_thread, &models[i] );
+  }
+  pthread_sigmask( SIG_SETMASK, &old_mask, 0 );
+  cout << opts.prog_name() << " listening on " << socket_name << " with "
+       << num_threads << " thread" << ( num_threads > 1 ? "s" : "" ) << endl;
+  while ( !stopping ){
+    pollfd fds[2];
+    fds[0].fd = listen_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = stop_pipe[0];
+    fds[1].events = POLLIN;
+    if ( poll( fds, 2, -1 ) < 0 ){
+      if ( errno != EINTR ){
+	cerr << "poll failed: " << strerror( errno ) << endl;
+	break;
+      }
+      continue;
+    }
+    if ( fds[1].revents ){
+      break;
+    }
+    if ( !( fds[0].revents & POLLIN ) ){
+      continue;
+    }
+    int fd = accept( listen_fd, 0, 0 );
+    if ( fd < 0 ){
+      // EAGAIN: the client was gone before we got to it
+      if ( errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK
+	   && errno != ECONNABORTED ){
+	cerr << "accept failed: " << strerror( errno ) << endl;
+      }
+      continue;
+    }
+    // some systems pass O_NONBLOCK on from the listening socket
+    set_nonblocking( fd, false );
+    set_timeouts( fd );
+    push_job( fd );
+  }
+  cout << "stopping, after the running jobs" << endl;
+  close( listen_fd );
+  // remove the socket, unless it was replaced meanwhile
+  struct stat now;
+  if ( lstat( socket_name.c_str(), &now ) == 0
+       && now.st_dev == st.st_dev
+       && now.st_ino == st.st_ino ){
+    unlink( socket_name.c_str() );
+  }
+  for ( int i=0; i < num_threads; ++i ){
+    push_job( -1 );
+  }
+  for ( auto& t : pool ){
+    t.join();
+  }
+  for ( auto& m : models ){
+    free_models( m );
+  }
+  delete theNer;
+  return EXIT_SUCCESS;
+}
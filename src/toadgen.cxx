@@ -0,0 +1,429 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <exception>
+#include "ticcutils/StringOps.h"
+#include "ticcutils/CommandLine.h"
+#include "ticcutils/FileUtils.h"
+#include "ticcutils/Configuration.h"
+#include "ticcutils/Unicode.h"
+#include "mbt/MbtAPI.h"
+#include "unicode/ustream.h"
+#include "unicode/unistr.h"
+#include "frog/ner_tagger_mod.h"
+#include "toad/sentence_batch.h"
+#include "toad/enrichment.h"
+#include "toad/compressed_input.h"
+#include "config.h"
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+using namespace icu;
+
+// toadgen does the work of chunkgen and nergen in one run, for a chunker
+// and a NER corpus of the same text. The POS tagger and the gazetteers
+// are loaded once, every sentence is tagged once and written to both
+// trainingfiles, and then both MBT taggers are trained in parallel.
+
+TiCC::LogStream mylog(cerr);
+
+static NERTagger myNer(&mylog);
+
+static TiCC::Configuration default_config; // sane defaults
+static TiCC::Configuration use_config;     // the config we gonna use
+
+void set_default_config(){
+  default_config.setatt( "settings", "froggen.settings", "tagger" );
+  default_config.setatt( "baseName", "chunkgen", "IOB" );
+  default_config.setatt( "p", "dddwfWawa", "IOB" );
+  default_config.setatt( "P", "chnppddwFawasss", "IOB" );
+  default_config.setatt( "n", "10", "IOB" );
+  default_config.setatt( "M", "200", "IOB" );
+  default_config.setatt( "%", "5", "IOB" );
+  default_config.setatt( "timblOpts",
+		    "+vS -G -FColumns K: -a4 -mM -k5 -dID U: -a0 -mM -k19 -dID",
+		    "IOB" );
+  default_config.setatt( "set", "http://ilk.uvt.nl/folia/sets/frog-chunker-nl", "IOB" );
+  default_config.setatt( "baseName", "nergen", "NER" );
+  default_config.setatt( "p", "ddwdwfWawaa", "NER" );
+  default_config.setatt( "P", "chnppddwdwFawawasss", "NER" );
+  default_config.setatt( "n", "10", "NER" );
+  default_config.setatt( "M", "1000", "NER" );
+  default_config.setatt( "%", "5", "NER" );
+  default_config.setatt( "timblOpts",
+		    "+vS -G -FColumns K: -a4 U: -a4 -mM -k19 -dID",
+		    "NER" );
+  default_config.setatt( "set", "http://ilk.uvt.nl/folia/sets/frog-ner-nl", "NER" );
+  default_config.setatt( "max_ner_size", "15", "NER" );
+}
+
+class setting_error: public std::runtime_error {
+public:
+  setting_error( const string& key, const string& mod ):
+    std::runtime_error( "missing key: '" + key + "' for module: '" + mod + "'" )
+  {};
+};
+
+void usage( const string& name ){
+  cerr << name << " [-c configfile] [-O outputdir] [-g gazetteerfile] "
+       << "--chunk=chunkfile --ner=nerfile" << endl;
+  cerr << name << " does what chunkgen and nergen do, in one run.\n"
+       << " The 'traditionally' IOB tagged chunker and NER corpora must\n"
+       << " contain the same sentences. They are POS tagged once, and\n"
+       << " both MBT datafiles are created in one pass. After that, the\n"
+       << " chunker and NER taggers are trained in parallel." << endl;
+  cerr << "--chunk 'file'\t the chunker corpus" << endl;
+  cerr << "--ner 'file'\t the NER corpus" << endl;
+  cerr << "-c 'configfile'\t An existing configfile that will be enriched\n"
+       << "\t\t with additional chunker and NER specific information." << endl;
+  cerr << "-O 'outputdir'\t The directoy where all the outputfiles are stored\n"
+       << "\t\t highly recommended to use, because a lot of files are created\n"
+       << "\t\t and your working directory will get cluttered." << endl;
+  cerr << "-g 'gazetteer'\t a file describing the gazetteer info. "
+       << "(see nergen)" << endl;
+  cerr << "--override\t override O NER tags with those derived from the gazeteers," << endl
+       << "\t\t so ONLY when there is NO CONFLICT" << endl;
+  cerr << "-X keep intermediate files." << endl;
+  cerr << "-V or --version Show version information" << endl;
+  cerr << "-h or --help Display this information." << endl;
+}
+
+struct tagged_columns {
+  vector<UnicodeString> words;
+  vector<UnicodeString> tags;
+};
+
+void fill_columns( const vector<Tagger::TagResult>& tagv,
+		   tagged_columns& cols ){
+  cols.words.clear();
+  cols.tags.clear();
+  for( const auto& tr : tagv ){
+    cols.words.push_back( tr.word() );
+    cols.tags.push_back( tr.assigned_tag() );
+  }
+}
+
+struct corpus {
+  string module;    // the config section: "IOB" or "NER"
+  string inpname;
+  string outname;
+  string settings_name;
+  bool utt = false; // "<utt>" markers are used
+  Toad::InputFile is;
+  ofstream os;
+};
+
+void create_train_files( MbtAPI *tagger,
+			 corpus& chunk,
+			 corpus& ner,
+			 bool override ){
+  // the same data as chunkgen and nergen write
+  Toad::EnrichmentWriter chunk_writer;
+  Toad::EnrichmentWriter ner_writer( &myNer, override );
+  string error;
+  if ( !chunk_writer.init( error ) || !ner_writer.init( error ) ){
+    cerr << error << endl;
+    exit(EXIT_FAILURE);
+  }
+  for ( auto corp : { &chunk, &ner } ){
+    if ( !corp->is.open( corp->inpname ) ){
+      cerr << corp->is.error() << endl;
+      exit(EXIT_FAILURE);
+    }
+    corp->os.open( corp->outname );
+  }
+  // read both corpora in batches, in step. Only the sentences of the
+  // chunker corpus are tagged, the NER corpus must have the same words.
+  const size_t batch_size = 1000;
+  Toad::SentenceReader chunk_reader( chunk.is );
+  Toad::SentenceReader ner_reader( ner.is );
+  Toad::BatchTagger batch_tagger( tagger );
+  vector<Toad::labeled_sentence> chunk_batch;
+  vector<Toad::labeled_sentence> ner_batch;
+  vector<vector<Tagger::TagResult>> results;
+  tagged_columns cols;
+  size_t HeartBeat = 0;
+  while ( true ){
+    size_t num = chunk_reader.read_batch( chunk_batch, batch_size, error );
+    if ( !error.empty() ){
+      cerr << chunk.inpname << ": " << error << endl;
+      exit(EXIT_FAILURE);
+    }
+    size_t ner_num = ner_reader.read_batch( ner_batch, batch_size, error );
+    if ( !error.empty() ){
+      cerr << ner.inpname << ": " << error << endl;
+      exit(EXIT_FAILURE);
+    }
+    for ( auto corp : { &chunk, &ner } ){
+      if ( !corp->is.error().empty() ){
+	cerr << corp->is.error() << endl;
+	exit(EXIT_FAILURE);
+      }
+    }
+    if ( num != ner_num ){
+      cerr << chunk.inpname << " and " << ner.inpname
+	   << " don't have the same number of sentences" << endl;
+      exit(EXIT_FAILURE);
+    }
+    if ( num == 0 ){
+      break;
+    }
+    if ( chunk_reader.saw_utt() ){
+      chunk.utt = true;
+    }
+    if ( ner_reader.saw_utt() ){
+      ner.utt = true;
+    }
+    batch_tagger.tag( chunk_batch, num, results );
+    for ( size_t i=0; i < num; ++i ){
+      if ( chunk_batch[i].words != ner_batch[i].words ){
+	cerr << chunk.inpname << " and " << ner.inpname
+	     << " differ in sentence " << HeartBeat+1 << endl;
+	exit(EXIT_FAILURE);
+      }
+      fill_columns( results[i], cols );
+      chunk_writer.write( chunk.os, cols.words, cols.tags,
+			  chunk_batch[i].labels, chunk.utt,
+			  i == num-1 && chunk_reader.unterminated() );
+      ner_writer.write( ner.os, cols.words, cols.tags,
+			ner_batch[i].labels, ner.utt );
+      if ( ++HeartBeat % 8000 == 0 ) {
+	cout << endl;
+      }
+      if ( HeartBeat % 100 == 0 ) {
+	cout << ".";
+	cout.flush();
+      }
+    }
+  }
+  cout << endl;
+  batch_tagger.report( cout );
+}
+
+string tagger_command( const corpus& corp, bool keepX ){
+  // get all required options from the merged config. We are picky.
+  vector<string> keys = { "set", "p", "P", "timblOpts", "M", "n", "%" };
+  for ( const auto& key : keys ){
+    if ( use_config.lookUp( key, corp.module ).empty() ){
+      throw setting_error( key, corp.module );
+    }
+  }
+  string taggercommand = "-E " + corp.outname
+    + " -s " + corp.settings_name
+    + " -p " + use_config.lookUp( "p", corp.module )
+    + " -P " + use_config.lookUp( "P", corp.module )
+    + " -O\""+ use_config.lookUp( "timblOpts", corp.module ) + "\""
+    + " -M " + use_config.lookUp( "M", corp.module )
+    + " -n " + use_config.lookUp( "n", corp.module )
+    + " -% " + use_config.lookUp( "%", corp.module );
+  if ( !corp.utt ){
+    taggercommand += " -eEL";
+  }
+  if ( keepX ){
+    taggercommand += " -X";
+  }
+  taggercommand += " -DLogSilent"; // shut up
+  return taggercommand;
+}
+
+int main(int argc, char * const argv[] ) {
+  TiCC::CL_Options opts("O:c:hVg:X",
+			"chunk:,ner:,gazeteer:,help,version,override");
+  try {
+    opts.parse_args( argc, argv );
+  }
+  catch ( const exception& e ){
+    cerr << e.what() << endl;
+    exit(EXIT_FAILURE);
+  }
+  string outputdir;
+  string configfile;
+  string gazetteer_name;
+  if ( opts.extract( 'h' ) || opts.extract( "help" ) ){
+    usage( opts.prog_name() );
+    exit( EXIT_SUCCESS );
+  }
+  if ( opts.extract( 'V' ) || opts.extract( "version" ) ){
+    cerr << "VERSION: " << VERSION << endl;
+    exit( EXIT_SUCCESS );
+  }
+  corpus chunk;
+  chunk.module = "IOB";
+  corpus ner;
+  ner.module = "NER";
+  if ( !opts.extract( "chunk", chunk.inpname )
+       || !opts.extract( "ner", ner.inpname ) ){
+    cerr << "both --chunk and --ner are needed" << endl;
+    usage( opts.prog_name() );
+    exit(EXIT_FAILURE);
+  }
+  for ( const auto& name : { chunk.inpname, ner.inpname } ){
+    if ( !TiCC::isFile( name ) ){
+      cerr << "unable to open inputfile '" << name << "'" << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  if ( !opts.getMassOpts().empty() ){
+    cerr << "use --chunk and --ner for the inputfiles" << endl;
+    exit(EXIT_FAILURE);
+  }
+  set_default_config();
+  if ( opts.extract( 'c', configfile ) ){
+    if ( !use_config.fill( configfile ) ) {
+      cerr << "unable to open:" << configfile << endl;
+      exit( EXIT_FAILURE );
+    }
+    cout << "using configuration: " << configfile << endl;
+  }
+  bool keepX = opts.extract( 'X' );
+  bool override = opts.extract( "override" );
+  opts.extract( 'O', outputdir );
+  if ( !outputdir.empty() ){
+    if ( outputdir[outputdir.length()-1] != '/' )
+      outputdir += "/";
+    if ( !TiCC::isDir( outputdir ) && !TiCC::createPath( outputdir ) ){
+      cerr << "output dir not usable: " << outputdir << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  else if ( !configfile.empty() ){
+    outputdir = TiCC::dirname( configfile );
+  }
+  use_config.merge( default_config ); // to be sure to have all we need
+  if ( !opts.extract( 'g', gazetteer_name )
+       && !opts.extract( "gazeteer", gazetteer_name ) ){
+    gazetteer_name = use_config.lookUp( "known_ners", "NER" );
+  }
+  gazetteer_name = TiCC::realpath( gazetteer_name );
+  if ( gazetteer_name.empty() ){
+    cerr << "WARNING: missing gazetteer option (-g). " << endl;
+    cerr << "Are u sure ?" << endl;
+  }
+  if ( !myNer.read_gazets( TiCC::basename( gazetteer_name ),
+			   TiCC::dirname( gazetteer_name ) ) ){
+    exit( EXIT_FAILURE );
+  }
+  for ( auto *corp : { &chunk, &ner } ){
+    string base_name = use_config.lookUp( "baseName", corp->module );
+    if ( base_name.empty() ){
+      throw setting_error( "baseName", corp->module );
+    }
+    corp->outname = outputdir + base_name + ".data";
+    corp->settings_name = outputdir + base_name + ".settings";
+  }
+  string mbt_setting = use_config.lookUp( "settings", "tagger" );
+  if ( mbt_setting.empty() ){
+    throw setting_error( "settings", "tagger" );
+  }
+  string use_dir = use_config.configDir();
+  if ( use_dir.empty() ){
+    mbt_setting = "-s " + outputdir + mbt_setting + " -vcf" ;
+  }
+  else {
+    mbt_setting = "-s " + use_dir + mbt_setting + " -vcf" ;
+  }
+  MbtAPI *PosTagger = new MbtAPI( mbt_setting, mylog );
+  if ( !PosTagger->isInit() ){
+    cerr << "unable to initialize a POS tagger using:" << mbt_setting << endl;
+    exit( EXIT_FAILURE );
+  }
+  cout << "Start enriching: " << chunk.inpname << " and " << ner.inpname
+       << " with POS tags (every dot represents 100 tagged sentences)"
+       << endl;
+  create_train_files( PosTagger, chunk, ner, override );
+  delete PosTagger;
+  chunk.os.close();
+  ner.os.close();
+  cout << "Created trainingfiles: " << chunk.outname << " and "
+       << ner.outname << endl;
+
+  vector<string> commands = { tagger_command( chunk, keepX ),
+			      tagger_command( ner, keepX ) };
+  for ( const auto& command : commands ){
+    cout << "start tagger: " << command << endl;
+  }
+  cout << "this may take several minutes, depending on the corpus size."
+       << endl;
+  vector<int> ok( commands.size(), 0 );
+#ifdef HAVE_OPENMP
+  omp_set_num_threads( commands.size() );
+#endif
+#pragma omp parallel for schedule(dynamic,1)
+  for ( size_t i=0; i < commands.size(); ++i ){
+    ok[i] = MbtAPI::GenerateTagger( commands[i] );
+  }
+  cout << "finished taggers" << endl;
+
+  // one frog configfile template for both modules
+  TiCC::Configuration output_config = use_config;
+  for ( const auto *corp : { &chunk, &ner } ){
+    string base_name = use_config.lookUp( "baseName", corp->module );
+    for ( const auto& key : { "baseName", "p", "P", "timblOpts",
+			      "M", "n", "%" } ){
+      output_config.clearatt( key, corp->module );
+    }
+    output_config.setatt( "version", "2.0", corp->module );
+    if ( corp == &chunk ){
+      output_config.setatt( "settings", base_name + ".settings", "IOB" );
+    }
+    else {
+      string setting_name = TiCC::realpath(outputdir) + "/" + base_name
+	+ ".settings";
+      output_config.setatt( "settings", setting_name, "NER" );
+      output_config.setatt( "known_ners", gazetteer_name, "NER" );
+    }
+  }
+  string cfg_out;
+  if ( configfile.empty() ){
+    cfg_out = outputdir + "frog-toadgen.cfg.template";
+  }
+  else {
+    configfile = TiCC::basename( configfile );
+    const auto ppos = configfile.find( "." );
+    if ( ppos == string::npos ){
+      cfg_out = outputdir + configfile + "-toadgen.cfg.template";
+    }
+    else {
+      cfg_out = outputdir + configfile.substr(0,ppos)
+	+ "-toadgen" + configfile.substr( ppos );
+    }
+  }
+  output_config.create_configfile( cfg_out );
+  cout << "stored a frog configfile template: " << cfg_out << endl;
+  if ( find( ok.begin(), ok.end(), 0 ) != ok.end() ){
+    cerr << "training of a tagger failed" << endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,321 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include "timbl/TimblAPI.h"
+#include "toad/tree_report.h"
+
+using namespace std;
+
+namespace Toad {
+
+  vector<string> sample_lines( const string& filename, size_t max ){
+    // the first line after each of 'max' evenly spaced offsets. Only
+    // those lines are read, not the whole file.
+    vector<string> result;
+    ifstream is( filename, ios::binary );
+    if ( !is || max == 0 ){
+      return result;
+    }
+    string line;
+    while ( result.size() <= max && getline( is, line ) ){
+      result.push_back( line );
+    }
+    if ( result.size() <= max ){
+      // the whole file
+      return result;
+    }
+    result.clear();
+    is.clear();
+    is.seekg( 0, ios::end );
+    size_t size = is.tellg();
+    is.seekg( 0 );
+    size_t pos = 0; // the start of the next unread line
+    for ( size_t i=0; i < max; ++i ){
+      size_t target = size / max * i + size % max * i / max;
+      if ( target > pos ){
+	// skip the rest of the line around 'target'
+	is.seekg( target - 1 );
+	getline( is, line );
+      }
+      if ( !getline( is, line ) ){
+	break;
+      }
+      result.push_back( line );
+      pos = is.tellg();
+    }
+    return result;
+  }
+
+  size_t file_size( const string& filename ){
+    ifstream is( filename, ios::binary|ios::ate );
+    if ( !is ){
+      return 0;
+    }
+    return is.tellg();
+  }
+
+  long resident_size(){
+    ifstream is( "/proc/self/statm" );
+    long pages;
+    long resident;
+    if ( !( is >> pages >> resident ) ){
+      return -1;
+    }
+    return resident * sysconf( _SC_PAGESIZE );
+  }
+
+  long peak_resident_size(){
+    ifstream is( "/proc/self/status" );
+    string line;
+    while ( getline( is, line ) ){
+      if ( line.compare( 0, 6, "VmHWM:" ) == 0 ){
+	istringstream ls( line.substr( 6 ) );
+	long kb;
+	if ( ls >> kb ){
+	  return kb * 1024;
+	}
+      }
+    }
+    return -1;
+  }
+
+  bool reset_peak_resident_size(){
+    ofstream os( "/proc/self/clear_refs" );
+    os << "5" << endl;
+    return os.good();
+  }
+
+  static bool level_counts( const string& treefile,
+			    vector<size_t>& levels ){
+    // count the nodes per level in a hashed tree file. In those, all
+    // values are numbers, so every '(' opens a node.
+    ifstream is( treefile );
+    string line;
+    bool hashed = false;
+    bool in_tree = false;
+    size_t depth = 0;
+    while ( getline( is, line ) ){
+      if ( !in_tree ){
+	if ( line.find( "(Hashed)" ) != string::npos ){
+	  hashed = true;
+	}
+	if ( line.empty() || line[0] != '(' ){
+	  continue;
+	}
+	if ( !hashed ){
+	  return false;
+	}
+	in_tree = true;
+      }
+      for ( const auto& c : line ){
+	if ( c == '(' ){
+	  if ( levels.size() <= depth ){
+	    levels.resize( depth+1, 0 );
+	  }
+	  ++levels[depth++];
+	}
+	else if ( c == ')' && depth > 0 ){
+	  --depth;
+	}
+      }
+    }
+    return in_tree;
+  }
+
+  bool analyze_tree( const string& timblopts,
+		     const string& treefile,
+		     const string& datafile,
+		     tree_report& report,
+		     bool load ){
+    report = tree_report();
+    report.tree_file = treefile;
+    report.timbl_options = timblopts;
+    report.file_size = file_size( treefile );
+    level_counts( treefile, report.level_nodes );
+    ifstream is( datafile );
+    string line;
+    while ( getline( is, line ) ){
+      // Timbl guesses the format too: with spaces, or comma separated
+      size_t pos = line.find_last_of( " \t" );
+      if ( pos == string::npos ){
+	pos = line.find_last_of( "," );
+      }
+      if ( pos == string::npos ){
+	continue;
+      }
+      ++report.class_freqs[line.substr( pos+1 )];
+      ++report.instances;
+    }
+    if ( !load ){
+      return true;
+    }
+    long before = resident_size();
+    auto start = chrono::steady_clock::now();
+    Timbl::TimblAPI timbl( timblopts );
+    if ( !timbl.GetInstanceBase( treefile ) ){
+      return false;
+    }
+    chrono::duration<double> secs = chrono::steady_clock::now() - start;
+    report.loaded = true;
+    report.load_seconds = secs.count();
+    long after = resident_size();
+    if ( before >= 0 && after >= 0 ){
+      report.resident_bytes = after - before;
+    }
+    vector<string> sample = sample_lines( datafile, 1000 );
+    report.sample_size = sample.size();
+    start = chrono::steady_clock::now();
+    for ( const auto& inst : sample ){
+      string cls;
+      timbl.Classify( inst, cls );
+    }
+    secs = chrono::steady_clock::now() - start;
+    report.classify_seconds = secs.count();
+    return true;
+  }
+
+  bool report_tree( const string& timblopts,
+		    const string& treefile,
+		    const string& datafile,
+		    bool load ){
+    tree_report report;
+    if ( !analyze_tree( timblopts, treefile, datafile, report, load ) ){
+      cerr << "unable to analyze: " << treefile << endl;
+      return false;
+    }
+    string json_file = treefile + ".report.json";
+    if ( !write_json( json_file, report ) ){
+      cerr << "unable to write: " << json_file << endl;
+      return false;
+    }
+    cout << "stored an instancebase report: " << json_file << endl;
+    return true;
+  }
+
+  static string json_string( const string& s ){
+    string result = "\"";
+    for ( const auto& c : s ){
+      switch ( c ){
+      case '"': result += "\\\""; break;
+      case '\\': result += "\\\\"; break;
+      case '\n': result += "\\n"; break;
+      case '\t': result += "\\t"; break;
+      default:
+	if ( (unsigned char)c < 0x20 ){
+	  char buf[8];
+	  snprintf( buf, sizeof(buf), "\\u%04x", c );
+	  result += buf;
+	}
+	else {
+	  result += c;
+	}
+      }
+    }
+    return result + "\"";
+  }
+
+  bool write_json( const string& filename,
+		   const tree_report& report ){
+    ofstream os( filename );
+    if ( !os ){
+      return false;
+    }
+    size_t nodes = 0;
+    for ( const auto& n : report.level_nodes ){
+      nodes += n;
+    }
+    os << "{" << endl;
+    os << "  \"tree_file\": " << json_string( report.tree_file ) << "," << endl;
+    os << "  \"timbl_options\": " << json_string( report.timbl_options )
+       << "," << endl;
+    os << "  \"file_size\": " << report.file_size << "," << endl;
+    // what wasn't measured is null
+    os << "  \"load_seconds\": ";
+    if ( report.loaded ){
+      os << report.load_seconds;
+    }
+    else {
+      os << "null";
+    }
+    os << "," << endl;
+    os << "  \"resident_bytes\": ";
+    if ( report.loaded && report.resident_bytes >= 0 ){
+      os << report.resident_bytes;
+    }
+    else {
+      os << "null";
+    }
+    os << "," << endl;
+    os << "  \"nodes\": " << nodes << "," << endl;
+    os << "  \"level_nodes\": [";
+    for ( size_t i=0; i < report.level_nodes.size(); ++i ){
+      os << ( i ? ", " : "" ) << report.level_nodes[i];
+    }
+    os << "]," << endl;
+    os << "  \"instances\": " << report.instances << "," << endl;
+    os << "  \"classes\": " << report.class_freqs.size() << "," << endl;
+    // most frequent first
+    vector<pair<size_t,string>> sorted;
+    for ( const auto& it : report.class_freqs ){
+      sorted.push_back( make_pair( it.second, it.first ) );
+    }
+    stable_sort( sorted.begin(), sorted.end(),
+		 []( const pair<size_t,string>& p1,
+		     const pair<size_t,string>& p2 ){
+		   return p1.first > p2.first;
+		 } );
+    os << "  \"class_distribution\": {";
+    for ( size_t i=0; i < sorted.size(); ++i ){
+      os << ( i ? "," : "" ) << endl << "    "
+	 << json_string( sorted[i].second ) << ": " << sorted[i].first;
+    }
+    os << endl << "  }," << endl;
+    if ( report.loaded ){
+      os << "  \"sample_size\": " << report.sample_size << "," << endl;
+      os << "  \"classify_seconds\": " << report.classify_seconds << ","
+	 << endl;
+      double speed = 0.0;
+      if ( report.classify_seconds > 0.0 ){
+	speed = report.sample_size / report.classify_seconds;
+      }
+      os << "  \"classifications_per_second\": " << speed << endl;
+    }
+    else {
+      os << "  \"sample_size\": null," << endl;
+      os << "  \"classify_seconds\": null," << endl;
+      os << "  \"classifications_per_second\": null" << endl;
+    }
+    os << "}" << endl;
+    return os.good();
+  }
+
+}
@@ -0,0 +1,257 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <cstdlib>
+#include <string>
+#include <iostream>
+#include <random>
+#include <thread>
+#include "toad/edit_script.h"
+
+using namespace std;
+using namespace icu;
+
+static int failures = 0;
+
+static string utf8( const UnicodeString& us ){
+  string result;
+  us.toUTF8String( result );
+  return result;
+}
+
+static void check( const string& what,
+		   const UnicodeString& got,
+		   const UnicodeString& expected ){
+  if ( got != expected ){
+    cerr << "FAIL: " << what << ": got '" << utf8( got )
+	 << "', expected '" << utf8( expected ) << "'" << endl;
+    ++failures;
+  }
+}
+
+static void check( const string& what, int got, int expected ){
+  if ( got != expected ){
+    cerr << "FAIL: " << what << ": got " << got
+	 << ", expected " << expected << endl;
+    ++failures;
+  }
+}
+
+// the derivation as froggen did it before EditScripter: try indexOf()
+// for every particle of every matching tag part
+static UnicodeString old_label( const map<UnicodeString,
+				set<UnicodeString>>& particles,
+				const UnicodeString& wordform,
+				const UnicodeString& lemma,
+				const UnicodeString& tag ){
+  UnicodeString prefixed;
+  UnicodeString thisform = wordform;
+  for( const auto& it : particles ){
+    if ( !prefixed.isEmpty() ){
+      break;
+    }
+    thisform = wordform;
+    if ( tag.indexOf(it.first) >= 0 ){
+      for ( const auto& part : it.second ){
+	int part_pos = thisform.indexOf(part);
+	if ( part_pos != -1 ){
+	  UnicodeString edit = thisform;
+	  if ( part_pos < thisform.length()-5 ){
+	    prefixed = part;
+	    edit = edit.remove( part_pos, prefixed.length() );
+	    int ident=0;
+	    while ( ( ident < edit.length() ) &&
+		    ( ident < lemma.length() ) &&
+		    ( edit[ident]==lemma[ident] ) ){
+	      ident++;
+	    }
+	    if (ident<5) {
+	      prefixed = "";
+	    }
+	    else {
+	      thisform = edit;
+	    }
+	  }
+	}
+	if ( !prefixed.isEmpty() )
+	  break;
+      }
+    }
+  }
+  UnicodeString deleted;
+  UnicodeString inserted;
+  int ident=0;
+  while ( ident < thisform.length() &&
+	  ident < lemma.length() &&
+	  thisform[ident]==lemma[ident] )
+    ident++;
+  for ( int i=ident; i< thisform.length(); i++) {
+    deleted += thisform[i];
+  }
+  for ( int i=ident; i< lemma.length(); i++) {
+    inserted += lemma[i];
+  }
+  UnicodeString result;
+  if ( !prefixed.isEmpty() )
+    result += "+P" + prefixed;
+  if ( !deleted.isEmpty() )
+    result += "+D" + deleted;
+  if ( !inserted.isEmpty() )
+    result += "+I" + inserted;
+  return result;
+}
+
+static void test_automaton(){
+  Toad::ParticleAutomaton pa( { "he", "she", "his", "hers", "", "e" } );
+  vector<int> first;
+  pa.first_positions( "ushers", first );
+  check( "first he", first[0], 2 );
+  check( "first she", first[1], 1 );
+  check( "first his", first[2], -1 );
+  check( "first hers", first[3], 2 );
+  check( "first empty", first[4], -1 );
+  check( "first e", first[5], 3 );
+  pa.first_positions( "", first );
+  check( "empty word", first[0], -1 );
+}
+
+static void test_derive(){
+  map<UnicodeString,set<UnicodeString>> particles;
+  particles["WW(vd"] = { "be", "ge" };
+  Toad::EditScripter es( particles );
+  es.add_tag( "WW(vd,vrij,zonder)" );
+  // a +P, +D and +I derivation
+  check( "opgebouwd",
+	 es.derive( "opgebouwd", "opbouwen", "WW(vd,vrij,zonder)" ).label(),
+	 "+Pge+Dd+Ien" );
+  // the same through a tag that wasn't added
+  check( "opgebouwd (new tag)",
+	 es.derive( "opgebouwd", "opbouwen", "WW(vd,prenom,zonder)" ).label(),
+	 "+Pge+Dd+Ien" );
+  // too little left in common after removing the particle
+  check( "gewerkt",
+	 es.derive( "gewerkt", "werken", "WW(vd,vrij,zonder)" ).label(),
+	 "+Dgewerkt+Iwerken" );
+  // no particle for this tag
+  check( "opgebouwd (N)",
+	 es.derive( "opgebouwd", "opgebouwd", "N(soort,ev)" ).label(),
+	 "" );
+  check( "huizen",
+	 es.derive( "huizen", "huis", "N(soort,mv)" ).label(),
+	 "+Dzen+Is" );
+  // a particle too close to the end of the word is never removed
+  check( "afgege",
+	 es.derive( "afgege", "afgeven", "WW(vd,vrij,zonder)" ).label(),
+	 "+Dge+Iven" );
+  Toad::edit_script empty;
+  check( "empty label", empty.label(), "" );
+}
+
+// random words over a small alphabet, so the particles occur often,
+// overlap and occur more than once
+static UnicodeString random_word( mt19937& gen, int min_len, int max_len ){
+  static const string letters = "abegoprt";
+  uniform_int_distribution<int> len( min_len, max_len );
+  uniform_int_distribution<int> letter( 0, letters.size()-1 );
+  UnicodeString result;
+  for ( int i=len( gen ); i > 0; --i ){
+    result += letters[letter( gen )];
+  }
+  return result;
+}
+
+static void test_random(){
+  map<UnicodeString,set<UnicodeString>> particles;
+  particles["WW(vd"] = { "be", "ge", "geb", "ver" };
+  particles["WW(od"] = { "e", "op", "ge" };
+  particles["vd"] = { "ab" };
+  const vector<UnicodeString> tags = { "WW(vd,vrij)", "WW(od,prenom)",
+				       "N(soort,ev)", "ADJ(vd)", "WW(vd" };
+  Toad::EditScripter es( particles );
+  for ( const auto& tag : tags ){
+    es.add_tag( tag );
+  }
+  mt19937 gen( 4711 );
+  uniform_int_distribution<int> pick( 0, tags.size() );
+  for ( int i=0; i < 100000 && failures < 10; ++i ){
+    UnicodeString word = random_word( gen, 0, 14 );
+    // lemmas share a prefix with the word more often than not
+    UnicodeString lemma = word;
+    lemma.remove( 0, pick( gen ) );
+    lemma.truncate( lemma.length() / 2 + 3 );
+    lemma += random_word( gen, 0, 3 );
+    size_t t = pick( gen );
+    // sometimes a tag that wasn't added
+    UnicodeString tag = ( t < tags.size() ) ? tags[t] : "WW(vd,nieuw)";
+    check( "random " + utf8( word ) + "/" + utf8( lemma ) + "/" + utf8( tag ),
+	   es.derive( word, lemma, tag ).label(),
+	   old_label( particles, word, lemma, tag ) );
+  }
+}
+
+static void test_threads(){
+  // one shared EditScripter, used from several threads at once
+  map<UnicodeString,set<UnicodeString>> particles;
+  particles["WW(vd"] = { "be", "ge" };
+  Toad::EditScripter es( particles );
+  es.add_tag( "WW(vd,vrij,zonder)" );
+  const int num_threads = 8;
+  vector<int> errors( num_threads, 0 );
+  vector<thread> pool;
+  for ( int t=0; t < num_threads; ++t ){
+    pool.emplace_back( [&es,&errors,t](){
+      for ( int i=0; i < 20000; ++i ){
+	if ( es.derive( "opgebouwd", "opbouwen",
+			"WW(vd,vrij,zonder)" ).label() != "+Pge+Dd+Ien"
+	     || es.derive( "opgebouwd", "opbouwen",
+			   "WW(vd,prenom,zonder)" ).label() != "+Pge+Dd+Ien"
+	     || es.derive( "huizen", "huis",
+			   "N(soort,mv)" ).label() != "+Dzen+Is" ){
+	  ++errors[t];
+	}
+      }
+    } );
+  }
+  for ( auto& th : pool ){
+    th.join();
+  }
+  for ( int t=0; t < num_threads; ++t ){
+    check( "thread " + to_string( t ), errors[t], 0 );
+  }
+}
+
+int main(){
+  test_automaton();
+  test_derive();
+  test_random();
+  test_threads();
+  if ( failures > 0 ){
+    cerr << failures << " failures" << endl;
+    return EXIT_FAILURE;
+  }
+  cout << "all edit script tests passed" << endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,243 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <unistd.h>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <set>
+#include <iostream>
+#include <fstream>
+#include <random>
+#include "timbl/TimblAPI.h"
+#include "toad/igtree_shards.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static const size_t HISTORY = 8;
+static const string timblopts = "-a1 -w2 +vS";
+
+static string instance( const string& word, const string& cls ){
+  // the mblem features of 'word': its last HISTORY letters
+  string result;
+  for ( size_t i=0; i < HISTORY; ++i ){
+    if ( word.size() + i < HISTORY ){
+      result += "= ";
+    }
+    else {
+      result += word[word.size()-HISTORY+i];
+      result += " ";
+    }
+  }
+  return result + cls;
+}
+
+static string random_stem( mt19937& gen ){
+  static const string letters = "abdegiklmnoprstuvw";
+  uniform_int_distribution<int> len( 2, 7 );
+  uniform_int_distribution<int> letter( 0, letters.size()-1 );
+  string result;
+  for ( int i=len( gen ); i > 0; --i ){
+    result += letters[letter( gen )];
+  }
+  return result;
+}
+
+static void make_data( const string& filename,
+		       vector<string>& lines,
+		       vector<string>& unseen ){
+  // a small lemmatizer set: word endings decide the edit, with some
+  // ambiguous and some exceptional words
+  struct ending { string suffix; string cls; };
+  static const vector<ending> endings = {
+    { "", "N(soort,ev)" },
+    { "en", "N(soort,mv)+Den|WW(inf)+Den+Ien" },
+    { "en", "WW(inf)" },
+    { "s", "N(soort,mv)+Ds" },
+    { "de", "WW(pv,verl,ev)+Dde+Ien" },
+    { "te", "WW(pv,verl,ev)+Dte+Ien|ADJ(prenom)+De" },
+    { "t", "WW(pv,tgw,met-t)+Dt+Ien" },
+    { "je", "N(soort,ev,dim)+Dje" },
+    { "tje", "N(soort,ev,dim)+Dtje" },
+    { "er", "ADJ(vrij,comp)+Der" },
+    { "ste", "ADJ(prenom,sup)+Dste" }
+  };
+  mt19937 gen( 4711 );
+  uniform_int_distribution<int> pick( 0, endings.size()-1 );
+  uniform_int_distribution<int> odd( 0, 19 );
+  set<string> words;
+  ofstream os( filename );
+  while ( words.size() < 5000 ){
+    string stem = random_stem( gen );
+    const ending& end = endings[pick( gen )];
+    string word = stem + end.suffix;
+    if ( !words.insert( word ).second ){
+      continue;
+    }
+    string cls = end.cls;
+    if ( odd( gen ) == 0 ){
+      cls = "SPEC(vreemd)";
+    }
+    lines.push_back( instance( word, cls ) );
+    os << lines.back() << "\n";
+  }
+  while ( unseen.size() < 2000 ){
+    string word = random_stem( gen ) + endings[pick( gen )].suffix;
+    if ( words.count( word ) == 0 ){
+      unseen.push_back( instance( word, "?" ) );
+    }
+  }
+}
+
+static bool train_sharded( const string& datafile,
+			   size_t num_shards,
+			   const string& outfile,
+			   vector<string>& temps ){
+  // the way froggen --shards does it
+  Toad::data_stats stats;
+  if ( !Toad::gather_stats( datafile, true, stats ) ){
+    cerr << "FAIL: gather_stats" << endl;
+    return false;
+  }
+  string weights = datafile + ".wgt";
+  temps.push_back( weights );
+  if ( !Toad::write_weights( weights, stats ) ){
+    cerr << "FAIL: write_weights" << endl;
+    return false;
+  }
+  vector<set<string>> plan = Toad::plan_shards( stats, num_shards );
+  vector<string> parts = Toad::split_instances( datafile,
+						stats.top_feature(),
+						plan,
+						datafile );
+  if ( parts.empty() ){
+    cerr << "FAIL: split_instances" << endl;
+    return false;
+  }
+  vector<string> trees;
+  for ( const auto& part : parts ){
+    temps.push_back( part );
+    trees.push_back( part + ".tree" );
+    temps.push_back( trees.back() );
+    Timbl::TimblAPI timbl( timblopts + " -w " + weights );
+    if ( !timbl.Learn( part ) || !timbl.WriteInstanceBase( trees.back() ) ){
+      cerr << "FAIL: training " << part << endl;
+      return false;
+    }
+  }
+  string error;
+  if ( !Toad::merge_igtrees( trees, plan, stats, outfile, error ) ){
+    cerr << "FAIL: merge_igtrees: " << error << endl;
+    return false;
+  }
+  return true;
+}
+
+static void compare( const string& what,
+		     const string& full_tree,
+		     const string& merged_tree,
+		     const vector<string>& lines ){
+  // both trees must give every line the same class
+  Timbl::TimblAPI full( timblopts );
+  Timbl::TimblAPI merged( timblopts );
+  if ( !full.GetInstanceBase( full_tree )
+       || !merged.GetInstanceBase( merged_tree ) ){
+    cerr << "FAIL: " << what << ": unable to read the trees" << endl;
+    ++failures;
+    return;
+  }
+  int differences = 0;
+  for ( const auto& line : lines ){
+    string cls1;
+    string cls2;
+    if ( !full.Classify( line, cls1 )
+	 || !merged.Classify( line, cls2 ) ){
+      cerr << "FAIL: " << what << ": unable to classify '" << line
+	   << "'" << endl;
+      ++failures;
+      return;
+    }
+    if ( cls1 != cls2 && ++differences <= 10 ){
+      cerr << "FAIL: " << what << ": '" << line << "' got " << cls2
+	   << ", expected " << cls1 << endl;
+    }
+  }
+  if ( differences > 0 ){
+    ++failures;
+  }
+}
+
+int main(){
+  char dir_template[] = "/tmp/test_igtree_shards.XXXXXX";
+  if ( !mkdtemp( dir_template ) ){
+    cerr << "unable to create a temporary directory" << endl;
+    return EXIT_FAILURE;
+  }
+  string dir = dir_template;
+  string datafile = dir + "/mblem.data";
+  vector<string> temps = { datafile };
+  vector<string> lines;
+  vector<string> unseen;
+  make_data( datafile, lines, unseen );
+  string full_tree = datafile + ".tree";
+  temps.push_back( full_tree );
+  bool trained = false;
+  {
+    Timbl::TimblAPI timbl( timblopts );
+    trained = timbl.Learn( datafile ) && timbl.WriteInstanceBase( full_tree );
+  }
+  if ( !trained ){
+    cerr << "FAIL: normal training" << endl;
+    ++failures;
+  }
+  else {
+    for ( size_t shards : { 1, 3, 8 } ){
+      string merged_tree = datafile + "." + to_string( shards ) + ".merged";
+      temps.push_back( merged_tree );
+      if ( !train_sharded( datafile, shards, merged_tree, temps ) ){
+	++failures;
+	continue;
+      }
+      compare( to_string( shards ) + " shards, seen", full_tree,
+	       merged_tree, lines );
+      compare( to_string( shards ) + " shards, unseen", full_tree,
+	       merged_tree, unseen );
+    }
+  }
+  for ( const auto& file : temps ){
+    remove( file.c_str() );
+  }
+  rmdir( dir.c_str() );
+  if ( failures > 0 ){
+    cerr << failures << " failures" << endl;
+    return EXIT_FAILURE;
+  }
+  cout << "all igtree shard tests passed" << endl;
+  return EXIT_SUCCESS;
+}